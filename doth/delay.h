@@ -1,48 +1,108 @@
-class Delay {
-  uint8_t delayline[16000];
-  uint16_t pos;
-  uint16_t posmax;
-  uint8_t feedback;
-
- public:
-  void Init() {
-    posmax = 16000;
-    // initialize the delay line
-    for (uint8_t i = 0; i < 16000; i++) {
-      delayline[i] = 128;
-    }
-  }
-
-  void SetTime(uint16_t posmax_) {
-    posmax = posmax_;
-    if (pos > posmax) {
-      pos = 0;
-    }
-  }
-
-  void SetFeedback(uint8_t feedback_) { feedback = feedback_; }
-
-  uint8_t Update(uint8_t audio_now_) {
-    // add delayed audio
-    int16_t audio_now = (audio_now_ + (delayline[pos] - 128));
-    if (audio_now > 255) {
-      audio_now = 255;
-    } else if (audio_now < 0) {
-      audio_now = 0;
-    }
-
-    // determine next delay
-    int16_t next_delay = (audio_now - 128) * feedback / 100 + 128;
-    if (next_delay > 255) {
-      next_delay = 255;
-    } else if (next_delay < 0) {
-      next_delay = 0;
-    }
-    delayline[pos] = next_delay;
-    pos++;
-    if (pos > posmax) {
-      pos = 0;
-    }
-    return audio_now;
-  }
-};
+// Tempo-synced delay line with a fractional read tap and a damped feedback
+// path. The line is borrowed (see PikoArena) rather than owned, so it can be
+// detached at any time; frames never written since attaching read as silence.
+class Delay {
+  int8_t *line = nullptr;
+  uint32_t length = 0;
+  uint32_t pos = 0;
+  uint32_t filled = 0;
+  uint32_t time_q16 = 0;
+  uint32_t target_q16 = 0;
+  uint32_t request_q16 = 0;  // as set, before fitting it to the line
+  uint32_t clamps = 0;
+  int32_t delayed = 0;  // tap read by the last advancing Update()
+  uint8_t feedback = 40;  // percent
+  uint8_t damping = 96;   // one-pole lowpass coefficient in the feedback path
+  uint8_t mix = 50;       // percent
+  int32_t lowpass = 0;
+
+ public:
+  void Attach(uint8_t *buffer_, uint32_t length_) {
+    line = reinterpret_cast<int8_t *>(buffer_);
+    length = length_;
+    pos = 0;
+    filled = 0;
+    lowpass = 0;
+    delayed = 0;
+    ApplyTime();
+    time_q16 = target_q16;
+  }
+
+  void Detach() { line = nullptr; }
+  bool Attached() { return line != nullptr; }
+
+  // Converts a delay in Q8 quarter notes to Q16 frames at bpm_x100. Update()
+  // runs once per frame, so bpm is the tempo the frames were recorded at.
+  static uint32_t BeatsToFramesQ16(uint32_t beats_q8, uint32_t bpm_x100,
+                                   uint32_t sample_rate) {
+    if (bpm_x100 == 0) return 0;
+    return static_cast<uint32_t>(
+        (static_cast<uint64_t>(beats_q8) * 6000u * sample_rate << 8u) /
+        bpm_x100);
+  }
+
+  // Sets the target delay. The read tap glides there so tempo changes bend
+  // pitch briefly instead of clicking; turning the delay on starts it there.
+  // A time longer than the line is shortened to fit and counted in Clamps().
+  void SetTimeQ16(uint32_t time_q16_) {
+    const bool was_off = target_q16 == 0;
+    request_q16 = time_q16_;
+    ApplyTime();
+    if (was_off) time_q16 = target_q16;
+  }
+
+  // Times shortened to fit the line since construction.
+  uint32_t Clamps() const { return clamps; }
+
+  void SetFeedback(uint8_t feedback_) { feedback = feedback_; }
+  void SetDamping(uint8_t damping_) { damping = damping_; }
+  void SetMix(uint8_t mix_) { mix = mix_; }
+
+  // Mixes the tap into one output frame. Only an advancing call, one per
+  // source frame, moves the line; other renders of the same frame reuse its
+  // tap and leave the line untouched.
+  uint8_t Update(uint8_t audio_now_, bool advance = true) {
+    const int32_t dry = static_cast<int32_t>(audio_now_) - 128;
+    if (line == nullptr || target_q16 == 0) {
+      return audio_now_;
+    }
+
+    if (advance) {
+      time_q16 += (static_cast<int32_t>(target_q16 - time_q16)) >> 11;
+      const uint32_t frames = time_q16 >> 16u;
+      const int32_t frac = static_cast<int32_t>(time_q16 & 0xffffu);
+      delayed = 0;
+      if (frames <= filled) {
+        const uint32_t a =
+            pos >= frames ? pos - frames : pos + length - frames;
+        const uint32_t b = a == 0 ? length - 1u : a - 1u;
+        const int32_t older = frames < filled ? line[b] : 0;
+        delayed = line[a] + (((older - line[a]) * frac) >> 16);
+      }
+
+      lowpass += ((delayed - lowpass) * damping) >> 8;
+      int32_t next = dry + lowpass * feedback / 100;
+      if (next > 127) next = 127;
+      if (next < -128) next = -128;
+      line[pos] = static_cast<int8_t>(next);
+      if (++pos >= length) pos = 0;
+      if (filled < length) filled++;
+    }
+
+    int32_t audio_now = dry + delayed * mix / 100 + 128;
+    if (audio_now > 255) audio_now = 255;
+    if (audio_now < 0) audio_now = 0;
+    return static_cast<uint8_t>(audio_now);
+  }
+
+ private:
+  void ApplyTime() {
+    const uint32_t max_q16 = length > 2 ? (length - 2u) << 16u : 0u;
+    target_q16 = request_q16;
+    if (line != nullptr && target_q16 > max_q16) {
+      target_q16 = max_q16;
+      ++clamps;
+    }
+    if (target_q16 > 0 && target_q16 < (1u << 16u)) target_q16 = 1u << 16u;
+  }
+};
@@ -1,32 +1,114 @@
+// Drives the trigger jack from a hardware alarm, so each pulse rises at the
+// time it was scheduled for and lasts exactly its width whatever the main
+// loop is doing. The alarm callback takes no context, so only one TriggerOut
+// may be initialised.
 class TriggerOut {
   uint8_t gpio;
+  uint alarm;
   uint32_t pulse_width_us;
-  uint32_t deadline_us;
+  uint32_t width_us;  // of the pending pulse
+  uint64_t rise_us;
+  uint64_t fall_us;
+  uint64_t last_rise_us;
+  bool rise_pending;
+  bool rise_armed;  // the pending rise waits on the alarm
   bool high;
-
- public:
-  void Init(uint8_t gpio_, uint16_t milliseconds, uint16_t loop_hz) {
-    (void)loop_hz;
+  bool have_rise;
+  TriggerOutStats stats;
+
+  static inline TriggerOut *instance = nullptr;
+
+  static void AlarmCallback(uint alarm_num) {
+    (void)alarm_num;
+    instance->Service();
+  }
+
+  // Runs every edge that is due, earliest first, then arms the alarm for the
+  // next one. Arming a time that has already passed fails, so that edge runs
+  // straight away. Called with the alarm unable to preempt.
+  void Service() {
+    while (high || rise_pending) {
+      const bool fall_next = high && (!rise_pending || fall_us <= rise_us);
+      const uint64_t target = fall_next ? fall_us : rise_us;
+      if (target > time_us_64()) {
+        if (!hardware_alarm_set_target(alarm, from_us_since_boot(target))) {
+          if (!fall_next) rise_armed = true;
+          return;
+        }
+        continue;
+      }
+      if (fall_next) {
+        gpio_put(gpio, 0);
+        high = false;
+        continue;
+      }
+      gpio_put(gpio, 1);
+      const uint32_t error_us = time_us_32() - static_cast<uint32_t>(rise_us);
+      if (high) ++stats.overlaps;
+      if (!rise_armed) ++stats.late;
+      high = true;
+      rise_pending = false;
+      fall_us = rise_us + width_us;
+      ++stats.pulses;
+      if (error_us > stats.max_error_us) stats.max_error_us = error_us;
+      stats.error_histogram.add(error_us);
+    }
+  }
+
+ public:
+  void Init(uint8_t gpio_, uint16_t milliseconds) {
     gpio = gpio_;
+    SetPulseWidth(milliseconds);
+    width_us = pulse_width_us;
+    rise_us = 0;
+    fall_us = 0;
+    last_rise_us = 0;
+    rise_pending = false;
+    rise_armed = false;
+    high = false;
+    have_rise = false;
+    stats = {};
+    instance = this;
+
+    gpio_init(gpio);
+    gpio_set_dir(gpio, GPIO_OUT);
+    gpio_pull_down(gpio);
+
+    // Above the PWM carrier, so an edge never waits for a render.
+    alarm = static_cast<uint>(hardware_alarm_claim_unused(true));
+    hardware_alarm_set_callback(alarm, AlarmCallback);
+    irq_set_priority(TIMER_IRQ_0 + alarm, 0x00);
+  }
+
+  void SetPulseWidth(uint16_t milliseconds) {
     pulse_width_us = static_cast<uint32_t>(milliseconds) * 1000u;
-    deadline_us = 0;
-    high = false;
-
-    gpio_init(gpio);
-    gpio_set_dir(gpio, GPIO_OUT);
-    gpio_pull_down(gpio);
-  }
-
-  void Update() {
-    if (high && static_cast<int32_t>(time_us_32() - deadline_us) >= 0) {
-      gpio_put(gpio, 0);
-      high = false;
-    }
-  }
-
-  void Trigger() {
-    deadline_us = time_us_32() + pulse_width_us;
-    gpio_put(gpio, 1);
-    high = true;
-  }
-};
+  }
+
+  // Raises the output delay_us from now. The pulse is shortened to half the
+  // time since the previous rise when that is less than the configured
+  // width, so multiplied clocks keep a low gap.
+  void Schedule(uint32_t delay_us) {
+    const uint32_t interrupts = save_and_disable_interrupts();
+    const uint64_t rise = time_us_64() + delay_us;
+    width_us = pulse_width_us;
+    if (have_rise && rise > last_rise_us &&
+        (rise - last_rise_us) / 2u < width_us) {
+      width_us = static_cast<uint32_t>((rise - last_rise_us) / 2u);
+    }
+    if (rise_pending) ++stats.overlaps;
+    rise_us = rise;
+    rise_pending = true;
+    rise_armed = false;
+    last_rise_us = rise;
+    have_rise = true;
+    Service();
+    restore_interrupts(interrupts);
+  }
+
+  TriggerOutStats Stats() const {
+    const uint32_t interrupts = save_and_disable_interrupts();
+    const TriggerOutStats out = stats;
+    restore_interrupts(interrupts);
+    return out;
+  }
+};
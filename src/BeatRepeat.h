@@ -0,0 +1,123 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Post-FX capture ring for beat-repeat effects. The audio engine records every
+// rendered source frame; a retrigger captures its first pass and then loops
+// that segment from SRAM instead of re-reading flash and re-running the chain.
+// Capture and playback both run in the audio ISR, so no barriers are needed.
+template <size_t Capacity>
+class BeatRepeat {
+  static_assert(Capacity > 1 && (Capacity & (Capacity - 1)) == 0,
+                "capture ring capacity must be a power of two");
+
+ public:
+  static constexpr uint32_t kRateOne = 256u;
+  static constexpr uint32_t kSemitoneUpQ8 = 271u;
+  static constexpr uint32_t kSemitoneDownQ8 = 242u;
+
+  // One semitone on from `rate_q8` in the chosen direction, within two
+  // octaves of the original pitch.
+  static uint32_t stepSemitone(uint32_t rate_q8, bool up, bool down) {
+    if (up && rate_q8 < 4u * kRateOne) return (rate_q8 * kSemitoneUpQ8) >> 8u;
+    if (down && rate_q8 > kRateOne / 4u) {
+      return (rate_q8 * kSemitoneDownQ8) >> 8u;
+    }
+    return rate_q8;
+  }
+
+  void capture(uint8_t value) {
+    ring_[write_ & kMask] = value;
+    ++write_;
+  }
+
+  // Monotonic count of captured frames. A segment is named by the position()
+  // observed just before its first frame was captured.
+  uint32_t position() const { return write_; }
+  static constexpr uint32_t capacity() { return Capacity; }
+
+  // Starts looping `length` frames captured from `start`. Fails when the
+  // segment is not fully captured yet or has already been overwritten.
+  bool start(uint32_t start, uint32_t length, bool reverse) {
+    if (length == 0 || length > Capacity) return false;
+    const uint32_t captured = write_ - start;
+    if (captured < length || captured > Capacity) return false;
+    start_ = start;
+    length_ = length;
+    reverse_ = reverse;
+    rate_q8_ = kRateOne;
+    read_q8_ = 0;
+    active_ = true;
+    return true;
+  }
+
+  void restart() { read_q8_ = 0; }
+  void stop() { active_ = false; }
+  bool active() const { return active_; }
+
+  // Read speed in Q8 source frames per output frame (256 = original pitch).
+  void setRate(uint32_t rate_q8) { rate_q8_ = rate_q8 == 0 ? 1u : rate_q8; }
+  uint32_t rate() const { return rate_q8_; }
+
+  // Source-frame clock increment for a pass pitched to `pass_rate_q8`. A
+  // replay is pitched by its read rate and keeps the clock at
+  // `increment_q32`; a pass rendered from the source, the capturing one
+  // included, runs the clock at the pass rate instead.
+  uint64_t sourceIncrementQ32(uint64_t increment_q32,
+                              uint32_t pass_rate_q8) const {
+    if (active_) return increment_q32;
+    const uint64_t pitched = (increment_q32 * pass_rate_q8) >> 8u;
+    return pitched == 0 ? 1u : pitched;
+  }
+
+  uint8_t next() {
+    uint32_t frame = read_q8_ >> 8u;
+    if (reverse_) frame = length_ - 1u - frame;
+    const uint8_t value = ring_[(start_ + frame) & kMask];
+    read_q8_ += rate_q8_;
+    const uint32_t length_q8 = length_ << 8u;
+    while (read_q8_ >= length_q8) read_q8_ -= length_q8;
+    return value;
+  }
+
+ private:
+  static constexpr uint32_t kMask = static_cast<uint32_t>(Capacity - 1u);
+
+  uint8_t ring_[Capacity]{};
+  uint32_t write_ = 0;
+  uint32_t start_ = 0;
+  uint32_t length_ = 0;
+  uint32_t rate_q8_ = kRateOne;
+  uint32_t read_q8_ = 0;
+  bool reverse_ = false;
+  bool active_ = false;
+};
+
+// The volume steps and one-pole lowpass sweep a retrigger lays over its
+// passes. Every pass goes through it, the capturing one included, so the
+// envelope ramps the same whether a pass is rendered or replayed. The sweep
+// keeps its own state and leaves the main biquad untouched.
+class RetrigEnvelope {
+ public:
+  void reset() { lpf_ = 0; }
+
+  // `shift` halves the level per step; `cut` runs from 0 (open) to
+  // `cut_max`, where the pole is at its slowest.
+  uint8_t apply(uint8_t input, uint8_t shift, uint32_t cut, uint32_t cut_max) {
+    int32_t value = static_cast<int32_t>(input) - 128;
+    if (shift > 0) {
+      value = value >= 0 ? value >> shift : -((-value) >> shift);
+    }
+    const int32_t k =
+        cut >= cut_max ? 16 : 256 - static_cast<int32_t>(cut * 240u / cut_max);
+    lpf_ += ((value - lpf_) * k) >> 8;
+    const int32_t output = lpf_ + 128;
+    if (output < 0) return 0;
+    if (output > 255) return 255;
+    return static_cast<uint8_t>(output);
+  }
+
+ private:
+  int32_t lpf_ = 0;
+};
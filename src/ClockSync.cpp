@@ -10,6 +10,19 @@ constexpr uint32_t kMinEdgeSpacingUs = 2000u;
 constexpr uint32_t kMinBpmX100 = 3000u;
 constexpr uint32_t kMaxBpmX100 = 36000u;
 constexpr uint32_t kLongHoldoverRestartUs = 1000000u;
+// Quarter-note intervals whose rounded tempo lies in [kMinBpmX100, kMaxBpmX100].
+constexpr uint32_t kMinQuarterUs = 166665u;
+constexpr uint32_t kMaxQuarterUs = 2000333u;
+constexpr uint32_t kHalfRangeUs = 0x80000000u;
+constexpr int32_t kMaxOutputOffsetUs = 20000;
+constexpr uint32_t kMaxFlywheelMs = 10000u;
+// A returning edge may sit this far from a coasted pulse slot, in percent of
+// one pulse, and still end the flywheel on its own.
+constexpr uint32_t kFlywheelSlotPercent = 15u;
+// Longest run of pulses one interval may span and still be matched as a gap
+// of missed pulses.
+constexpr uint8_t kMaxGapPulses = 4u;
+constexpr int64_t kMaxOutputOffsetQ32 = static_cast<int64_t>(kPhaseOne / 8u);
 
 uint32_t abs32(int32_t value) {
   if (value >= 0) return static_cast<uint32_t>(value);
@@ -22,6 +35,36 @@ uint32_t roundedDivide(uint64_t numerator, uint64_t denominator) {
   return static_cast<uint32_t>((numerator + denominator / 2u) / denominator);
 }
 
+// roundedDivide(6e9, quarter_us) without the 64-bit divide. A 32-bit
+// reciprocal lands within two hundredths of a BPM for every valid quarter,
+// and bpm is the rounded value exactly when (2 bpm - 1) q <= 12e9 <
+// (2 bpm + 1) q, so a few multiplies settle it. The divide stays as a
+// fallback should the estimate ever be further off.
+uint32_t bpmX100ForQuarter(uint32_t quarter_us) {
+  constexpr uint64_t kTwiceBpmQuarter = 12000000000ull;
+  constexpr uint32_t kMaxBpmSteps = 4u;
+  if (quarter_us == 0) return 0;
+  const uint32_t reciprocal_q32 = 0xffffffffu / quarter_us;
+  uint32_t bpm =
+      static_cast<uint32_t>((6000000000ull * reciprocal_q32) >> 32u);
+  for (uint32_t step = 0; bpm > 1u && step < kMaxBpmSteps; ++step) {
+    if ((2ull * bpm + 1u) * quarter_us <= kTwiceBpmQuarter) {
+      ++bpm;
+    } else if ((2ull * bpm - 1u) * quarter_us > kTwiceBpmQuarter) {
+      --bpm;
+    } else {
+      return bpm;
+    }
+  }
+  return roundedDivide(6000000000ull, quarter_us);
+}
+
+void compareSwap(uint32_t& a, uint32_t& b) {
+  const uint32_t lo = a < b ? a : b;
+  b = a < b ? b : a;
+  a = lo;
+}
+
 }  // namespace
 
 ClockSync::ClockSync(uint32_t carrier_hz) { setCarrierHz(carrier_hz); }
@@ -30,9 +73,24 @@ bool ClockSync::validPulsePpqn(uint8_t ppqn) {
   return ppqn == 1 || ppqn == 2 || ppqn == 4;
 }
 
+bool ClockSync::validPllShift(uint8_t shift) { return shift >= 1 && shift <= 6; }
+
+bool ClockSync::validOutputOffsetUs(int32_t offset_us) {
+  return offset_us >= -kMaxOutputOffsetUs && offset_us <= kMaxOutputOffsetUs;
+}
+
 void ClockSync::setCarrierHz(uint32_t carrier_hz) {
   carrier_hz_ = carrier_hz == 0 ? 1 : carrier_hz;
+  carrier_ticks_per_us_q32_ = (static_cast<uint64_t>(carrier_hz_) << 32u) /
+                              1000000u;
+  // 2^33 / (6000 carrier_hz) in Q32. Very slow carriers would overflow the
+  // tempo multiply and keep the divide instead.
+  const uint64_t increment_per_bpm =
+      ((1ull << 62u) + 375ull * carrier_hz_) / (750ull * carrier_hz_);
+  increment_per_bpm_x100_q32_ =
+      increment_per_bpm <= UINT64_MAX / kMaxBpmX100 ? increment_per_bpm : 0u;
   updateTransportIncrement();
+  setFilteredQuarter(filtered_quarter_us_);
 }
 
 void ClockSync::setInternalBpmX100(uint32_t bpm_x100) {
@@ -43,6 +101,7 @@ void ClockSync::setInternalBpmX100(uint32_t bpm_x100) {
     if (source_ == ClockSource::Internal) measured_bpm_x100_ = bpm_x100;
     updateTransportIncrement();
   }
+  refreshFastPath();
 }
 
 void ClockSync::setSource(ClockSource source, uint8_t pulse_ppqn,
@@ -57,6 +116,7 @@ void ClockSync::setSource(ClockSource source, uint8_t pulse_ppqn,
   state_ = source == ClockSource::Internal ? ClockState::Locked
                                            : ClockState::Unlocked;
   updateTransportIncrement();
+  refreshFastPath();
 }
 
 void ClockSync::setPulsePpqn(uint8_t pulse_ppqn, uint32_t now_us) {
@@ -67,6 +127,22 @@ void ClockSync::setPulsePpqn(uint8_t pulse_ppqn, uint32_t now_us) {
     resetAcquisition(now_us);
     state_ = ClockState::Unlocked;
   }
+  refreshFastPath();
+}
+
+void ClockSync::setFilterMode(ClockFilterMode mode, uint8_t pll_shift) {
+  if (validPllShift(pll_shift)) pll_shift_ = pll_shift;
+  if (mode == filter_mode_) return;
+  filter_mode_ = mode;
+  // Carry the current tempo across so a live switch does not re-acquire.
+  if (mode == ClockFilterMode::Pll) {
+    pll_period_q8_ = static_cast<uint32_t>(
+        (static_cast<uint64_t>(filtered_quarter_us_) << 8u) / sourcePpqn());
+    pll_slope_q8_ = 0;
+  } else {
+    interval_history_count_ = 0;
+    interval_history_pos_ = 0;
+  }
 }
 
 void ClockSync::resetAcquisition(uint32_t now_us) {
@@ -77,7 +153,7 @@ void ClockSync::resetAcquisition(uint32_t now_us) {
   consecutive_valid_intervals_ = 0;
   interval_history_count_ = 0;
   interval_history_pos_ = 0;
-  filtered_quarter_us_ = 0;
+  setFilteredQuarter(0);
   tempo_candidate_us_ = 0;
   have_tempo_candidate_ = false;
   jitter_us_ = 0;
@@ -86,7 +162,34 @@ void ClockSync::resetAcquisition(uint32_t now_us) {
   slew_ticks_remaining_ = 0;
 }
 
-void ClockSync::process(const ClockEvent& event) {
+void ClockSync::resetStatistics() {
+  deviation_histogram_ = {};
+  phase_error_histogram_ = {};
+  phase_snaps_ = 0;
+  phase_slews_ = 0;
+  max_phase_error_us_ = 0;
+}
+
+bool ClockSync::validFlywheelMs(uint32_t max_ms) {
+  return max_ms <= kMaxFlywheelMs;
+}
+
+void ClockSync::setFlywheelMs(uint32_t max_ms) {
+  if (!validFlywheelMs(max_ms)) return;
+  flywheel_max_us_ = max_ms * 1000u;
+  refreshFastPath();
+}
+
+void ClockSync::setOutputOffsetUs(int32_t offset_us) {
+  if (!validOutputOffsetUs(offset_us)) return;
+  output_offset_us_ = offset_us;
+  updateTransportIncrement();
+}
+
+ClockOutcome ClockSync::process(const ClockEvent& event) {
+  const uint32_t accepted = accepted_events_;
+  const uint32_t rejected = rejected_events_;
+  bool transport = false;
   switch (event.type) {
     case ClockEventType::Pulse:
       if (source_ == ClockSource::Pulse) {
@@ -94,13 +197,13 @@ void ClockSync::process(const ClockEvent& event) {
       }
       break;
     case ClockEventType::MidiClock:
-      if (source_ == ClockSource::Midi && midi_running_) {
+      if (midiSource() && midi_running_) {
         processLandmark(event.timestamp_us, 24);
       }
       break;
     case ClockEventType::MidiStart:
     case ClockEventType::MidiContinue:
-      if (source_ == ClockSource::Midi) {
+      if (midiSource()) {
         if (state_ == ClockState::Holdover &&
             event.timestamp_us - holdover_started_us_ >=
                 kLongHoldoverRestartUs) {
@@ -109,20 +212,30 @@ void ClockSync::process(const ClockEvent& event) {
         midi_running_ = true;
         resetAcquisition(event.timestamp_us);
         state_ = ClockState::Unlocked;
+        transport = true;
       }
       break;
     case ClockEventType::MidiStop:
-      if (source_ == ClockSource::Midi) {
+      if (midiSource()) {
         midi_running_ = false;
         state_ = ClockState::Unlocked;
         pending_beats_ = 0;
         loop_restart_pending_ = false;
+        transport = true;
       }
       break;
   }
+  refreshFastPath();
+  if (accepted_events_ != accepted) return ClockOutcome::Accepted;
+  if (rejected_events_ != rejected) return ClockOutcome::Rejected;
+  return transport ? ClockOutcome::Transport : ClockOutcome::Ignored;
 }
 
 void ClockSync::processLandmark(uint32_t timestamp_us, uint8_t ppqn) {
+  if (state_ == ClockState::Flywheel) {
+    recoverFromFlywheel(timestamp_us, ppqn);
+    return;
+  }
   bool returning_from_holdover = false;
   if (state_ == ClockState::Holdover) {
     if (timestamp_us - holdover_started_us_ >= kLongHoldoverRestartUs) {
@@ -151,10 +264,10 @@ void ClockSync::processLandmark(uint32_t timestamp_us, uint8_t ppqn) {
 
   uint8_t multiplier = 1;
   uint32_t normalized = elapsed;
-  const uint32_t expected = expectedPulseUs(ppqn);
+  const uint32_t expected = expectedPulseUs();
   bool expected_match = expected == 0 || intervalAgrees(elapsed, expected, 15);
   if (!expected_match && expected != 0) {
-    for (uint8_t candidate = 2; candidate <= 4; ++candidate) {
+    for (uint8_t candidate = 2; candidate <= kMaxGapPulses; ++candidate) {
       if (intervalAgrees(elapsed, expected * candidate, 15)) {
         multiplier = candidate;
         normalized = elapsed / candidate;
@@ -177,7 +290,7 @@ void ClockSync::processLandmark(uint32_t timestamp_us, uint8_t ppqn) {
       // retained as a candidate; the second starts a clean acquisition.
       interval_history_count_ = 0;
       interval_history_pos_ = 0;
-      filtered_quarter_us_ = 0;
+      setFilteredQuarter(0);
       consecutive_valid_intervals_ = 1;
       state_ = ClockState::Acquiring;
       updateFilteredInterval((normalized + tempo_candidate_us_) / 2u, ppqn,
@@ -203,6 +316,54 @@ void ClockSync::processLandmark(uint32_t timestamp_us, uint8_t ppqn) {
   acceptInterval(timestamp_us, normalized, multiplier, ppqn);
 }
 
+// The coasting transport kept the tempo, so the gap is counted in expected
+// pulses rather than measured as an interval, and phase slews back. The edge
+// passes the same spacing and tempo checks as a tracked one. An edge away
+// from the coasted grid is held as a candidate and ends the coast only when
+// the next edge follows it by one expected pulse, so a lone glitch cannot.
+void ClockSync::recoverFromFlywheel(uint32_t timestamp_us, uint8_t ppqn) {
+  const uint32_t elapsed = timestamp_us - last_edge_us_;
+  if (elapsed < kMinEdgeSpacingUs) {
+    ++rejected_events_;
+    return;
+  }
+  const uint32_t expected = expectedPulseUs();
+  uint32_t pulses = expected == 0 ? 1u : (elapsed + expected / 2u) / expected;
+  if (pulses == 0) pulses = 1;
+  const uint32_t slot_us = expected * pulses;
+  const uint32_t slot_error =
+      elapsed > slot_us ? elapsed - slot_us : slot_us - elapsed;
+  const bool on_grid = static_cast<uint64_t>(slot_error) * 100u <=
+                       static_cast<uint64_t>(expected) * kFlywheelSlotPercent;
+  const bool confirmed =
+      have_flywheel_candidate_ &&
+      intervalAgrees(timestamp_us - flywheel_candidate_us_, expected, 15);
+  if (!intervalBpmValid(elapsed / pulses, ppqn) || (!on_grid && !confirmed)) {
+    flywheel_candidate_us_ = timestamp_us;
+    have_flywheel_candidate_ = true;
+    ++rejected_events_;
+    return;
+  }
+  have_flywheel_candidate_ = false;
+  ++accepted_events_;
+  missed_events_ += pulses - 1u;
+  pulse_ordinal_ += pulses;
+  last_edge_us_ = timestamp_us;
+  have_tempo_candidate_ = false;
+  flywheel_time_ms_ += (timestamp_us - flywheel_started_us_) / 1000u;
+  ++flywheel_recoveries_;
+  state_ = ClockState::Locked;
+
+  relocking_ = true;
+  alignPhase(timestamp_us, ppqn, false);
+  relocking_ = false;
+  relock_phase_error_us_ = phase_error_us_;
+  const uint32_t magnitude = abs32(phase_error_us_);
+  if (magnitude > max_relock_phase_error_us_) {
+    max_relock_phase_error_us_ = magnitude;
+  }
+}
+
 void ClockSync::acceptFirstLandmark(uint32_t timestamp_us) {
   have_edge_ = true;
   first_edge_us_ = timestamp_us;
@@ -228,47 +389,124 @@ void ClockSync::acceptInterval(uint32_t timestamp_us, uint32_t interval_us,
 
 void ClockSync::updateFilteredInterval(uint32_t interval_us, uint8_t ppqn,
                                        bool reset_filter) {
-  const uint32_t quarter_us = interval_us * ppqn;
-  interval_history_[interval_history_pos_] = quarter_us;
-  interval_history_pos_ = (interval_history_pos_ + 1u) % 5u;
-  if (interval_history_count_ < 5) ++interval_history_count_;
-  const uint32_t median = medianInterval();
-  if (reset_filter || filtered_quarter_us_ == 0) {
-    filtered_quarter_us_ = median;
+  uint32_t filtered = filtered_quarter_us_;
+  if (filter_mode_ == ClockFilterMode::Pll) {
+    // The loop trims its period from phase residuals in alignPhase; intervals
+    // only seed it.
+    if (reset_filter || filtered_quarter_us_ == 0) {
+      pll_period_q8_ = interval_us << 8u;
+      pll_slope_q8_ = 0;
+      filtered = interval_us * ppqn;
+    }
   } else {
-    const int32_t delta = static_cast<int32_t>(median - filtered_quarter_us_);
-    filtered_quarter_us_ = static_cast<uint32_t>(
-        static_cast<int32_t>(filtered_quarter_us_) + delta / 4);
+    const uint32_t quarter_us = interval_us * ppqn;
+    interval_history_[interval_history_pos_] = quarter_us;
+    interval_history_pos_ = (interval_history_pos_ + 1u) % 5u;
+    if (interval_history_count_ < 5) ++interval_history_count_;
+    const uint32_t median = medianInterval();
+    filtered = median;
+    if (!reset_filter && filtered_quarter_us_ != 0) {
+      const int32_t delta = static_cast<int32_t>(median - filtered_quarter_us_);
+      filtered = static_cast<uint32_t>(
+          static_cast<int32_t>(filtered_quarter_us_) + delta / 4);
+    }
   }
-  const uint32_t deviation = interval_us > expectedPulseUs(ppqn)
-                                 ? interval_us - expectedPulseUs(ppqn)
-                                 : expectedPulseUs(ppqn) - interval_us;
+  const bool tempo_changed = filtered != filtered_quarter_us_;
+  if (tempo_changed) setFilteredQuarter(filtered);
+  const uint32_t expected = expectedPulseUs();
+  const uint32_t deviation =
+      interval_us > expected ? interval_us - expected : expected - interval_us;
+  deviation_histogram_.add(deviation);
   jitter_us_ = static_cast<uint32_t>(
       static_cast<int32_t>(jitter_us_) +
       (static_cast<int32_t>(deviation) - static_cast<int32_t>(jitter_us_)) /
           4);
-  measured_bpm_x100_ =
-      roundedDivide(6000000000ull, filtered_quarter_us_);
+  if (!tempo_changed) return;
+  applyFilteredQuarter(filtered_quarter_us_);
+}
+
+void ClockSync::applyFilteredQuarter(uint32_t quarter_us) {
+  if (quarter_us != filtered_quarter_us_) setFilteredQuarter(quarter_us);
+  measured_bpm_x100_ = bpmX100ForQuarter(filtered_quarter_us_);
   target_bpm_x100_ = measured_bpm_x100_;
   updateTransportIncrement();
 }
 
+// Integral paths of the Pll filter. A late edge (transport ahead, positive
+// residual) lengthens the period. The slope term follows the period's own
+// drift, so a tempo ramp is tracked without a standing phase lag.
+void ClockSync::trimPllPeriod(int32_t residual_us, uint8_t ppqn) {
+  const int64_t residual_q8 = static_cast<int64_t>(residual_us) * 256;
+  int64_t slope = pll_slope_q8_ + (residual_q8 >> (3u * pll_shift_ + 1u));
+  const int64_t max_slope = static_cast<int64_t>(pll_period_q8_ >> 4u);
+  if (slope > max_slope) slope = max_slope;
+  if (slope < -max_slope) slope = -max_slope;
+  pll_slope_q8_ = static_cast<int32_t>(slope);
+  const int64_t step =
+      pll_slope_q8_ + (residual_q8 >> (2u * pll_shift_));
+  // Clamp in quarter units so the per-edge path multiplies instead of
+  // dividing; only an out-of-range period pays for the divide.
+  constexpr int64_t kMinQuarterQ8 = static_cast<int64_t>(kMinQuarterUs) << 8u;
+  constexpr int64_t kMaxQuarterQ8 = static_cast<int64_t>(kMaxQuarterUs) << 8u;
+  int64_t period = static_cast<int64_t>(pll_period_q8_) + step;
+  if (period * ppqn < kMinQuarterQ8) period = kMinQuarterQ8 / ppqn;
+  if (period * ppqn > kMaxQuarterQ8) period = kMaxQuarterQ8 / ppqn;
+  pll_period_q8_ = static_cast<uint32_t>(period);
+  const uint32_t quarter_us = static_cast<uint32_t>(
+      (static_cast<uint64_t>(pll_period_q8_) * ppqn + 128u) >> 8u);
+  if (quarter_us != filtered_quarter_us_) applyFilteredQuarter(quarter_us);
+}
+
+void ClockSync::setFilteredQuarter(uint32_t quarter_us) {
+  filtered_quarter_us_ = quarter_us;
+  expected_pulse_us_ = quarter_us / sourcePpqn();
+  // Phase corrections slew over two expected pulses.
+  slew_ticks_ = static_cast<uint32_t>(
+      (static_cast<uint64_t>(expected_pulse_us_) * 2u *
+           carrier_ticks_per_us_q32_ +
+       0xffffffffu) >>
+      32u);
+  slew_reciprocal_q32_ = slew_ticks_ > 1u ? 0xffffffffu / slew_ticks_ : 0u;
+}
+
+// Upper median of the filled history. Until the history fills, entries are
+// stored from index 0, so the short cases only look at that prefix.
 uint32_t ClockSync::medianInterval() const {
-  if (interval_history_count_ == 0) return 0;
-  uint32_t values[5]{};
-  for (uint8_t i = 0; i < interval_history_count_; ++i) {
-    values[i] = interval_history_[i];
-  }
-  for (uint8_t i = 1; i < interval_history_count_; ++i) {
-    const uint32_t value = values[i];
-    uint8_t j = i;
-    while (j > 0 && values[j - 1] > value) {
-      values[j] = values[j - 1];
-      --j;
-    }
-    values[j] = value;
+  uint32_t v0 = interval_history_[0];
+  uint32_t v1 = interval_history_[1];
+  uint32_t v2 = interval_history_[2];
+  uint32_t v3 = interval_history_[3];
+  uint32_t v4 = interval_history_[4];
+  switch (interval_history_count_) {
+    case 0:
+      return 0;
+    case 1:
+      return v0;
+    case 2:
+      return v0 > v1 ? v0 : v1;
+    case 3:
+      compareSwap(v0, v1);
+      compareSwap(v1, v2);
+      compareSwap(v0, v1);
+      return v1;
+    case 4:
+      compareSwap(v0, v1);
+      compareSwap(v2, v3);
+      compareSwap(v0, v2);
+      compareSwap(v1, v3);
+      compareSwap(v1, v2);
+      return v2;
+    default:
+      // Seven compare-exchanges place the median of five at v2.
+      compareSwap(v0, v1);
+      compareSwap(v3, v4);
+      compareSwap(v0, v3);
+      compareSwap(v1, v4);
+      compareSwap(v1, v2);
+      compareSwap(v2, v3);
+      compareSwap(v1, v2);
+      return v2;
   }
-  return values[interval_history_count_ / 2u];
 }
 
 void ClockSync::alignPhase(uint32_t, uint8_t ppqn, bool first) {
@@ -281,29 +519,49 @@ void ClockSync::alignPhase(uint32_t, uint8_t ppqn, bool first) {
         (static_cast<uint64_t>(within) * kPhaseOne) / pulses_per_eighth);
     eighth_landmark = within == 0;
   }
+  desired_phase += static_cast<uint32_t>(output_offset_q32_);
 
   const int32_t phase_error =
       static_cast<int32_t>(static_cast<uint32_t>(transport_phase_q32_) -
                            desired_phase);
+  // Arithmetic shift: rounds toward negative infinity, which is within a
+  // microsecond of the truncating divide.
   phase_error_us_ = static_cast<int32_t>(
-      (static_cast<int64_t>(phase_error) * eighthPeriodUs()) /
-      static_cast<int64_t>(kPhaseOne));
+      (static_cast<int64_t>(phase_error) * eighthPeriodUs()) >> 32);
   const uint32_t absolute_error = abs32(phase_error_us_);
   if (absolute_error > max_phase_error_us_) max_phase_error_us_ = absolute_error;
 
-  const uint32_t expected = expectedPulseUs(ppqn);
-  const bool snap = first || expected == 0 || absolute_error > expected / 10u;
+  const uint32_t expected = expectedPulseUs();
+  const bool pll = filter_mode_ == ClockFilterMode::Pll;
+  // The loop, and a flywheel re-lock, absorb errors up to half a pulse;
+  // beyond that the transport re-anchors.
+  const bool snap =
+      first || expected == 0 ||
+      absolute_error > (pll || relocking_ ? expected / 2u : expected / 10u);
   if (eighth_landmark) {
-    const uint32_t quarter_beat_ticks =
-        static_cast<uint32_t>((static_cast<uint64_t>(carrier_hz_) *
-                               eighthPeriodUs()) /
-                              4000000ull);
-    if (first || carriers_since_beat_ > quarter_beat_ticks) {
+    const bool wrapped =
+        static_cast<uint32_t>(transport_phase_q32_) < kPhaseOne / 2u;
+    if (output_offset_q32_ < 0) {
+      // A lagging transport wraps after the landmark and that wrap is the
+      // beat. Snapping back across a wrap that already fired must not fire it
+      // a second time.
+      suppress_next_wrap_ = snap && !first && wrapped;
+    } else if (first || carriers_since_beat_ > quarter_beat_ticks_) {
       ++pending_beats_;
-      suppress_next_wrap_ = !snap;
+      // Only a transport still short of the boundary has that wrap ahead.
+      suppress_next_wrap_ = !snap && !wrapped;
     }
     carriers_since_beat_ = 0;
   }
+  // The first landmark only anchors the transport; it is not a correction.
+  if (!first) {
+    phase_error_histogram_.add(absolute_error);
+    if (snap) {
+      ++phase_snaps_;
+    } else {
+      ++phase_slews_;
+    }
+  }
   if (snap) {
     transport_phase_q32_ = desired_phase;
     slew_increment_q32_ = 0;
@@ -311,77 +569,144 @@ void ClockSync::alignPhase(uint32_t, uint8_t ppqn, bool first) {
     return;
   }
 
-  const uint64_t slew_us = static_cast<uint64_t>(expected) * 2u;
-  const uint32_t ticks = static_cast<uint32_t>(
-      (slew_us * carrier_hz_ + 999999u) / 1000000u);
-  if (ticks > 0) {
-    slew_ticks_remaining_ = ticks;
-    slew_increment_q32_ = -static_cast<int64_t>(phase_error) /
-                          static_cast<int64_t>(ticks);
+  int32_t correction = phase_error;
+  if (pll) {
+    trimPllPeriod(phase_error_us_, ppqn);
+    correction = phase_error >> (pll_shift_ - 1u);
+  }
+  if (slew_ticks_ > 0) {
+    slew_ticks_remaining_ = slew_ticks_;
+    slew_increment_q32_ =
+        slew_ticks_ == 1u
+            ? -static_cast<int64_t>(correction)
+            : (-static_cast<int64_t>(correction) * slew_reciprocal_q32_) >>
+                  32;
   }
 }
 
+// Runs on every tempo change, so the 64-bit divides are replaced by the
+// reciprocals cached in setCarrierHz; the remaining divide is 32-bit.
 void ClockSync::updateTransportIncrement() {
-  const uint64_t numerator =
-      static_cast<uint64_t>(target_bpm_x100_) * 2u * kPhaseOne;
-  const uint64_t denominator =
-      static_cast<uint64_t>(60u * 100u) * carrier_hz_;
-  transport_increment_q32_ =
-      denominator == 0 ? 1 : (numerator + denominator / 2u) / denominator;
+  if (increment_per_bpm_x100_q32_ != 0) {
+    transport_increment_q32_ =
+        (target_bpm_x100_ * increment_per_bpm_x100_q32_ + (1ull << 31u)) >>
+        32u;
+  } else {
+    const uint64_t numerator =
+        static_cast<uint64_t>(target_bpm_x100_) * 2u * kPhaseOne;
+    const uint64_t denominator =
+        static_cast<uint64_t>(60u * 100u) * carrier_hz_;
+    transport_increment_q32_ = (numerator + denominator / 2u) / denominator;
+  }
   if (transport_increment_q32_ == 0) transport_increment_q32_ = 1;
+  eighth_period_us_ =
+      target_bpm_x100_ == 0
+          ? 0
+          : (3000000000u + target_bpm_x100_ / 2u) / target_bpm_x100_;
+  // carrier_hz * eighth / 4e6 through the cached carriers per microsecond;
+  // the truncated reciprocal can land one short, which the check restores.
+  const uint64_t carrier_eighth =
+      static_cast<uint64_t>(carrier_hz_) * eighth_period_us_;
+  quarter_beat_ticks_ = static_cast<uint32_t>(
+      (eighth_period_us_ * carrier_ticks_per_us_q32_) >> 34u);
+  if ((quarter_beat_ticks_ + 1ull) * 4000000u <= carrier_eighth) {
+    ++quarter_beat_ticks_;
+  }
+  // Phase per microsecond is the per-carrier increment scaled by carriers
+  // per microsecond, so the offset needs no divide on every tempo update.
+  const int64_t phase_per_us = static_cast<int64_t>(
+      (transport_increment_q32_ * carrier_ticks_per_us_q32_) >> 32u);
+  int64_t offset_q32 = output_offset_us_ * phase_per_us;
+  if (offset_q32 > kMaxOutputOffsetQ32) offset_q32 = kMaxOutputOffsetQ32;
+  if (offset_q32 < -kMaxOutputOffsetQ32) offset_q32 = -kMaxOutputOffsetQ32;
+  output_offset_q32_ = static_cast<int32_t>(offset_q32);
+}
+
+void ClockSync::refreshFastPath() {
+  const bool external =
+      source_ == ClockSource::Pulse || midiSource();
+  const bool flywheel = state_ == ClockState::Flywheel;
+  const bool tracking = external && have_edge_ &&
+                        (state_ == ClockState::Acquiring ||
+                         state_ == ClockState::Locked || flywheel);
+  // MIDI clock holds on through any gap processLandmark can still match (up
+  // to kMaxGapPulses clocks, plus its 15% tolerance), so a few dropped bytes
+  // do not cost a holdover and its re-anchor. A pulse clock missing even one
+  // edge has most likely stopped.
+  const uint32_t missed_window_us =
+      midiSource() ? expected_pulse_us_ * kMaxGapPulses +
+                         expected_pulse_us_ * 3u / 4u
+                   : expected_pulse_us_ * 2u;
+  holdover_window_us_ =
+      tracking ? missed_window_us + (flywheel ? flywheel_max_us_ : 0u) : 0u;
+  carrier_idle_ = (midiSource() && !midi_running_) ||
+                  state_ == ClockState::Holdover;
+  awaiting_tempo_ = external && have_edge_ && filtered_quarter_us_ == 0;
+}
+
+void ClockSync::enterHoldover(uint32_t now_us) {
+  if (state_ == ClockState::Locked && flywheel_max_us_ != 0) {
+    state_ = ClockState::Flywheel;
+    flywheel_started_us_ = now_us;
+    have_flywheel_candidate_ = false;
+    ++flywheel_entries_;
+  } else {
+    if (state_ == ClockState::Flywheel) {
+      flywheel_time_ms_ += (now_us - flywheel_started_us_) / 1000u;
+      ++flywheel_expiries_;
+    }
+    state_ = ClockState::Holdover;
+    holdover_started_us_ = now_us;
+  }
+  refreshFastPath();
 }
 
 bool ClockSync::advanceCarrier(uint32_t now_us) {
-  updateHoldover(now_us);
-  if (source_ == ClockSource::Midi && !midi_running_) return false;
-  if (state_ == ClockState::Holdover) return false;
+  // A higher-priority capture ISR can publish an edge between a caller's time
+  // sample and queue drain. Treat an apparent gap over half the uint32 range as
+  // a slightly stale `now`, while preserving ordinary time_us_32 wraparound.
+  // With the window w armed, `elapsed - w < 2^31 - w` is exactly
+  // `w <= elapsed < 2^31` in one unsigned compare.
+  const uint32_t window = holdover_window_us_;
+  if (window != 0 &&
+      (now_us - last_edge_us_) - window < kHalfRangeUs - window) {
+    enterHoldover(now_us);
+  }
+  if (carrier_idle_) return false;
   if (pending_beats_ > 0) {
     --pending_beats_;
     return true;
   }
-  if (source_ != ClockSource::Internal && have_edge_ &&
-      filtered_quarter_us_ == 0) {
-    ++carriers_since_beat_;
+  ++carriers_since_beat_;
+  if (awaiting_tempo_) return false;
+
+  if (slew_ticks_remaining_ > 0) return advanceSlewing();
+  transport_phase_q32_ += transport_increment_q32_;
+  if (transport_phase_q32_ < kPhaseOne) return false;
+  transport_phase_q32_ -= kPhaseOne;
+  if (suppress_next_wrap_) {
+    suppress_next_wrap_ = false;
     return false;
   }
+  carriers_since_beat_ = 0;
+  return true;
+}
 
-  int64_t increment = static_cast<int64_t>(transport_increment_q32_);
-  if (slew_ticks_remaining_ > 0) {
-    increment += slew_increment_q32_;
-    --slew_ticks_remaining_;
-    if (slew_ticks_remaining_ == 0) slew_increment_q32_ = 0;
-  }
+bool ClockSync::advanceSlewing() {
+  int64_t increment =
+      static_cast<int64_t>(transport_increment_q32_) + slew_increment_q32_;
+  --slew_ticks_remaining_;
+  if (slew_ticks_remaining_ == 0) slew_increment_q32_ = 0;
   if (increment < 1) increment = 1;
   transport_phase_q32_ += static_cast<uint64_t>(increment);
-  ++carriers_since_beat_;
-  if (transport_phase_q32_ >= kPhaseOne) {
-    transport_phase_q32_ -= kPhaseOne;
-    if (suppress_next_wrap_) {
-      suppress_next_wrap_ = false;
-      return false;
-    }
-    carriers_since_beat_ = 0;
-    return true;
-  }
-  return false;
-}
-
-void ClockSync::updateHoldover(uint32_t now_us) {
-  if ((source_ != ClockSource::Pulse && source_ != ClockSource::Midi) ||
-      !have_edge_ || state_ == ClockState::Unlocked ||
-      state_ == ClockState::Holdover) {
-    return;
-  }
-  const uint8_t ppqn = source_ == ClockSource::Midi ? 24 : pulse_ppqn_;
-  const uint32_t expected = expectedPulseUs(ppqn);
-  const uint32_t elapsed = now_us - last_edge_us_;
-  // A higher-priority capture ISR can publish an edge between a caller's time
-  // sample and queue drain. Treat an apparent gap over half the uint32 range as
-  // a slightly stale `now`, while preserving ordinary time_us_32 wraparound.
-  if (expected > 0 && elapsed < 0x80000000u && elapsed >= expected * 2u) {
-    state_ = ClockState::Holdover;
-    holdover_started_us_ = now_us;
+  if (transport_phase_q32_ < kPhaseOne) return false;
+  transport_phase_q32_ -= kPhaseOne;
+  if (suppress_next_wrap_) {
+    suppress_next_wrap_ = false;
+    return false;
   }
+  carriers_since_beat_ = 0;
+  return true;
 }
 
 bool ClockSync::consumeLoopRestart() {
@@ -390,21 +715,13 @@ bool ClockSync::consumeLoopRestart() {
   return restart;
 }
 
-uint32_t ClockSync::expectedPulseUs(uint8_t ppqn) const {
-  if (ppqn == 0 || filtered_quarter_us_ == 0) return 0;
-  return filtered_quarter_us_ / ppqn;
-}
-
-uint32_t ClockSync::eighthPeriodUs() const {
-  if (target_bpm_x100_ == 0) return 0;
-  return roundedDivide(3000000000ull, target_bpm_x100_);
+uint8_t ClockSync::sourcePpqn() const {
+  return midiSource() ? 24 : pulse_ppqn_;
 }
 
 bool ClockSync::intervalBpmValid(uint32_t interval_us, uint8_t ppqn) const {
-  if (interval_us == 0 || ppqn == 0) return false;
-  const uint32_t bpm_x100 =
-      roundedDivide(6000000000ull, static_cast<uint64_t>(interval_us) * ppqn);
-  return bpm_x100 >= kMinBpmX100 && bpm_x100 <= kMaxBpmX100;
+  const uint64_t quarter_us = static_cast<uint64_t>(interval_us) * ppqn;
+  return quarter_us >= kMinQuarterUs && quarter_us <= kMaxQuarterUs;
 }
 
 bool ClockSync::intervalAgrees(uint32_t a, uint32_t b,
@@ -427,7 +744,21 @@ ClockDiagnostics ClockSync::diagnostics() const {
           pulse_ppqn_,
           accepted_events_,
           rejected_events_,
-          missed_events_};
+          missed_events_,
+          filter_mode_,
+          pll_shift_,
+          output_offset_us_,
+          flywheel_max_us_ / 1000u,
+          flywheel_entries_,
+          flywheel_recoveries_,
+          flywheel_expiries_,
+          flywheel_time_ms_,
+          relock_phase_error_us_,
+          max_relock_phase_error_us_,
+          deviation_histogram_,
+          phase_error_histogram_,
+          phase_snaps_,
+          phase_slews_};
 }
 
 uint64_t ClockSync::playbackIncrementQ32(uint32_t carrier_hz,
@@ -448,6 +779,8 @@ const char* clockSourceName(ClockSource source) {
       return "PULSE";
     case ClockSource::Midi:
       return "MIDI";
+    case ClockSource::UsbMidi:
+      return "USB_MIDI";
   }
   return "INTERNAL";
 }
@@ -462,8 +795,44 @@ const char* clockStateName(ClockState state) {
       return "LOCKED";
     case ClockState::Holdover:
       return "HOLDOVER";
+    case ClockState::Flywheel:
+      return "FLYWHEEL";
   }
   return "UNLOCKED";
 }
 
+const char* clockFilterModeName(ClockFilterMode mode) {
+  return mode == ClockFilterMode::Pll ? "PLL" : "MEDIAN";
+}
+
+const char* clockEventTypeName(ClockEventType type) {
+  switch (type) {
+    case ClockEventType::Pulse:
+      return "PULSE";
+    case ClockEventType::MidiClock:
+      return "MIDI_CLOCK";
+    case ClockEventType::MidiStart:
+      return "MIDI_START";
+    case ClockEventType::MidiContinue:
+      return "MIDI_CONTINUE";
+    case ClockEventType::MidiStop:
+      return "MIDI_STOP";
+  }
+  return "UNKNOWN";
+}
+
+const char* clockOutcomeName(ClockOutcome outcome) {
+  switch (outcome) {
+    case ClockOutcome::Ignored:
+      return "IGNORED";
+    case ClockOutcome::Accepted:
+      return "ACCEPTED";
+    case ClockOutcome::Rejected:
+      return "REJECTED";
+    case ClockOutcome::Transport:
+      return "TRANSPORT";
+  }
+  return "UNKNOWN";
+}
+
 }  // namespace piko
@@ -3,14 +3,22 @@
 #include <stddef.h>
 #include <stdint.h>
 
+#include "Log2Histogram.h"
+
 namespace piko {
 
-enum class ClockSource : uint8_t { Internal = 0, Pulse = 1, Midi = 2 };
+enum class ClockSource : uint8_t {
+  Internal = 0,
+  Pulse = 1,
+  Midi = 2,     // one-wire MIDI on the clock jack
+  UsbMidi = 3,  // MIDI from the USB host
+};
 enum class ClockState : uint8_t {
   Unlocked = 0,
   Acquiring = 1,
   Locked = 2,
   Holdover = 3,
+  Flywheel = 4,  // clock lost, transport coasting at the last tempo
 };
 enum class ClockEventType : uint8_t {
   Pulse = 0,
@@ -20,11 +28,41 @@ enum class ClockEventType : uint8_t {
   MidiStop = 4,
 };
 
+// Tempo tracking filter. Median smooths a 5-interval median with a 1/4 IIR
+// and corrects phase by snapping or slewing. Pll is a fixed-point third-order
+// (alpha-beta-gamma) loop: each edge's phase residual nudges phase, period and
+// the period's drift per pulse, so tempo ramps are followed without a
+// standing phase lag.
+enum class ClockFilterMode : uint8_t { Median = 0, Pll = 1 };
+
 struct ClockEvent {
   ClockEventType type;
   uint32_t timestamp_us;
 };
 
+// What process() did with an event: Accepted and Rejected follow the
+// diagnostic counters, Transport covers MIDI start/continue/stop handling and
+// Ignored means the event did not apply to the selected source.
+enum class ClockOutcome : uint8_t {
+  Ignored = 0,
+  Accepted = 1,
+  Rejected = 2,
+  Transport = 3,
+};
+
+// One recorded event as stored on the device and sent by the capture download.
+// Fields are little-endian on the wire in declaration order.
+struct ClockCaptureRecord {
+  uint32_t timestamp_us;
+  ClockEventType type;
+  ClockOutcome outcome;
+  ClockState state;  // after processing
+  uint8_t reserved;
+};
+static_assert(sizeof(ClockCaptureRecord) == 8, "capture record is 8 bytes");
+
+using ClockHistogram = Log2Histogram;
+
 struct ClockDiagnostics {
   ClockSource source;
   ClockState state;
@@ -38,6 +76,20 @@ struct ClockDiagnostics {
   uint32_t accepted_events;
   uint32_t rejected_events;
   uint32_t missed_events;
+  ClockFilterMode filter_mode;
+  uint8_t pll_shift;
+  int32_t output_offset_us;
+  uint32_t flywheel_max_ms;
+  uint32_t flywheel_entries;
+  uint32_t flywheel_recoveries;
+  uint32_t flywheel_expiries;
+  uint32_t flywheel_time_ms;        // total time spent coasting
+  int32_t relock_phase_error_us;    // at the most recent recovery
+  uint32_t max_relock_phase_error_us;
+  ClockHistogram deviation_histogram;    // |interval - expected| per interval
+  ClockHistogram phase_error_histogram;  // |phase error| per landmark
+  uint32_t phase_snaps;
+  uint32_t phase_slews;
 };
 
 class ClockSync {
@@ -48,7 +100,23 @@ class ClockSync {
   void setInternalBpmX100(uint32_t bpm_x100);
   void setSource(ClockSource source, uint8_t pulse_ppqn, uint32_t now_us);
   void setPulsePpqn(uint8_t pulse_ppqn, uint32_t now_us);
-  void process(const ClockEvent& event);
+  // In Pll mode the phase gain is 2^-(pll_shift - 1), the period gain
+  // 2^-(2 * pll_shift) and the drift gain 2^-(3 * pll_shift + 1); larger
+  // shifts narrow the loop bandwidth.
+  void setFilterMode(ClockFilterMode mode, uint8_t pll_shift);
+  // Shifts the transport against external landmarks to cancel output
+  // latency: positive leads the clock, negative lags it. The shift is capped
+  // at an eighth of the current eighth-note period.
+  void setOutputOffsetUs(int32_t offset_us);
+  // With a non-zero limit, losing a locked clock coasts the transport at the
+  // last filtered tempo for up to max_ms before pausing in Holdover. A clock
+  // that returns in time re-locks by slewing; its pulse ordinal is inferred
+  // from the elapsed time. 0 pauses immediately, as before.
+  void setFlywheelMs(uint32_t max_ms);
+  ClockOutcome process(const ClockEvent& event);
+  // Clears the histograms, snap and slew counts and maximum phase error
+  // without disturbing lock.
+  void resetStatistics();
 
   // Called once per PWM carrier IRQ. Returns true for one unified eighth-note
   // event. External-clock holdover pauses until a pulse or MIDI transport start
@@ -57,6 +125,7 @@ class ClockSync {
   bool advanceCarrier(uint32_t now_us);
 
   ClockDiagnostics diagnostics() const;
+  ClockState state() const { return state_; }
   uint64_t transportPhaseQ32() const { return transport_phase_q32_; }
   uint32_t carrierHz() const { return carrier_hz_; }
   uint32_t targetBpmX100() const { return target_bpm_x100_; }
@@ -65,6 +134,9 @@ class ClockSync {
   bool consumeLoopRestart();
 
   static bool validPulsePpqn(uint8_t ppqn);
+  static bool validPllShift(uint8_t shift);
+  static bool validOutputOffsetUs(int32_t offset_us);
+  static bool validFlywheelMs(uint32_t max_ms);
   static uint64_t playbackIncrementQ32(uint32_t carrier_hz,
                                        uint32_t target_bpm_x100,
                                        uint32_t source_bpm);
@@ -79,9 +151,19 @@ class ClockSync {
   void updateFilteredInterval(uint32_t interval_us, uint8_t ppqn,
                               bool reset_filter);
   void updateTransportIncrement();
-  void updateHoldover(uint32_t now_us);
-  uint32_t expectedPulseUs(uint8_t ppqn) const;
-  uint32_t eighthPeriodUs() const;
+  void setFilteredQuarter(uint32_t quarter_us);
+  void trimPllPeriod(int32_t residual_us, uint8_t ppqn);
+  void applyFilteredQuarter(uint32_t quarter_us);
+  void refreshFastPath();
+  void enterHoldover(uint32_t now_us);
+  void recoverFromFlywheel(uint32_t timestamp_us, uint8_t ppqn);
+  bool advanceSlewing();
+  uint8_t sourcePpqn() const;
+  bool midiSource() const {
+    return source_ == ClockSource::Midi || source_ == ClockSource::UsbMidi;
+  }
+  uint32_t expectedPulseUs() const { return expected_pulse_us_; }
+  uint32_t eighthPeriodUs() const { return eighth_period_us_; }
   uint32_t medianInterval() const;
   bool intervalBpmValid(uint32_t interval_us, uint8_t ppqn) const;
   bool intervalAgrees(uint32_t a, uint32_t b, uint32_t percent) const;
@@ -96,6 +178,29 @@ class ClockSync {
   uint32_t measured_bpm_x100_ = 0;
   uint32_t target_bpm_x100_ = 16500;
   uint32_t filtered_quarter_us_ = 0;
+  ClockFilterMode filter_mode_ = ClockFilterMode::Median;
+  uint8_t pll_shift_ = 2;
+  uint32_t pll_period_q8_ = 0;  // pulse period in 1/256 us
+  int32_t pll_slope_q8_ = 0;    // period change per pulse in 1/256 us
+  int32_t output_offset_us_ = 0;
+  int32_t output_offset_q32_ = 0;  // offset as a fraction of an eighth
+  uint32_t flywheel_max_us_ = 0;
+
+  // Derived from tempo and carrier rate, refreshed only when those change so
+  // per-edge and per-carrier work avoids 64-bit division.
+  uint64_t carrier_ticks_per_us_q32_ = 0;
+  uint64_t increment_per_bpm_x100_q32_ = 0;  // 0: divide in full
+  uint32_t eighth_period_us_ = 0;
+  uint32_t quarter_beat_ticks_ = 0;
+  uint32_t expected_pulse_us_ = 0;
+  uint32_t slew_ticks_ = 0;
+  uint32_t slew_reciprocal_q32_ = 0;
+
+  // advanceCarrier fast-path flags, refreshed after every state change.
+  uint32_t holdover_window_us_ = 0;  // 0 disarms the holdover check
+  bool carrier_idle_ = false;
+  bool awaiting_tempo_ = false;
+
   uint64_t transport_increment_q32_ = 0;
   uint64_t transport_phase_q32_ = 0;
   int64_t slew_increment_q32_ = 0;
@@ -123,9 +228,28 @@ class ClockSync {
   uint32_t rejected_events_ = 0;
   uint32_t missed_events_ = 0;
   bool loop_restart_pending_ = false;
+
+  uint32_t flywheel_started_us_ = 0;
+  uint32_t flywheel_candidate_us_ = 0;  // off-grid edge seen while coasting
+  bool have_flywheel_candidate_ = false;
+  uint32_t flywheel_entries_ = 0;
+  uint32_t flywheel_recoveries_ = 0;
+  uint32_t flywheel_expiries_ = 0;
+  uint32_t flywheel_time_ms_ = 0;
+  int32_t relock_phase_error_us_ = 0;
+  uint32_t max_relock_phase_error_us_ = 0;
+  bool relocking_ = false;
+
+  ClockHistogram deviation_histogram_{};
+  ClockHistogram phase_error_histogram_{};
+  uint32_t phase_snaps_ = 0;
+  uint32_t phase_slews_ = 0;
 };
 
 const char* clockSourceName(ClockSource source);
 const char* clockStateName(ClockState state);
+const char* clockFilterModeName(ClockFilterMode mode);
+const char* clockEventTypeName(ClockEventType type);
+const char* clockOutcomeName(ClockOutcome outcome);
 
 }  // namespace piko
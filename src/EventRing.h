@@ -0,0 +1,64 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// A bounded single-producer recorder that keeps the newest Capacity entries.
+// Unlike SpscQueue it never refuses a push; the oldest entry is overwritten.
+// A reader on another core calls hold(true), waits out any producer call
+// already in flight, copies entries with at(), then releases with hold(false).
+template <typename T, size_t Capacity>
+class EventRing {
+  static_assert(Capacity > 1 && (Capacity & (Capacity - 1)) == 0,
+                "event ring capacity must be a power of two");
+
+ public:
+  void push(const T& value) {
+    if (held_) {
+      ++held_drops_;
+      return;
+    }
+    const uint32_t written = written_;
+    entries_[written & kMask] = value;
+    barrier();
+    written_ = written + 1u;
+  }
+
+  void hold(bool held) {
+    held_ = held;
+    barrier();
+  }
+
+  // Only valid while held or from the producer's context.
+  void clear() {
+    written_ = 0;
+    barrier();
+  }
+
+  // Total entries pushed since the last clear, including overwritten ones.
+  uint32_t written() const { return written_; }
+  uint32_t size() const {
+    const uint32_t written = written_;
+    return written < Capacity ? written : static_cast<uint32_t>(Capacity);
+  }
+  // index 0 is the oldest retained entry.
+  const T& at(uint32_t index) const {
+    return entries_[(written_ - size() + index) & kMask];
+  }
+  uint32_t heldDrops() const { return held_drops_; }
+  static constexpr uint32_t capacity() { return Capacity; }
+
+ private:
+  static constexpr uint32_t kMask = static_cast<uint32_t>(Capacity - 1u);
+
+  static void barrier() {
+#if defined(__GNUC__)
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+#endif
+  }
+
+  T entries_[Capacity]{};
+  volatile uint32_t written_ = 0;
+  volatile uint32_t held_drops_ = 0;
+  volatile bool held_ = false;
+};
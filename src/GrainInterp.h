@@ -0,0 +1,50 @@
+#pragma once
+
+#include <stdint.h>
+
+// Grain read interpolation. Costs per output sample cover both overlapping
+// grains (two window multiplies are paid by every tier):
+//   Nearest: 2 flash reads, no interpolation multiplies.
+//   Linear:  4 flash reads, 2 64-bit fraction multiplies.
+//   Cubic:   8 flash reads, 8 32-bit multiplies (4-point Catmull-Rom).
+enum class GrainInterp : uint8_t { Nearest = 0, Linear = 1, Cubic = 2 };
+
+inline bool validGrainInterp(uint8_t value) {
+  return value <= static_cast<uint8_t>(GrainInterp::Cubic);
+}
+
+// Reads a looping source of `frame_count` unsigned 8-bit frames at a Q32
+// phase already wrapped into the loop, centred on zero. `read(frame)` returns
+// one stored frame; neighbours wrap around the loop ends.
+template <typename Read>
+int16_t interpolateGrainSample(GrainInterp mode, uint32_t frame_count,
+                               uint64_t phase_q32, Read&& read) {
+  const uint32_t frame = static_cast<uint32_t>(phase_q32 >> 32u);
+  const uint32_t next_frame = frame + 1u < frame_count ? frame + 1u : 0u;
+  const uint32_t frac = static_cast<uint32_t>(phase_q32);
+
+  const int16_t a = static_cast<int16_t>(read(frame)) - 128;
+  if (mode == GrainInterp::Nearest) {
+    return a;
+  }
+  const int16_t b = static_cast<int16_t>(read(next_frame)) - 128;
+  if (mode == GrainInterp::Cubic) {
+    const uint32_t prev_frame = frame > 0 ? frame - 1u : frame_count - 1u;
+    const uint32_t after_frame =
+        next_frame + 1u < frame_count ? next_frame + 1u : 0u;
+    const int32_t p0 = static_cast<int32_t>(read(prev_frame)) - 128;
+    const int32_t p3 = static_cast<int32_t>(read(after_frame)) - 128;
+    // Catmull-Rom in Q8 fraction so every product fits 32 bits.
+    const int32_t t = static_cast<int32_t>(frac >> 24u);
+    const int32_t c1 = (b - p0) / 2;
+    const int32_t c2 = p0 - (5 * a) / 2 + 2 * b - p3 / 2;
+    const int32_t c3 = (p3 - p0) / 2 + (3 * (a - b)) / 2;
+    const int32_t cubic =
+        ((((((c3 * t) >> 8) + c2) * t >> 8) + c1) * t >> 8) + a;
+    return static_cast<int16_t>(cubic);
+  }
+  const int32_t diff = static_cast<int32_t>(b) - static_cast<int32_t>(a);
+  return static_cast<int16_t>(
+      static_cast<int32_t>(a) +
+      static_cast<int32_t>((static_cast<int64_t>(diff) * frac) >> 32u));
+}
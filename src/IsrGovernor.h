@@ -0,0 +1,94 @@
+#pragma once
+
+#include <stdint.h>
+
+// Quality levels shed in order as the audio ISR runs out of headroom.
+enum class DegradeLevel : uint8_t {
+  Full = 0,
+  ShortCrossfade = 1,
+  NearestGrains = 2,
+  FilterBypass = 3,
+  FewerVoices = 4,
+};
+
+// Tracks audio ISR cost against the carrier period. A peak estimate rises
+// instantly and decays slowly; crossing the shed threshold drops one quality
+// level, and a long calm stretch below the restore threshold brings one back.
+// update() is O(1) and division-free so it can run at the end of every IRQ.
+class IsrGovernor {
+ public:
+  static constexpr uint8_t kLevels = 5;
+  static constexpr uint32_t kShedPercent = 90u;
+  static constexpr uint32_t kRestorePercent = 60u;
+  static constexpr uint32_t kPeakDecayShift = 10u;
+  static constexpr uint32_t kHoldoffIrqs = 1024u;
+  static constexpr uint32_t kRestoreIrqs = 16384u;
+  static constexpr uint32_t kMaxCycles = 0x00ffffffu;
+
+  explicit IsrGovernor(uint32_t budget_cycles = 1) { setBudget(budget_cycles); }
+
+  void setBudget(uint32_t budget_cycles) {
+    budget_ = budget_cycles == 0 ? 1u : budget_cycles;
+    shed_cycles_ = budget_ * kShedPercent / 100u;
+    restore_cycles_ = budget_ * kRestorePercent / 100u;
+  }
+
+  // Feeds the cycles the last IRQ used and returns the level for the next one.
+  DegradeLevel update(uint32_t used_cycles) {
+    if (used_cycles > budget_) ++overruns_;
+    if (used_cycles > kMaxCycles) used_cycles = kMaxCycles;
+    const uint32_t used_q8 = used_cycles << 8u;
+    if (used_q8 >= peak_q8_) {
+      peak_q8_ = used_q8;
+    } else {
+      peak_q8_ -= (peak_q8_ - used_q8) >> kPeakDecayShift;
+    }
+
+    if (holdoff_ > 0) {
+      --holdoff_;
+      return level();
+    }
+    const uint32_t peak = peak_q8_ >> 8u;
+    if (peak > shed_cycles_) {
+      calm_ = 0;
+      if (level_ + 1u < kLevels) enter(level_ + 1u);
+    } else if (peak < restore_cycles_) {
+      if (++calm_ >= kRestoreIrqs) {
+        calm_ = 0;
+        if (level_ > 0) enter(level_ - 1u);
+      }
+    } else {
+      calm_ = 0;
+    }
+    return level();
+  }
+
+  DegradeLevel level() const { return static_cast<DegradeLevel>(level_); }
+  uint32_t budget() const { return budget_; }
+  uint32_t peakCycles() const { return peak_q8_ >> 8u; }
+  uint32_t overruns() const { return overruns_; }
+  uint32_t entries(DegradeLevel level) const {
+    return entries_[static_cast<uint8_t>(level)];
+  }
+  uint32_t headroomPercent() const {
+    const uint32_t peak = peakCycles();
+    return peak >= budget_ ? 0u : (budget_ - peak) * 100u / budget_;
+  }
+
+ private:
+  void enter(uint32_t level) {
+    level_ = static_cast<uint8_t>(level);
+    ++entries_[level_];
+    holdoff_ = kHoldoffIrqs;
+  }
+
+  uint32_t budget_ = 1;
+  uint32_t shed_cycles_ = 1;
+  uint32_t restore_cycles_ = 0;
+  volatile uint32_t peak_q8_ = 0;  // cycles in Q8 so slow decay is exact
+  volatile uint32_t overruns_ = 0;
+  volatile uint32_t entries_[kLevels]{};
+  uint32_t holdoff_ = 0;
+  uint32_t calm_ = 0;
+  volatile uint8_t level_ = 0;
+};
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <stdint.h>
+
+namespace piko {
+
+// Log2 histogram in microseconds: bucket 0 counts zero, bucket n counts
+// [2^(n-1), 2^n) and the last bucket everything from 2^(kBuckets-2) up.
+struct Log2Histogram {
+  static constexpr uint8_t kBuckets = 16;
+  uint32_t counts[kBuckets];
+
+  static uint8_t bucket(uint32_t value_us) {
+    if (value_us == 0) return 0;
+    const uint8_t width = static_cast<uint8_t>(32 - __builtin_clz(value_us));
+    return width < kBuckets ? width : kBuckets - 1u;
+  }
+  void add(uint32_t value_us) { ++counts[bucket(value_us)]; }
+};
+
+}  // namespace piko
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <stdint.h>
+
+// Derives 24-PPQN MIDI clock and transport messages from the ClockSync
+// transport phase (one eighth note per 2^32). The phase is unwrapped into an
+// absolute position that never runs backwards, so phase snaps hold the clock
+// instead of re-sending ticks, and every eighth carries exactly twelve ticks.
+// Ticks are due at absolute phase positions rather than after the previous
+// send, so delivery jitter never accumulates into tempo drift.
+class MidiClockOut {
+ public:
+  static constexpr uint8_t kClock = 0xF8;
+  static constexpr uint8_t kStart = 0xFA;
+  static constexpr uint8_t kContinue = 0xFB;
+  static constexpr uint8_t kStop = 0xFC;
+  static constexpr uint32_t kTicksPerEighth = 12;
+
+  // The next run begins with Start on an eighth boundary. While running, the
+  // Start goes out just before the next boundary tick.
+  void requestStart() { start_pending_ = true; }
+
+  // Called once per carrier. emit(status) receives every message due.
+  template <typename Emit>
+  void update(uint32_t phase_q32, bool running, Emit&& emit) {
+    const int32_t delta = static_cast<int32_t>(phase_q32 - last_phase_);
+    last_phase_ = phase_q32;
+    transport_q32_ += delta;
+
+    if (!running) {
+      if (sending_) emit(kStop);
+      sending_ = false;
+      running_ = false;
+      return;
+    }
+    if (!running_) {
+      running_ = true;
+      if (transport_q32_ > position_q32_) position_q32_ = transport_q32_;
+      next_tick_ = (static_cast<uint64_t>(position_q32_) * kTicksPerEighth +
+                    0xffffffffu) >>
+                   32u;
+      if (!start_pending_) {
+        emit(kContinue);
+        sending_ = true;
+      }
+    }
+
+    if (transport_q32_ > position_q32_) position_q32_ = transport_q32_;
+    const uint64_t due =
+        (static_cast<uint64_t>(position_q32_) * kTicksPerEighth) >> 32u;
+    while (due >= next_tick_) {
+      if (start_pending_ && next_tick_ % kTicksPerEighth == 0) {
+        emit(kStart);
+        start_pending_ = false;
+        sending_ = true;
+      }
+      if (sending_) {
+        emit(kClock);
+        ++clocks_;
+      }
+      ++next_tick_;
+    }
+  }
+
+  bool sending() const { return sending_; }
+  uint32_t clocks() const { return clocks_; }
+
+ private:
+  uint32_t last_phase_ = 0;
+  int64_t transport_q32_ = 0;  // unwrapped transport position
+  int64_t position_q32_ = 0;   // monotonic position ticks are derived from
+  uint64_t next_tick_ = 0;
+  uint32_t clocks_ = 0;
+  bool running_ = false;
+  bool sending_ = false;
+  bool start_pending_ = true;
+};
@@ -0,0 +1,43 @@
+#include "PikoArena.h"
+
+#include "pico/stdlib.h"
+
+namespace {
+
+static constexpr uint32_t kUploadAcquireTimeoutMs = 10u;
+
+uint8_t arena[PIKO_ARENA_SIZE] __attribute__((aligned(4)));
+volatile bool upload_requested = false;
+volatile bool audio_released = false;
+
+}  // namespace
+
+uint8_t* piko_arena_audio_acquire() {
+  if (upload_requested) {
+    audio_released = true;
+    return nullptr;
+  }
+  return arena;
+}
+
+uint8_t* piko_arena_upload_acquire() {
+  audio_released = false;
+  __asm volatile("dmb" ::: "memory");
+  upload_requested = true;
+  __asm volatile("dmb" ::: "memory");
+  const absolute_time_t deadline = make_timeout_time_ms(kUploadAcquireTimeoutMs);
+  while (!audio_released) {
+    if (time_reached(deadline)) {
+      piko_arena_upload_release();
+      return nullptr;
+    }
+    tight_loop_contents();
+  }
+  __asm volatile("dmb" ::: "memory");
+  return arena;
+}
+
+void piko_arena_upload_release() {
+  __asm volatile("dmb" ::: "memory");
+  upload_requested = false;
+}
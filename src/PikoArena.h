@@ -0,0 +1,18 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "PikoAudioBank.h"
+
+// One SRAM scratch arena shared between core 1 bank uploads (header staging)
+// and the audio engine (delay line). Uploads always win: the audio ISR lets go
+// of the arena on its next carrier and only takes it back after release.
+static constexpr uint32_t PIKO_ARENA_SIZE = PIKO_BANK_HEADER_SIZE;
+
+// Audio ISR. Returns nullptr while an upload owns the arena. Contents are
+// undefined after every nullptr, so callers must treat them as stale.
+uint8_t* piko_arena_audio_acquire();
+
+// Core 1. Waits for the audio ISR to let go; returns nullptr on timeout.
+uint8_t* piko_arena_upload_acquire();
+void piko_arena_upload_release();
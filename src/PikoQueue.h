@@ -0,0 +1,23 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "SpscQueue.h"
+#include "TimedSpscQueue.h"
+#include "pico/time.h"
+
+// Event queues between IRQs and cores. With QUEUE_TELEMETRY they also record
+// how long entries wait and how full they get; otherwise they are plain
+// SpscQueues.
+#if QUEUE_TELEMETRY == 1
+struct PicoMicrosClock {
+  static uint32_t nowUs() { return time_us_32(); }
+};
+
+template <typename T, size_t Capacity>
+using PikoQueue = TimedSpscQueue<T, Capacity, PicoMicrosClock>;
+#else
+template <typename T, size_t Capacity>
+using PikoQueue = SpscQueue<T, Capacity>;
+#endif
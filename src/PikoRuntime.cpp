@@ -1,70 +1,401 @@
 #include "PikoRuntime.h"
 
+#include <string.h>
+
+#include "EventRing.h"
+#include "PikoQueue.h"
+#include "Seqlock.h"
 #include "SpscQueue.h"
+#include "hardware/sync.h"
+#include "pico/multicore.h"
 #include "pico/stdlib.h"
 #include "tusb.h"
 
 namespace {
 
-struct UsbMidiEvent {
-  uint8_t note;
-  uint8_t velocity;
+// Seqlock writer guard on a claimed hardware spin lock: the Cortex-M0+ has no
+// atomic read-modify-write, and reading the lock register claims it.
+class SpinLockGuard {
+ public:
+  SpinLockGuard() : lock_(spin_lock_instance(spin_lock_claim_unused(true))) {}
+
+  bool tryLock() {
+    if (*lock_ == 0) return false;
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    return true;
+  }
+  void unlock() { spin_unlock_unsafe(lock_); }
+
+ private:
+  spin_lock_t* lock_;
+};
+
+// A note-on as a USB-MIDI packet, stamped where core 0 played it.
+struct UsbMidiNote {
+  uint8_t packet[4];
+  uint32_t timestamp_us;
+  uint32_t duration_us;
+};
+
+struct UsbMidiRealtime {
+  uint8_t status;
+  uint32_t due_us;
 };
 
-SpscQueue<PikoRequest, 8> request_queue;
-SpscQueue<UsbMidiEvent, 32> usb_midi_queue;
-volatile uint32_t next_request_id = 1;
-volatile uint32_t acknowledged_request_id = 0;
-volatile bool acknowledged_request_ok = false;
+SpscQueue<PikoRequest, PIKO_MAX_PENDING_REQUESTS + 1u> request_queue;
+// Never overflows: core 1 keeps at most PIKO_MAX_PENDING_REQUESTS
+// uncompleted requests outstanding.
+SpscQueue<PikoCompletion, PIKO_MAX_PENDING_REQUESTS + 1u> completion_queue;
+// A packet staged for the endpoint with the time it was due.
+enum class UsbMidiPacketKind : uint8_t { Realtime, NoteOn, NoteOff, NoteCut };
+
+struct UsbMidiPacket {
+  uint8_t bytes[4];
+  uint32_t due_us;
+  UsbMidiPacketKind kind;
+};
+
+// The TinyUSB MIDI TX FIFO, and one full-speed bulk transfer.
+constexpr uint32_t kUsbMidiBlockPackets = CFG_TUD_MIDI_TX_BUFSIZE / 4u;
+// The TinyUSB MIDI RX FIFO: everything one pass can read.
+constexpr uint32_t kUsbMidiRxPackets = CFG_TUD_MIDI_RX_BUFSIZE / 4u;
+
+PikoQueue<UsbMidiNote, 32> usb_midi_queue;
+PikoQueue<UsbMidiRealtime, 32> usb_midi_realtime_queue;
+PikoQueue<piko::ClockEvent, 32> usb_midi_clock_queue;
+PikoQueue<PikoMidiInputEvent, 32> usb_midi_input_queue;
+EventRing<piko::ClockCaptureRecord, PIKO_CLOCK_CAPTURE_RECORDS> clock_capture;
+#if TRACE_ENABLED == 1
+EventRing<piko::TraceRecord, PIKO_TRACE_RECORDS> trace_rings[2];
+#endif
 volatile bool usb_midi_ready = false;
+volatile bool usb_midi_clock_input = false;
+
+// Each core's doorbell state is touched only by that core.
+struct DoorbellState {
+  PikoDoorbellStats stats;
+  uint32_t window_start_us;
+  uint32_t window_wakeups;
+  uint32_t window_rings;
+};
+DoorbellState doorbells[2];
+
+Seqlock<PikoClockSnapshot, SpinLockGuard> clock_snapshot;
+Seqlock<PikoEngineSnapshot, SpinLockGuard> engine_snapshot;
+
+// Core 1 only.
+uint32_t next_request_id = 1;
+PikoMidiClockStats midi_clock_stats{};
+bool midi_clock_has_previous = false;
+uint32_t midi_clock_previous_due_us = 0;
+uint32_t midi_clock_previous_sent_us = 0;
+PikoMidiNoteStats midi_note_stats{};
+bool midi_note_has_previous = false;
+uint32_t midi_note_previous_due_us = 0;
+uint32_t midi_note_previous_sent_us = 0;
+UsbMidiPacket midi_block[kUsbMidiBlockPackets];
+uint32_t midi_block_count = 0;
+UsbMidiPacket midi_note_off{};
+bool midi_note_off_pending = false;
+uint32_t usb_midi_last_service_us = 0;
+uint32_t usb_midi_last_clock_us = 0;
+
+uint32_t absoluteDifference(uint32_t a, uint32_t b) {
+  return a > b ? a - b : b - a;
+}
+
+void recordMidiRealtimeSent(const UsbMidiRealtime& message, uint32_t now_us) {
+  const uint32_t latency = now_us - message.due_us;
+  midi_clock_stats.latency_us =
+      (midi_clock_stats.latency_us * 7u + latency) / 8u;
+  if (latency > midi_clock_stats.max_latency_us) {
+    midi_clock_stats.max_latency_us = latency;
+  }
+  if (message.status != 0xF8) {
+    ++midi_clock_stats.transport_sent;
+    midi_clock_has_previous = false;
+    return;
+  }
+  ++midi_clock_stats.clocks_sent;
+  if (midi_clock_has_previous) {
+    const uint32_t jitter =
+        absoluteDifference(now_us - midi_clock_previous_sent_us,
+                           message.due_us - midi_clock_previous_due_us);
+    midi_clock_stats.jitter_us =
+        (midi_clock_stats.jitter_us * 7u + jitter) / 8u;
+    if (jitter > midi_clock_stats.max_jitter_us) {
+      midi_clock_stats.max_jitter_us = jitter;
+    }
+  }
+  midi_clock_has_previous = true;
+  midi_clock_previous_due_us = message.due_us;
+  midi_clock_previous_sent_us = now_us;
+}
+
+void rollDoorbellWindow(DoorbellState& state, uint32_t now_us) {
+  if (now_us - state.window_start_us < 1000000u) return;
+  state.stats.wakeups_per_second = state.window_wakeups;
+  state.stats.rings_per_second = state.window_rings;
+  state.window_wakeups = 0;
+  state.window_rings = 0;
+  state.window_start_us = now_us;
+}
+
+void recordMidiNoteSent(const UsbMidiPacket& packet, uint32_t now_us) {
+  if (packet.kind == UsbMidiPacketKind::NoteCut) {
+    ++midi_note_stats.note_cuts;
+    return;
+  }
+  if (packet.kind == UsbMidiPacketKind::NoteOn) {
+    ++midi_note_stats.notes_sent;
+  } else {
+    ++midi_note_stats.note_offs_sent;
+  }
+  const uint32_t latency = now_us - packet.due_us;
+  midi_note_stats.latency_us =
+      (midi_note_stats.latency_us * 7u + latency) / 8u;
+  if (latency > midi_note_stats.max_latency_us) {
+    midi_note_stats.max_latency_us = latency;
+  }
+  if (midi_note_has_previous) {
+    const uint32_t jitter =
+        absoluteDifference(now_us - midi_note_previous_sent_us,
+                           packet.due_us - midi_note_previous_due_us);
+    midi_note_stats.jitter_us =
+        (midi_note_stats.jitter_us * 7u + jitter) / 8u;
+    if (jitter > midi_note_stats.max_jitter_us) {
+      midi_note_stats.max_jitter_us = jitter;
+    }
+  }
+  midi_note_has_previous = true;
+  midi_note_previous_due_us = packet.due_us;
+  midi_note_previous_sent_us = now_us;
+}
 
-volatile uint32_t snapshot_sequence = 0;
-PikoClockSnapshot clock_snapshot{};
-int16_t usb_last_note = -1;
+bool stageMidiPacket(const uint8_t* bytes, uint32_t due_us,
+                     UsbMidiPacketKind kind) {
+  if (midi_block_count == kUsbMidiBlockPackets) return false;
+  UsbMidiPacket& packet = midi_block[midi_block_count++];
+  memcpy(packet.bytes, bytes, sizeof(packet.bytes));
+  packet.due_us = due_us;
+  packet.kind = kind;
+  return true;
+}
 
-bool submitRequest(PikoRequestType type, uint8_t value) {
-  const uint32_t id = next_request_id++;
-  if (!request_queue.push({id, type, value})) return false;
-  const absolute_time_t deadline = make_timeout_time_ms(2000);
-  while (acknowledged_request_id != id && !time_reached(deadline)) {
-    tud_task();
-    piko_runtime_service_usb_midi();
-    sleep_us(100);
+// Fills the block behind anything the FIFO refused last pass: realtime bytes
+// first, then a note-off that has come due, then new notes. Notes are
+// monophonic, so a note that starts before the last one's note-off was due
+// cuts it short.
+void stageMidiPackets(uint32_t now_us) {
+  UsbMidiRealtime realtime{};
+  while (midi_block_count < kUsbMidiBlockPackets &&
+         usb_midi_realtime_queue.pop(realtime)) {
+    const uint8_t packet[4] = {0x0F, realtime.status, 0, 0};
+    stageMidiPacket(packet, realtime.due_us, UsbMidiPacketKind::Realtime);
+  }
+  if (midi_note_off_pending &&
+      static_cast<int32_t>(now_us - midi_note_off.due_us) >= 0 &&
+      stageMidiPacket(midi_note_off.bytes, midi_note_off.due_us,
+                      UsbMidiPacketKind::NoteOff)) {
+    midi_note_off_pending = false;
+  }
+  UsbMidiNote note{};
+  while (midi_block_count + 2u <= kUsbMidiBlockPackets &&
+         usb_midi_queue.pop(note)) {
+    if (midi_note_off_pending) {
+      stageMidiPacket(midi_note_off.bytes, midi_note_off.due_us,
+                      UsbMidiPacketKind::NoteCut);
+    }
+    stageMidiPacket(note.packet, note.timestamp_us, UsbMidiPacketKind::NoteOn);
+    midi_note_off = {{0x08, 0x80, note.packet[2], 0},
+                     note.timestamp_us + note.duration_us,
+                     UsbMidiPacketKind::NoteOff};
+    midi_note_off_pending = true;
+  }
+}
+
+// Writes the block back to back so TinyUSB sends it in as few transfers as
+// the endpoint allows. Whatever the FIFO cannot take waits, in order, for the
+// next pass.
+void flushMidiBlock() {
+  uint32_t sent = 0;
+  while (sent < midi_block_count &&
+         tud_midi_n_packet_write(0, midi_block[sent].bytes)) {
+    ++sent;
+  }
+  if (sent == 0) return;
+  const uint32_t now_us = time_us_32();
+  for (uint32_t i = 0; i < sent; ++i) {
+    const UsbMidiPacket& packet = midi_block[i];
+    if (packet.kind == UsbMidiPacketKind::Realtime) {
+      recordMidiRealtimeSent({packet.bytes[1], packet.due_us}, now_us);
+    } else {
+      recordMidiNoteSent(packet, now_us);
+    }
+  }
+  midi_note_stats.packets += sent;
+  ++midi_note_stats.flushes;
+  if (sent > midi_note_stats.max_flush_packets) {
+    midi_note_stats.max_flush_packets = sent;
+  }
+  midi_block_count -= sent;
+  memmove(midi_block, midi_block + sent,
+          midi_block_count * sizeof(UsbMidiPacket));
+}
+
+// Packets land in the endpoint FIFO at some point since the previous pass
+// (at most a frame back). The n read in one pass split that window into n
+// equal shares and each is stamped at the middle of its own, so a burst keeps
+// its order and spacing; no stamp is earlier than the clock event before it.
+void readUsbMidiInput(uint32_t now_us) {
+  uint32_t window_us = now_us - usb_midi_last_service_us;
+  usb_midi_last_service_us = now_us;
+  if (window_us > 1000u) window_us = 1000u;
+
+  uint8_t packets[kUsbMidiRxPackets][4];
+  uint32_t count = 0;
+  while (count < kUsbMidiRxPackets &&
+         tud_midi_n_packet_read(0, packets[count])) {
+    ++count;
+  }
+  for (uint32_t index = 0; index < count; ++index) {
+    const uint8_t* packet = packets[index];
+    uint32_t timestamp_us =
+        now_us - window_us + window_us * (2u * index + 1u) / (2u * count);
+    if (static_cast<int32_t>(timestamp_us - usb_midi_last_clock_us) < 0) {
+      timestamp_us = usb_midi_last_clock_us;
+    }
+#if USB_MIDI_IN == 1
+    const uint8_t code_index = packet[0] & 0x0F;
+    if (code_index == 0x8 || code_index == 0x9 || code_index == 0xB) {
+      uint8_t status = packet[1];
+      if (code_index == 0x9 && packet[3] == 0) status = 0x80 | (status & 0x0F);
+      if (!usb_midi_input_queue.push(
+              {status, packet[2], packet[3], timestamp_us})) {
+        PIKO_TRACE(piko::TraceEvent::QueueDrop, piko::TraceQueue::UsbMidiInput,
+                   usb_midi_input_queue.drops());
+      }
+      continue;
+    }
+#endif
+    if (!usb_midi_clock_input || (packet[0] & 0x0F) != 0x0F) continue;
+    piko::ClockEventType type{};
+    switch (packet[1]) {
+      case 0xF8:
+        type = piko::ClockEventType::MidiClock;
+        break;
+      case 0xFA:
+        type = piko::ClockEventType::MidiStart;
+        break;
+      case 0xFB:
+        type = piko::ClockEventType::MidiContinue;
+        break;
+      case 0xFC:
+        type = piko::ClockEventType::MidiStop;
+        break;
+      default:
+        continue;
+    }
+    if (!usb_midi_clock_queue.push({type, timestamp_us})) {
+      PIKO_TRACE(piko::TraceEvent::QueueDrop, piko::TraceQueue::UsbMidiClock,
+                 usb_midi_clock_queue.drops());
+    }
+    usb_midi_last_clock_us = timestamp_us;
   }
-  return acknowledged_request_id == id && acknowledged_request_ok;
 }
 
 }  // namespace
 
-bool piko_request_clock_mode(bool midi) {
-  return submitRequest(PikoRequestType::SetClockMode, midi ? 1 : 0);
+void piko_doorbell_ring() {
+  // Masked so the ISR and thread on one core cannot both pass the ready
+  // check for the last free slot and leave one blocked in the push.
+  const uint32_t interrupts = save_and_disable_interrupts();
+  if (multicore_fifo_wready()) {
+    multicore_fifo_push_blocking(time_us_32());
+  } else {
+    ++doorbells[get_core_num()].stats.ring_drops;
+  }
+  restore_interrupts(interrupts);
 }
 
-bool piko_request_pulse_ppqn(uint8_t ppqn) {
-  return submitRequest(PikoRequestType::SetPulsePpqn, ppqn);
+uint32_t piko_doorbell_take() {
+  DoorbellState& state = doorbells[get_core_num()];
+  uint32_t taken = 0;
+  while (multicore_fifo_rvalid()) {
+    const uint32_t rung_us = multicore_fifo_pop_blocking();
+    const uint32_t latency = time_us_32() - rung_us;
+    state.stats.latency_us = (state.stats.latency_us * 7u + latency) / 8u;
+    if (latency > state.stats.max_latency_us) {
+      state.stats.max_latency_us = latency;
+    }
+    ++taken;
+  }
+  state.stats.rings_taken += taken;
+  state.window_rings += taken;
+  rollDoorbellWindow(state, time_us_32());
+  return taken;
+}
+
+void piko_doorbell_count_wakeup() {
+  DoorbellState& state = doorbells[get_core_num()];
+  ++state.window_wakeups;
+  rollDoorbellWindow(state, time_us_32());
+}
+
+void piko_doorbell_wait(absolute_time_t deadline) {
+  // A ring that lands after this check still sets the event register, so
+  // the wait returns at once instead of missing it.
+  if (!multicore_fifo_rvalid()) best_effort_wfe_or_timeout(deadline);
+  piko_doorbell_count_wakeup();
+}
+
+PikoDoorbellStats piko_doorbell_stats() {
+  return doorbells[get_core_num()].stats;
 }
 
-bool piko_request_stop_playback() {
-  return submitRequest(PikoRequestType::StopPlayback, 0);
+uint32_t piko_request_submit(PikoRequestType type, uint32_t value) {
+  // Core 1 is the only submitter; 0 is never a valid id.
+  if (next_request_id == 0) ++next_request_id;
+  const uint32_t id = next_request_id;
+  if (!request_queue.push({id, type, value})) return 0;
+  ++next_request_id;
+  piko_doorbell_ring();
+  return id;
 }
 
-bool piko_request_start_playback() {
-  return submitRequest(PikoRequestType::StartPlayback, 0);
+bool piko_request_pop_completion(PikoCompletion* completion) {
+  return completion != nullptr && completion_queue.pop(*completion);
 }
 
 bool piko_runtime_pop_request(PikoRequest* request) {
   return request != nullptr && request_queue.pop(*request);
 }
 
-void piko_runtime_ack_request(uint32_t id, bool ok) {
-  acknowledged_request_ok = ok;
-  __atomic_thread_fence(__ATOMIC_SEQ_CST);
-  acknowledged_request_id = id;
+void piko_runtime_complete_request(uint32_t id, bool ok) {
+  completion_queue.push({id, ok});
+  piko_doorbell_ring();
 }
 
-void piko_usb_midi_note_on(uint8_t note, uint8_t velocity) {
+void piko_usb_midi_note_on(uint8_t note, uint8_t velocity,
+                           uint32_t duration_us) {
   if (!usb_midi_ready) return;
-  usb_midi_queue.push({note, velocity});
+  if (!usb_midi_queue.push(
+          {{0x09, 0x90, note, velocity}, time_us_32(), duration_us})) {
+    PIKO_TRACE(piko::TraceEvent::QueueDrop, piko::TraceQueue::UsbMidiNote,
+               usb_midi_queue.drops());
+    return;
+  }
+  piko_doorbell_ring();
+}
+
+void piko_usb_midi_realtime(uint8_t status, uint32_t due_us) {
+  if (!usb_midi_ready) return;
+  if (!usb_midi_realtime_queue.push({status, due_us})) {
+    PIKO_TRACE(piko::TraceEvent::QueueDrop, piko::TraceQueue::UsbMidiRealtime,
+               usb_midi_realtime_queue.drops());
+    return;
+  }
+  piko_doorbell_ring();
 }
 
 void piko_runtime_service_usb_midi() {
@@ -72,47 +403,124 @@ void piko_runtime_service_usb_midi() {
   usb_midi_ready = tud_mounted() && !tud_suspended();
   if (!usb_midi_ready) {
     usb_midi_queue.clear();
-    usb_last_note = -1;
+    usb_midi_realtime_queue.clear();
+    midi_block_count = 0;
+    midi_note_off_pending = false;
+    midi_clock_has_previous = false;
+    midi_note_has_previous = false;
     return;
   }
-  UsbMidiEvent event{};
-  while (usb_midi_queue.pop(event)) {
-    uint8_t message[3];
-    if (usb_last_note >= 0) {
-      message[0] = 0x80;
-      message[1] = static_cast<uint8_t>(usb_last_note);
-      message[2] = 0;
-      tud_midi_n_stream_write(0, 0, message, sizeof(message));
-    }
-    message[0] = 0x90;
-    message[1] = event.note;
-    message[2] = event.velocity;
-    tud_midi_n_stream_write(0, 0, message, sizeof(message));
-    usb_last_note = event.note;
-  }
+  const uint32_t now_us = time_us_32();
+  readUsbMidiInput(now_us);
+  stageMidiPackets(now_us);
+  flushMidiBlock();
 #endif
 }
 
 uint32_t piko_usb_midi_queue_drops() { return usb_midi_queue.drops(); }
 
+PikoMidiNoteStats piko_usb_midi_note_stats() {
+  PikoMidiNoteStats stats = midi_note_stats;
+  stats.drops = usb_midi_queue.drops();
+  return stats;
+}
+
+void piko_usb_midi_clock_input_enable(bool enabled) {
+  usb_midi_clock_input = enabled;
+  usb_midi_clock_queue.clear();
+}
+
+bool piko_usb_midi_clock_pop(piko::ClockEvent* event) {
+  return event != nullptr && usb_midi_clock_queue.pop(*event);
+}
+
+bool piko_usb_midi_clock_pending() { return !usb_midi_clock_queue.empty(); }
+
+uint32_t piko_usb_midi_clock_drops() { return usb_midi_clock_queue.drops(); }
+
+bool piko_usb_midi_input_pop(PikoMidiInputEvent* event) {
+  return event != nullptr && usb_midi_input_queue.pop(*event);
+}
+
+uint32_t piko_usb_midi_input_drops() { return usb_midi_input_queue.drops(); }
+
+PikoMidiClockStats piko_usb_midi_clock_stats() {
+  PikoMidiClockStats stats = midi_clock_stats;
+  stats.drops = usb_midi_realtime_queue.drops();
+  return stats;
+}
+
+#if QUEUE_TELEMETRY == 1
+void piko_runtime_queue_telemetry(PikoQueueTelemetry* queues) {
+  auto fill = [queues](piko::TraceQueue id, const auto& queue) {
+    queues[static_cast<uint32_t>(id)] = {
+        static_cast<uint32_t>(queue.capacity()), queue.drops(),
+        queue.stats()};
+  };
+  fill(piko::TraceQueue::UsbMidiClock, usb_midi_clock_queue);
+  fill(piko::TraceQueue::UsbMidiNote, usb_midi_queue);
+  fill(piko::TraceQueue::UsbMidiRealtime, usb_midi_realtime_queue);
+  fill(piko::TraceQueue::UsbMidiInput, usb_midi_input_queue);
+}
+#endif
+
+void piko_clock_capture_record(const piko::ClockCaptureRecord& record) {
+  clock_capture.push(record);
+}
+
+void piko_clock_capture_hold(bool held) { clock_capture.hold(held); }
+
+uint32_t piko_clock_capture_written() { return clock_capture.written(); }
+
+uint32_t piko_clock_capture_size() { return clock_capture.size(); }
+
+piko::ClockCaptureRecord piko_clock_capture_at(uint32_t index) {
+  return clock_capture.at(index);
+}
+
+void piko_clock_capture_clear() { clock_capture.clear(); }
+
+#if TRACE_ENABLED == 1
+void piko_trace(piko::TraceEvent event, uint16_t arg0, uint32_t arg1) {
+  const uint32_t interrupts = save_and_disable_interrupts();
+  const uint8_t core = static_cast<uint8_t>(get_core_num());
+  trace_rings[core].push({time_us_32(), event, core, arg0, arg1});
+  restore_interrupts(interrupts);
+}
+
+void piko_trace_hold(bool held) {
+  for (auto& ring : trace_rings) ring.hold(held);
+}
+
+uint32_t piko_trace_written(uint8_t core) {
+  return core < 2 ? trace_rings[core].written() : 0;
+}
+
+uint32_t piko_trace_size(uint8_t core) {
+  return core < 2 ? trace_rings[core].size() : 0;
+}
+
+piko::TraceRecord piko_trace_at(uint8_t core, uint32_t index) {
+  return trace_rings[core].at(index);
+}
+
+void piko_trace_clear() {
+  for (auto& ring : trace_rings) ring.clear();
+}
+#endif
+
 void piko_publish_clock_snapshot(const PikoClockSnapshot& snapshot) {
-  ++snapshot_sequence;
-  __atomic_thread_fence(__ATOMIC_SEQ_CST);
-  clock_snapshot = snapshot;
-  __atomic_thread_fence(__ATOMIC_SEQ_CST);
-  ++snapshot_sequence;
+  clock_snapshot.write(snapshot);
 }
 
 bool piko_read_clock_snapshot(PikoClockSnapshot* snapshot) {
-  if (snapshot == nullptr) return false;
-  for (uint8_t attempt = 0; attempt < 8; ++attempt) {
-    const uint32_t before = snapshot_sequence;
-    if (before & 1u) continue;
-    __atomic_thread_fence(__ATOMIC_SEQ_CST);
-    *snapshot = clock_snapshot;
-    __atomic_thread_fence(__ATOMIC_SEQ_CST);
-    const uint32_t after = snapshot_sequence;
-    if (before == after && !(after & 1u)) return true;
-  }
-  return false;
+  return clock_snapshot.read(snapshot);
+}
+
+void piko_publish_engine_snapshot(const PikoEngineSnapshot& snapshot) {
+  engine_snapshot.write(snapshot);
+}
+
+bool piko_read_engine_snapshot(PikoEngineSnapshot* snapshot) {
+  return engine_snapshot.read(snapshot);
 }
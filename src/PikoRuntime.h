@@ -3,10 +3,21 @@
 #include <stdint.h>
 
 #include "ClockSync.h"
+#include "TimedSpscQueue.h"
+#include "pico/types.h"
+#include "Trace.h"
+#include "TriggerClock.h"
 
 enum class PikoRequestType : uint8_t {
-  SetClockMode,
+  SetClockMode,       // 0 pulses on the clock jack, 1 one-wire MIDI, 2 USB MIDI
   SetPulsePpqn,
+  SetClockFilter,     // 0 median, 1..6 PLL with that bandwidth shift
+  SetOutputOffset,    // int16 microseconds, sign-extended; positive leads
+  SetSlavedPlayback,
+  SetFlywheel,        // milliseconds; 0 pauses as soon as the clock is lost
+  SetTriggerOut,      // ppqn | division << 8 | width ms << 16
+  SetGrainInterp,     // 0 nearest, 1 linear, 2 cubic
+  ResetClockStatistics,
   StopPlayback,
   StartPlayback,
 };
@@ -14,30 +25,196 @@ enum class PikoRequestType : uint8_t {
 struct PikoRequest {
   uint32_t id;
   PikoRequestType type;
-  uint8_t value;
+  uint32_t value;
+};
+
+struct PikoCompletion {
+  uint32_t id;
+  bool ok;
 };
 
 struct PikoClockSnapshot {
   piko::ClockDiagnostics clock;
   uint32_t clock_queue_drops;
   uint32_t midi_queue_drops;
+  TriggerOutStats trigger;
+  uint32_t trigger_skipped;  // pulses the transport jumped past
+  uint8_t trigger_ppqn;
+  uint8_t trigger_division;
+  uint8_t trigger_width_ms;
+};
+
+struct PikoDoorbellStats {
+  uint32_t rings_taken;
+  uint32_t ring_drops;          // rings this core could not send, FIFO full
+  uint32_t wakeups_per_second;  // over the last full second
+  uint32_t rings_per_second;
+  uint32_t latency_us;          // smoothed ring-to-take delay
+  uint32_t max_latency_us;
+};
+
+// Wait-time telemetry for the event queues, indexed by piko::TraceQueue.
+static constexpr uint32_t PIKO_TELEMETRY_QUEUES = 6u;
+
+struct PikoQueueTelemetry {
+  uint32_t capacity;
+  uint32_t drops;
+  SpscQueueStats stats;
+};
+
+struct PikoEngineSnapshot {
+  uint32_t render_cache_hits;
+  uint32_t render_cache_misses;
+  uint32_t render_cache_invalidations;
+  uint32_t governor_level;
+  uint32_t governor_entries[5];  // indexed by DegradeLevel
+  uint32_t grain_interp;         // configured GrainInterp
+  uint32_t isr_peak_cycles;
+  uint32_t isr_budget_cycles;
+  uint32_t isr_overruns;
+  uint32_t delay_clamps;  // delay times shortened to fit the arena
+  uint32_t slaved_playback;
+  int32_t slave_error_frames;
+  uint32_t slave_max_error_frames;
+  uint32_t midi_in_events;
+  uint32_t midi_in_drops;
+  uint32_t midi_in_latency_us;  // smoothed USB arrival to engine apply
+  uint32_t midi_in_max_latency_us;
+  PikoDoorbellStats core0_doorbell;
+  uint32_t render_pipeline;   // 1 when built with RENDER_PIPELINE
+  uint32_t render_underruns;  // carrier ticks with nothing rendered
+  uint32_t render_depth;
+  uint32_t render_min_depth;  // lowest depth since the previous snapshot
+  uint32_t render_output_drops;  // transport outputs lost to a full queue
+  PikoQueueTelemetry queues[PIKO_TELEMETRY_QUEUES];  // with QUEUE_TELEMETRY
 };
 
-// Core 1 request API. Completion is explicitly acknowledged by core 0.
-bool piko_request_clock_mode(bool midi);
-bool piko_request_pulse_ppqn(uint8_t ppqn);
-bool piko_request_stop_playback();
-bool piko_request_start_playback();
+// A channel voice message from the USB MIDI port. Note-on with velocity 0
+// arrives as note-off.
+struct PikoMidiInputEvent {
+  uint8_t status;
+  uint8_t data1;
+  uint8_t data2;
+  uint32_t timestamp_us;
+};
+
+struct PikoMidiClockStats {
+  uint32_t clocks_sent;
+  uint32_t transport_sent;  // Start, Continue and Stop
+  uint32_t drops;
+  uint32_t jitter_us;       // smoothed |send interval - due interval|
+  uint32_t max_jitter_us;
+  uint32_t latency_us;      // smoothed due-to-send delay
+  uint32_t max_latency_us;
+};
+
+struct PikoMidiNoteStats {
+  uint32_t notes_sent;
+  uint32_t note_offs_sent;  // on schedule
+  uint32_t note_cuts;       // sent early because the next note started
+  uint32_t drops;
+  uint32_t packets;         // every USB-MIDI packet written, realtime included
+  uint32_t flushes;         // service passes that wrote at least one packet
+  uint32_t max_flush_packets;
+  uint32_t jitter_us;       // smoothed |send interval - due interval|
+  uint32_t max_jitter_us;
+  uint32_t latency_us;      // smoothed ISR-timestamp-to-send delay
+  uint32_t max_latency_us;
+};
+
+// Cross-core doorbell on the SIO FIFOs. A ring pushes the sender's
+// time_us_32() to the other core and raises an event, so a core waiting in
+// __wfe wakes at once and can measure the wakeup. Rings never block: a full
+// FIFO already holds unread rings. Core 1 rings after submitting a request;
+// core 0 after completing one or queuing USB MIDI output.
+void piko_doorbell_ring();
+// Takes every ring addressed to the calling core and returns how many.
+uint32_t piko_doorbell_take();
+// Counts one wakeup of the calling core towards its per-second rate.
+void piko_doorbell_count_wakeup();
+// Sleeps in __wfe until a ring, an interrupt or the deadline, then counts the
+// wakeup.
+void piko_doorbell_wait(absolute_time_t deadline);
+PikoDoorbellStats piko_doorbell_stats();
+
+// Core 1 request API. Nothing blocks: core 0 applies requests in submission
+// order and completes each exactly once, in the same order, on a second
+// queue. Up to PIKO_MAX_PENDING_REQUESTS may be in flight; submit returns the
+// request id, or 0 when the queue is full.
+static constexpr uint32_t PIKO_MAX_PENDING_REQUESTS = 7u;
+uint32_t piko_request_submit(PikoRequestType type, uint32_t value);
+bool piko_request_pop_completion(PikoCompletion* completion);
 
 // Core 0 request service API.
 bool piko_runtime_pop_request(PikoRequest* request);
-void piko_runtime_ack_request(uint32_t id, bool ok);
+void piko_runtime_complete_request(uint32_t id, bool ok);
 
-// PWM/core-0 producer, TinyUSB/core-1 consumer.
-void piko_usb_midi_note_on(uint8_t note, uint8_t velocity);
+// PWM/core-0 producer, TinyUSB/core-1 consumer. Notes are packed as USB-MIDI
+// packets and stamped where they are played; core 1 sends each with a
+// note-off duration_us later, or sooner if the next note starts first.
+void piko_usb_midi_note_on(uint8_t note, uint8_t velocity,
+                           uint32_t duration_us);
 void piko_runtime_service_usb_midi();
 uint32_t piko_usb_midi_queue_drops();
+PikoMidiNoteStats piko_usb_midi_note_stats();
+
+// MIDI clock output. Core 0 stamps each realtime message with the time it was
+// due; core 1 sends them ahead of note traffic and measures the delivery.
+void piko_usb_midi_realtime(uint8_t status, uint32_t due_us);
+PikoMidiClockStats piko_usb_midi_clock_stats();
+
+// TinyUSB/core-1 producer, PWM/core-0 consumer. Core 1 only forwards
+// incoming clock and transport bytes while the USB MIDI source is selected,
+// so it is the sole producer of these events.
+void piko_usb_midi_clock_input_enable(bool enabled);
+bool piko_usb_midi_clock_pop(piko::ClockEvent* event);
+bool piko_usb_midi_clock_pending();
+uint32_t piko_usb_midi_clock_drops();
+
+// TinyUSB/core-1 producer, core-0 control-loop consumer. Notes and control
+// changes on any channel, stamped like the clock bytes above; core 0 applies
+// them on its next control pass, where the button scan runs.
+bool piko_usb_midi_input_pop(PikoMidiInputEvent* event);
+uint32_t piko_usb_midi_input_drops();
+
+#if QUEUE_TELEMETRY == 1
+// Fills the entries for the USB MIDI queues this module owns.
+void piko_runtime_queue_telemetry(PikoQueueTelemetry* queues);
+#endif
+
+// Core 0 records every processed clock event; core 1 downloads the ring.
+// Readers hold the ring, wait out an in-flight record, read, then release.
+// Clearing is only valid while held.
+static constexpr uint32_t PIKO_CLOCK_CAPTURE_RECORDS = 1024u;
+void piko_clock_capture_record(const piko::ClockCaptureRecord& record);
+void piko_clock_capture_hold(bool held);
+uint32_t piko_clock_capture_written();
+uint32_t piko_clock_capture_size();
+piko::ClockCaptureRecord piko_clock_capture_at(uint32_t index);
+void piko_clock_capture_clear();
+
+// Binary engine trace. Each core records into its own ring with interrupts
+// masked, so ISR and thread records on one core never interleave; each ring
+// keeps its newest PIKO_TRACE_RECORDS. Core 1 downloads them like the clock
+// capture: hold, wait out an in-flight record, read, release. Record sites use
+// PIKO_TRACE so builds without TRACE_ENABLED compile them out.
+#if TRACE_ENABLED == 1
+static constexpr uint32_t PIKO_TRACE_RECORDS = 512u;
+void piko_trace(piko::TraceEvent event, uint16_t arg0, uint32_t arg1);
+void piko_trace_hold(bool held);
+uint32_t piko_trace_written(uint8_t core);
+uint32_t piko_trace_size(uint8_t core);
+piko::TraceRecord piko_trace_at(uint8_t core, uint32_t index);
+void piko_trace_clear();
+#define PIKO_TRACE(event, arg0, arg1)                 \
+  piko_trace((event), static_cast<uint16_t>(arg0), \
+             static_cast<uint32_t>(arg1))
+#else
+#define PIKO_TRACE(event, arg0, arg1) ((void)0)
+#endif
 
-// Seqlock-protected cross-core diagnostic snapshot.
+// Seqlock-protected cross-core diagnostic snapshots.
 void piko_publish_clock_snapshot(const PikoClockSnapshot& snapshot);
 bool piko_read_clock_snapshot(PikoClockSnapshot* snapshot);
+void piko_publish_engine_snapshot(const PikoEngineSnapshot& snapshot);
+bool piko_read_engine_snapshot(PikoEngineSnapshot* snapshot);
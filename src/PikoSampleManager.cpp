@@ -1,8 +1,11 @@
 #include "PikoSampleManager.h"
 
+#include <stdarg.h>
 #include <stdio.h>
 #include <string.h>
 
+#include "GrainInterp.h"
+#include "PikoArena.h"
 #include "PikoAudioBank.h"
 #include "PikoRuntime.h"
 #include "hardware/flash.h"
@@ -10,7 +13,7 @@
 #include "pico/stdlib.h"
 #include "tusb.h"
 
-bool piko_clock_input_ittybittymidi();
+uint8_t piko_clock_input_mode();
 uint8_t piko_pulse_ppqn();
 
 extern "C" void tud_cdc_line_coding_cb(uint8_t itf,
@@ -35,11 +38,27 @@ static constexpr uint32_t kWriteTimeoutMs = 5000u;
 static constexpr uint8_t kCdcInterface = 0;
 static constexpr uint32_t kCdcPacketBytes = 64u;
 static constexpr uint32_t kCdcSmallWriteThreshold = 512u;
+static constexpr uint32_t kClockCaptureVersion = 2u;
+static constexpr uint32_t kTraceVersion = 1u;
+
+static_assert(PIKO_ARENA_SIZE >= PIKO_BANK_HEADER_SIZE,
+              "bank header staging borrows the shared arena");
 
-uint8_t header_staging[PIKO_BANK_HEADER_SIZE] __attribute__((aligned(4)));
 uint8_t page_buf[kFlashPageSize] __attribute__((aligned(4)));
 volatile bool command_interface_ready = false;
 
+struct ScopedArenaUpload {
+  ScopedArenaUpload() : buffer(piko_arena_upload_acquire()) {}
+
+  ~ScopedArenaUpload() {
+    if (buffer != nullptr) {
+      piko_arena_upload_release();
+    }
+  }
+
+  uint8_t* const buffer;
+};
+
 struct ScopedPlaybackMute {
   ScopedPlaybackMute() {
     piko_audio_bank_set_mutating(true);
@@ -51,6 +70,7 @@ struct ScopedPlaybackMute {
 };
 
 void service_usb() {
+  piko_doorbell_take();
   piko_runtime_service_usb_midi();
   tud_task();
 }
@@ -72,7 +92,7 @@ int read_byte_timeout(uint32_t timeout_ms) {
         return value;
       }
     }
-    sleep_us(100);
+    piko_doorbell_wait(deadline);
   }
   return PICO_ERROR_TIMEOUT;
 }
@@ -100,7 +120,7 @@ void write_bytes(const void* data, uint32_t len) {
     const uint32_t available = tud_cdc_n_write_available(kCdcInterface);
     if (available == 0) {
       tud_cdc_n_write_flush(kCdcInterface);
-      sleep_us(100);
+      piko_doorbell_wait(make_timeout_time_us(100));
       continue;
     }
 
@@ -112,7 +132,7 @@ void write_bytes(const void* data, uint32_t len) {
     const uint32_t chunk = remaining < limit ? remaining : limit;
     const uint32_t written = tud_cdc_n_write(kCdcInterface, bytes + sent, chunk);
     if (written == 0) {
-      sleep_us(100);
+      piko_doorbell_wait(make_timeout_time_us(100));
       continue;
     }
     sent += written;
@@ -145,8 +165,123 @@ void send_sync() {
   flush_serial();
 }
 
+// Requests core 0 has not completed yet, oldest first. Core 0 completes them
+// in submission order, so OK/ERR replies go out in command order while
+// several requests are in flight. Commands that reply directly drain these
+// first.
+struct PendingRequest {
+  uint32_t id;
+  absolute_time_t deadline;
+  bool reply;  // false for internal requests that only need to finish
+};
+static constexpr uint32_t kRequestTimeoutMs = 2000u;
+PendingRequest pending_requests[PIKO_MAX_PENDING_REQUESTS];
+uint32_t pending_head = 0;
+uint32_t pending_count = 0;
+bool last_internal_request_ok = false;
+
+// Returns true if a reply was written.
+bool complete_front_request(bool ok) {
+  const PendingRequest& front = pending_requests[pending_head];
+  const bool reply = front.reply;
+  if (reply) {
+    write_str(ok ? "OK\n" : "ERR\n");
+  } else {
+    last_internal_request_ok = ok;
+  }
+  pending_head = (pending_head + 1u) % PIKO_MAX_PENDING_REQUESTS;
+  --pending_count;
+  return reply;
+}
+
+// Answers completed requests and fails any past their deadline.
+void service_requests() {
+  bool wrote = false;
+  PikoCompletion completion{};
+  while (piko_request_pop_completion(&completion)) {
+    // A completion arriving after its request timed out is discarded.
+    if (pending_count == 0 ||
+        completion.id != pending_requests[pending_head].id) {
+      continue;
+    }
+    wrote |= complete_front_request(completion.ok);
+  }
+  while (pending_count > 0 &&
+         time_reached(pending_requests[pending_head].deadline)) {
+    wrote |= complete_front_request(false);
+  }
+  if (wrote) flush_serial();
+}
+
+// Sleeps between passes until core 0 rings, USB interrupts or the oldest
+// request's deadline passes.
+void drain_requests() {
+  while (pending_count > 0) {
+    service_usb();
+    service_requests();
+    if (pending_count > 0) {
+      piko_doorbell_wait(pending_requests[pending_head].deadline);
+    }
+  }
+}
+
+// Writes ERR once every earlier reply has gone out.
+void reply_error() {
+  drain_requests();
+  write_str("ERR\n");
+  flush_serial();
+}
+
+// Queues a request for core 0 without waiting for it. With reply set, its
+// OK/ERR is written when it completes.
+bool submit_request(PikoRequestType type, uint32_t value, bool reply) {
+  while (pending_count == PIKO_MAX_PENDING_REQUESTS) {
+    service_usb();
+    service_requests();
+    if (pending_count == PIKO_MAX_PENDING_REQUESTS) {
+      piko_doorbell_wait(pending_requests[pending_head].deadline);
+    }
+  }
+  const uint32_t id = piko_request_submit(type, value);
+  if (id == 0) {
+    if (reply) reply_error();
+    return false;
+  }
+  const uint32_t tail =
+      (pending_head + pending_count) % PIKO_MAX_PENDING_REQUESTS;
+  pending_requests[tail] = {id, make_timeout_time_ms(kRequestTimeoutMs), reply};
+  ++pending_count;
+  return true;
+}
+
+bool request_and_wait(PikoRequestType type, uint32_t value) {
+  drain_requests();
+  if (!submit_request(type, value, false)) return false;
+  drain_requests();
+  return last_internal_request_ok;
+}
+
+// Set-parameter commands whose replies may trail later commands' input.
+bool pipelined_command(uint8_t command) {
+  switch (command) {
+    case 'S':
+    case 'C':
+    case 'P':
+    case 'F':
+    case 'L':
+    case 'V':
+    case 'H':
+    case 'G':
+    case 'Q':
+    case 'Z':
+      return true;
+    default:
+      return false;
+  }
+}
+
 [[noreturn]] void handle_bootloader_reset() {
-  piko_request_stop_playback();
+  request_and_wait(PikoRequestType::StopPlayback, 0);
   write_str("OK\n");
   flush_serial();
   sleep_ms(100);
@@ -183,6 +318,17 @@ bool validate_header(const PikoBankHeader& header, uint32_t total_len) {
   return true;
 }
 
+const char* clock_input_name(uint8_t mode) {
+  switch (mode) {
+    case 1:
+      return "MIDI";
+    case 2:
+      return "USB_MIDI";
+    default:
+      return "CLOCK";
+  }
+}
+
 void handle_info() {
   char info[512];
   uint32_t used = 0;
@@ -196,7 +342,7 @@ void handle_info() {
                    static_cast<unsigned long>(piko_audio_audio_bytes()),
                    static_cast<unsigned long>(PIKO_BANK_SAMPLE_RATE),
                    static_cast<unsigned long>(piko_audio_sample_count()),
-                   piko_clock_input_ittybittymidi() ? "MIDI" : "CLOCK",
+                   clock_input_name(piko_clock_input_mode()),
                    static_cast<unsigned long>(PIKO_BANK_VERSION),
                    static_cast<unsigned long>(PIKO_BANK_HEADER_SIZE),
                    static_cast<unsigned long>(PIKO_BANK_MAX_SAMPLES),
@@ -242,9 +388,25 @@ void handle_read() {
   flush_serial();
 }
 
+// Flash writes bracketed by trace records, so long erases show up against
+// the audio timeline.
+void traced_flash_erase(uint32_t offset, uint32_t size) {
+  PIKO_TRACE(piko::TraceEvent::FlashBegin, piko::TraceFlashOp::Erase, offset);
+  flash_range_erase(offset, size);
+  PIKO_TRACE(piko::TraceEvent::FlashEnd, piko::TraceFlashOp::Erase, offset);
+}
+
+void traced_flash_program(uint32_t offset, const uint8_t* data,
+                          uint32_t size) {
+  PIKO_TRACE(piko::TraceEvent::FlashBegin, piko::TraceFlashOp::Program,
+             offset);
+  flash_range_program(offset, data, size);
+  PIKO_TRACE(piko::TraceEvent::FlashEnd, piko::TraceFlashOp::Program, offset);
+}
+
 void erase_bank_header() {
   piko_audio_bank_set_mutating(true);
-  flash_range_erase(PIKO_AUDIO_FLASH_OFFSET, PIKO_BANK_HEADER_SIZE);
+  traced_flash_erase(PIKO_AUDIO_FLASH_OFFSET, PIKO_BANK_HEADER_SIZE);
   piko_audio_bank_rescan();
   piko_audio_bank_set_mutating(false);
 }
@@ -278,6 +440,15 @@ void handle_write() {
     return;
   }
 
+  ScopedArenaUpload arena;
+  uint8_t* const header_staging = arena.buffer;
+  if (header_staging == nullptr) {
+    write_str("ERR\n");
+    flush_serial();
+    drain_rejected_write(total_len);
+    return;
+  }
+
   write_str("OK\n");
   flush_serial();
 
@@ -298,7 +469,7 @@ void handle_write() {
 
   piko_audio_bank_set_mutating(true);
 
-  flash_range_erase(PIKO_AUDIO_FLASH_OFFSET, PIKO_BANK_HEADER_SIZE);
+  traced_flash_erase(PIKO_AUDIO_FLASH_OFFSET, PIKO_BANK_HEADER_SIZE);
 
   uint32_t bytes_written = PIKO_BANK_HEADER_SIZE;
   uint32_t audio_flash_off = PIKO_AUDIO_FLASH_OFFSET + PIKO_BANK_HEADER_SIZE;
@@ -318,17 +489,17 @@ void handle_write() {
 
     const uint32_t page_off = audio_flash_off + (bytes_written - PIKO_BANK_HEADER_SIZE);
     if (page_off >= next_erase) {
-      flash_range_erase(next_erase, kFlashSectorSize);
+      traced_flash_erase(next_erase, kFlashSectorSize);
       next_erase += kFlashSectorSize;
     }
-    flash_range_program(page_off, page_buf, sizeof(page_buf));
+    traced_flash_program(page_off, page_buf, sizeof(page_buf));
     bytes_written += page_fill;
   }
 
   memset(page_buf, 0xff, sizeof(page_buf));
   for (uint32_t offset = 0; offset < PIKO_BANK_HEADER_SIZE; offset += kFlashPageSize) {
     memcpy(page_buf, header_staging + offset, kFlashPageSize);
-    flash_range_program(PIKO_AUDIO_FLASH_OFFSET + offset, page_buf, sizeof(page_buf));
+    traced_flash_program(PIKO_AUDIO_FLASH_OFFSET + offset, page_buf, sizeof(page_buf));
   }
 
   piko_audio_bank_rescan();
@@ -338,36 +509,137 @@ void handle_write() {
 }
 
 void handle_clock_input_mode() {
+  const int value = read_byte_timeout(kWriteTimeoutMs);
+  if (value == PICO_ERROR_TIMEOUT || value < 0 || value > 2) {
+    reply_error();
+    return;
+  }
+  submit_request(PikoRequestType::SetClockMode, static_cast<uint32_t>(value),
+                 true);
+}
+
+void handle_pulse_ppqn() {
+  const int value = read_byte_timeout(kWriteTimeoutMs);
+  if (value == PICO_ERROR_TIMEOUT ||
+      !piko::ClockSync::validPulsePpqn(static_cast<uint8_t>(value))) {
+    reply_error();
+    return;
+  }
+  submit_request(PikoRequestType::SetPulsePpqn, static_cast<uint32_t>(value),
+                 true);
+}
+
+void handle_clock_filter() {
+  const int value = read_byte_timeout(kWriteTimeoutMs);
+  if (value == PICO_ERROR_TIMEOUT ||
+      (value != 0 &&
+       !piko::ClockSync::validPllShift(static_cast<uint8_t>(value)))) {
+    reply_error();
+    return;
+  }
+  submit_request(PikoRequestType::SetClockFilter, static_cast<uint32_t>(value),
+                 true);
+}
+
+// Two bytes, little-endian signed microseconds.
+void handle_output_offset() {
+  uint8_t bytes[2];
+  if (!read_exact(bytes, sizeof(bytes), kWriteTimeoutMs)) {
+    reply_error();
+    return;
+  }
+  const int16_t offset_us = static_cast<int16_t>(
+      static_cast<uint16_t>(bytes[0]) | (static_cast<uint16_t>(bytes[1]) << 8u));
+  if (!piko::ClockSync::validOutputOffsetUs(offset_us)) {
+    reply_error();
+    return;
+  }
+  submit_request(PikoRequestType::SetOutputOffset,
+                 static_cast<uint32_t>(static_cast<int32_t>(offset_us)), true);
+}
+
+void handle_slaved_playback() {
   const int value = read_byte_timeout(kWriteTimeoutMs);
   if (value == PICO_ERROR_TIMEOUT || (value != 0 && value != 1)) {
-    write_str("ERR\n");
-    flush_serial();
+    reply_error();
     return;
   }
-  if (!piko_request_clock_mode(value == 1)) {
-    write_str("ERR\n");
-    flush_serial();
+  submit_request(PikoRequestType::SetSlavedPlayback,
+                 static_cast<uint32_t>(value), true);
+}
+
+// Two bytes, little-endian milliseconds.
+void handle_flywheel() {
+  uint8_t bytes[2];
+  if (!read_exact(bytes, sizeof(bytes), kWriteTimeoutMs)) {
+    reply_error();
     return;
   }
-  write_str("OK\n");
-  flush_serial();
+  const uint16_t max_ms =
+      static_cast<uint16_t>(bytes[0]) | (static_cast<uint16_t>(bytes[1]) << 8u);
+  if (!piko::ClockSync::validFlywheelMs(max_ms)) {
+    reply_error();
+    return;
+  }
+  submit_request(PikoRequestType::SetFlywheel, max_ms, true);
 }
 
-void handle_pulse_ppqn() {
+void handle_grain_interp() {
   const int value = read_byte_timeout(kWriteTimeoutMs);
   if (value == PICO_ERROR_TIMEOUT ||
-      !piko::ClockSync::validPulsePpqn(static_cast<uint8_t>(value))) {
-    write_str("ERR\n");
-    flush_serial();
+      !validGrainInterp(static_cast<uint8_t>(value))) {
+    reply_error();
     return;
   }
-  if (!piko_request_pulse_ppqn(static_cast<uint8_t>(value))) {
-    write_str("ERR\n");
-    flush_serial();
+  submit_request(PikoRequestType::SetGrainInterp, static_cast<uint32_t>(value),
+                 true);
+}
+
+// Three bytes: PPQN, division and pulse width in milliseconds.
+void handle_trigger_out() {
+  uint8_t bytes[3];
+  if (!read_exact(bytes, sizeof(bytes), kWriteTimeoutMs) ||
+      !TriggerClock::validPpqn(bytes[0]) ||
+      !TriggerClock::validDivision(bytes[1]) ||
+      !TriggerClock::validPulseWidthMs(bytes[2])) {
+    reply_error();
     return;
   }
-  write_str("OK\n");
-  flush_serial();
+  submit_request(PikoRequestType::SetTriggerOut,
+                 static_cast<uint32_t>(bytes[0]) |
+                     (static_cast<uint32_t>(bytes[1]) << 8u) |
+                     (static_cast<uint32_t>(bytes[2]) << 16u),
+                 true);
+}
+
+// snprintf at payload + n, advancing n. Returns false if the payload is full.
+bool append_format(char* payload, size_t size, int& n, const char* format,
+                   ...) {
+  const size_t room = size - static_cast<size_t>(n);
+  va_list args;
+  va_start(args, format);
+  const int written = vsnprintf(payload + n, room, format, args);
+  va_end(args);
+  if (written <= 0 || static_cast<size_t>(written) >= room) return false;
+  n += written;
+  return true;
+}
+
+// Appends " NAME c0,c1,...,c15", one count per Log2Histogram bucket: c0 is
+// exactly 0 us, cN is [2^(N-1), 2^N) us and c15 everything from 16384 us up.
+bool append_histogram(char* payload, size_t size, int& n, const char* name,
+                      const piko::ClockHistogram& histogram) {
+  if (!append_format(payload, size, n, " %s %lu", name,
+                     static_cast<unsigned long>(histogram.counts[0]))) {
+    return false;
+  }
+  for (uint8_t i = 1; i < piko::ClockHistogram::kBuckets; ++i) {
+    if (!append_format(payload, size, n, ",%lu",
+                       static_cast<unsigned long>(histogram.counts[i]))) {
+      return false;
+    }
+  }
+  return true;
 }
 
 void handle_clock_diagnostics() {
@@ -378,12 +650,15 @@ void handle_clock_diagnostics() {
     return;
   }
   const piko::ClockDiagnostics& d = snapshot.clock;
+  const PikoMidiClockStats out = piko_usb_midi_clock_stats();
+  const PikoMidiNoteStats notes = piko_usb_midi_note_stats();
   const uint32_t last_edge_age =
       d.accepted_events == 0 ? 0 : time_us_32() - d.last_edge_us;
-  char payload[512];
-  const int n = snprintf(
+  char payload[2048];
+  int n = snprintf(
       payload, sizeof(payload),
-      "CLOCK1 SOURCE %s STATE %s BPM_X100 %lu TARGET_BPM_X100 %lu JITTER_US %lu PHASE_ERROR_US %ld MAX_PHASE_ERROR_US %lu LAST_EDGE_AGE_US %lu PPQN %u ACCEPTED %lu REJECTED %lu MISSED %lu CLOCK_QUEUE_DROPS %lu MIDI_QUEUE_DROPS %lu\nEND\n",
+      "CLOCK1 SOURCE %s STATE %s BPM_X100 %lu TARGET_BPM_X100 %lu JITTER_US %lu PHASE_ERROR_US %ld MAX_PHASE_ERROR_US %lu LAST_EDGE_AGE_US %lu PPQN %u ACCEPTED %lu REJECTED %lu MISSED %lu CLOCK_QUEUE_DROPS %lu MIDI_QUEUE_DROPS %lu FILTER %s PLL_SHIFT %u OUTPUT_OFFSET_US %ld FLYWHEEL_MS %lu FLYWHEEL_ENTRIES %lu FLYWHEEL_RECOVERIES %lu FLYWHEEL_EXPIRIES %lu FLYWHEEL_TIME_MS %lu RELOCK_ERROR_US %ld MAX_RELOCK_ERROR_US %lu\n"
+      "MIDIOUT1 CLOCKS %lu TRANSPORT %lu DROPS %lu JITTER_US %lu MAX_JITTER_US %lu LATENCY_US %lu MAX_LATENCY_US %lu\n",
       piko::clockSourceName(d.source), piko::clockStateName(d.state),
       static_cast<unsigned long>(d.measured_bpm_x100),
       static_cast<unsigned long>(d.target_bpm_x100),
@@ -395,8 +670,260 @@ void handle_clock_diagnostics() {
       static_cast<unsigned long>(d.rejected_events),
       static_cast<unsigned long>(d.missed_events),
       static_cast<unsigned long>(snapshot.clock_queue_drops),
-      static_cast<unsigned long>(snapshot.midi_queue_drops));
-  if (n <= 0 || static_cast<size_t>(n) >= sizeof(payload)) {
+      static_cast<unsigned long>(snapshot.midi_queue_drops),
+      piko::clockFilterModeName(d.filter_mode), d.pll_shift,
+      static_cast<long>(d.output_offset_us),
+      static_cast<unsigned long>(d.flywheel_max_ms),
+      static_cast<unsigned long>(d.flywheel_entries),
+      static_cast<unsigned long>(d.flywheel_recoveries),
+      static_cast<unsigned long>(d.flywheel_expiries),
+      static_cast<unsigned long>(d.flywheel_time_ms),
+      static_cast<long>(d.relock_phase_error_us),
+      static_cast<unsigned long>(d.max_relock_phase_error_us),
+      static_cast<unsigned long>(out.clocks_sent),
+      static_cast<unsigned long>(out.transport_sent),
+      static_cast<unsigned long>(out.drops),
+      static_cast<unsigned long>(out.jitter_us),
+      static_cast<unsigned long>(out.max_jitter_us),
+      static_cast<unsigned long>(out.latency_us),
+      static_cast<unsigned long>(out.max_latency_us));
+  const bool ok =
+      n > 0 && static_cast<size_t>(n) < sizeof(payload) &&
+      append_format(
+          payload, sizeof(payload), n,
+          "NOTEOUT1 NOTES %lu NOTE_OFFS %lu CUTS %lu DROPS %lu PACKETS %lu "
+          "FLUSHES %lu MAX_FLUSH_PACKETS %lu JITTER_US %lu MAX_JITTER_US %lu "
+          "LATENCY_US %lu MAX_LATENCY_US %lu\n",
+          static_cast<unsigned long>(notes.notes_sent),
+          static_cast<unsigned long>(notes.note_offs_sent),
+          static_cast<unsigned long>(notes.note_cuts),
+          static_cast<unsigned long>(notes.drops),
+          static_cast<unsigned long>(notes.packets),
+          static_cast<unsigned long>(notes.flushes),
+          static_cast<unsigned long>(notes.max_flush_packets),
+          static_cast<unsigned long>(notes.jitter_us),
+          static_cast<unsigned long>(notes.max_jitter_us),
+          static_cast<unsigned long>(notes.latency_us),
+          static_cast<unsigned long>(notes.max_latency_us)) &&
+      append_format(payload, sizeof(payload), n,
+                    "CLOCKHIST1 SNAPS %lu SLEWS %lu",
+                    static_cast<unsigned long>(d.phase_snaps),
+                    static_cast<unsigned long>(d.phase_slews)) &&
+      append_histogram(payload, sizeof(payload), n, "DEVIATION_US",
+                       d.deviation_histogram) &&
+      append_histogram(payload, sizeof(payload), n, "PHASE_ERROR_US",
+                       d.phase_error_histogram) &&
+      append_format(
+          payload, sizeof(payload), n,
+          "\nTRIGOUT1 PPQN %u DIVISION %u WIDTH_MS %u PULSES %lu LATE %lu "
+          "OVERLAPS %lu SKIPPED %lu MAX_ERROR_US %lu",
+          snapshot.trigger_ppqn, snapshot.trigger_division,
+          snapshot.trigger_width_ms,
+          static_cast<unsigned long>(snapshot.trigger.pulses),
+          static_cast<unsigned long>(snapshot.trigger.late),
+          static_cast<unsigned long>(snapshot.trigger.overlaps),
+          static_cast<unsigned long>(snapshot.trigger_skipped),
+          static_cast<unsigned long>(snapshot.trigger.max_error_us)) &&
+      append_histogram(payload, sizeof(payload), n, "ERROR_US",
+                       snapshot.trigger.error_histogram) &&
+      append_format(payload, sizeof(payload), n, "\nEND\n");
+  if (!ok) {
+    write_u32(0);
+    flush_serial();
+    return;
+  }
+  write_u32(static_cast<uint32_t>(n));
+  write_bytes(payload, static_cast<uint32_t>(n));
+  flush_serial();
+}
+
+// Binary capture download. The reply is a u32 payload length followed by
+// u32 version, u32 records written since the last clear, u32 record count,
+// u32 device time, then the clock settings the records were filtered with:
+// u32 pulse PPQN, u32 filter mode, u32 PLL shift, i32 output offset in us and
+// u32 flywheel limit in ms. The records follow oldest first. Mode 1 clears
+// the ring after sending.
+void handle_clock_capture() {
+  const int value = read_byte_timeout(kWriteTimeoutMs);
+  PikoClockSnapshot snapshot{};
+  if (value == PICO_ERROR_TIMEOUT || (value != 0 && value != 1) ||
+      !piko_read_clock_snapshot(&snapshot)) {
+    write_str("ERR\n");
+    flush_serial();
+    return;
+  }
+  const piko::ClockDiagnostics& d = snapshot.clock;
+  piko_clock_capture_hold(true);
+  // A carrier IRQ that passed the hold check finishes well within this.
+  sleep_ms(1);
+  const uint32_t count = piko_clock_capture_size();
+  write_u32(9u * sizeof(uint32_t) + count * sizeof(piko::ClockCaptureRecord));
+  write_u32(kClockCaptureVersion);
+  write_u32(piko_clock_capture_written());
+  write_u32(count);
+  write_u32(time_us_32());
+  write_u32(d.pulse_ppqn);
+  write_u32(static_cast<uint32_t>(d.filter_mode));
+  write_u32(d.pll_shift);
+  write_u32(static_cast<uint32_t>(d.output_offset_us));
+  write_u32(d.flywheel_max_ms);
+  constexpr uint32_t kChunkRecords =
+      sizeof(page_buf) / sizeof(piko::ClockCaptureRecord);
+  for (uint32_t sent = 0; sent < count;) {
+    const uint32_t n =
+        count - sent < kChunkRecords ? count - sent : kChunkRecords;
+    for (uint32_t i = 0; i < n; ++i) {
+      const piko::ClockCaptureRecord record = piko_clock_capture_at(sent + i);
+      memcpy(page_buf + i * sizeof(record), &record, sizeof(record));
+    }
+    write_bytes(page_buf, n * sizeof(piko::ClockCaptureRecord));
+    sent += n;
+  }
+  if (value == 1) piko_clock_capture_clear();
+  piko_clock_capture_hold(false);
+  flush_serial();
+}
+
+#if TRACE_ENABLED == 1
+// Both cores' trace rings, core 0 first. The header gives each ring's total
+// written and downloaded counts so the host can tell how much was lost.
+void handle_trace() {
+  const int value = read_byte_timeout(kWriteTimeoutMs);
+  if (value == PICO_ERROR_TIMEOUT || (value != 0 && value != 1)) {
+    write_str("ERR\n");
+    flush_serial();
+    return;
+  }
+  piko_trace_hold(true);
+  sleep_ms(1);
+  const uint32_t counts[2] = {piko_trace_size(0), piko_trace_size(1)};
+  write_u32(6u * sizeof(uint32_t) +
+            (counts[0] + counts[1]) * sizeof(piko::TraceRecord));
+  write_u32(kTraceVersion);
+  for (uint8_t core = 0; core < 2; ++core) {
+    write_u32(piko_trace_written(core));
+    write_u32(counts[core]);
+  }
+  write_u32(time_us_32());
+  constexpr uint32_t kChunkRecords =
+      sizeof(page_buf) / sizeof(piko::TraceRecord);
+  for (uint8_t core = 0; core < 2; ++core) {
+    for (uint32_t sent = 0; sent < counts[core];) {
+      const uint32_t n = counts[core] - sent < kChunkRecords
+                             ? counts[core] - sent
+                             : kChunkRecords;
+      for (uint32_t i = 0; i < n; ++i) {
+        const piko::TraceRecord record = piko_trace_at(core, sent + i);
+        memcpy(page_buf + i * sizeof(record), &record, sizeof(record));
+      }
+      write_bytes(page_buf, n * sizeof(piko::TraceRecord));
+      sent += n;
+    }
+  }
+  if (value == 1) piko_trace_clear();
+  piko_trace_hold(false);
+  flush_serial();
+}
+#endif
+
+bool append_doorbell(char* payload, size_t size, int& n, unsigned core,
+                     const PikoDoorbellStats& stats) {
+  return append_format(
+      payload, size, n,
+      "DOORBELL1 CORE %u WAKEUPS_PER_S %lu RINGS_PER_S %lu RINGS %lu "
+      "RING_DROPS %lu LATENCY_US %lu MAX_LATENCY_US %lu\n",
+      core, static_cast<unsigned long>(stats.wakeups_per_second),
+      static_cast<unsigned long>(stats.rings_per_second),
+      static_cast<unsigned long>(stats.rings_taken),
+      static_cast<unsigned long>(stats.ring_drops),
+      static_cast<unsigned long>(stats.latency_us),
+      static_cast<unsigned long>(stats.max_latency_us));
+}
+
+// One QUEUE1 line per event queue when built with QUEUE_TELEMETRY.
+bool append_queues(char* payload, size_t size, int& n,
+                   const PikoEngineSnapshot& snapshot) {
+#if QUEUE_TELEMETRY == 1
+  for (uint32_t i = 0; i < PIKO_TELEMETRY_QUEUES; ++i) {
+    const PikoQueueTelemetry& queue = snapshot.queues[i];
+    const bool ok =
+        append_format(
+            payload, size, n,
+            "QUEUE1 NAME %s CAPACITY %lu HIGH_WATER %lu DROPS %lu TIMED %lu "
+            "MIN_US %lu MAX_US %lu",
+            piko::traceQueueName(static_cast<piko::TraceQueue>(i)),
+            static_cast<unsigned long>(queue.capacity),
+            static_cast<unsigned long>(queue.stats.high_water),
+            static_cast<unsigned long>(queue.drops),
+            static_cast<unsigned long>(queue.stats.timed),
+            static_cast<unsigned long>(queue.stats.min_latency_us),
+            static_cast<unsigned long>(queue.stats.max_latency_us)) &&
+        append_histogram(payload, size, n, "LATENCY_US",
+                         queue.stats.latency_histogram) &&
+        append_format(payload, size, n, "\n");
+    if (!ok) return false;
+  }
+#else
+  (void)payload;
+  (void)size;
+  (void)n;
+  (void)snapshot;
+#endif
+  return true;
+}
+
+void handle_engine_diagnostics() {
+  PikoEngineSnapshot snapshot{};
+  if (!piko_read_engine_snapshot(&snapshot)) {
+    write_u32(0);
+    flush_serial();
+    return;
+  }
+  char payload[2048];
+  int n = snprintf(
+      payload, sizeof(payload),
+      "ENGINE1 CACHE_HITS %lu CACHE_MISSES %lu CACHE_INVALIDATIONS %lu "
+      "GOVERNOR_LEVEL %lu GOVERNOR_ENTRIES %lu,%lu,%lu,%lu,%lu "
+      "GRAIN_INTERP %lu ISR_PEAK_CYCLES %lu ISR_BUDGET_CYCLES %lu ISR_OVERRUNS %lu "
+      "DELAY_CLAMPS %lu SLAVED %lu SLAVE_ERROR_FRAMES %ld SLAVE_MAX_ERROR_FRAMES %lu "
+      "MIDI_IN_EVENTS %lu MIDI_IN_DROPS %lu MIDI_IN_LATENCY_US %lu "
+      "MIDI_IN_MAX_LATENCY_US %lu PIPELINE %lu RENDER_UNDERRUNS %lu "
+      "RENDER_DEPTH %lu RENDER_MIN_DEPTH %lu RENDER_OUTPUT_DROPS %lu\n",
+      static_cast<unsigned long>(snapshot.render_cache_hits),
+      static_cast<unsigned long>(snapshot.render_cache_misses),
+      static_cast<unsigned long>(snapshot.render_cache_invalidations),
+      static_cast<unsigned long>(snapshot.governor_level),
+      static_cast<unsigned long>(snapshot.governor_entries[0]),
+      static_cast<unsigned long>(snapshot.governor_entries[1]),
+      static_cast<unsigned long>(snapshot.governor_entries[2]),
+      static_cast<unsigned long>(snapshot.governor_entries[3]),
+      static_cast<unsigned long>(snapshot.governor_entries[4]),
+      static_cast<unsigned long>(snapshot.grain_interp),
+      static_cast<unsigned long>(snapshot.isr_peak_cycles),
+      static_cast<unsigned long>(snapshot.isr_budget_cycles),
+      static_cast<unsigned long>(snapshot.isr_overruns),
+      static_cast<unsigned long>(snapshot.delay_clamps),
+      static_cast<unsigned long>(snapshot.slaved_playback),
+      static_cast<long>(snapshot.slave_error_frames),
+      static_cast<unsigned long>(snapshot.slave_max_error_frames),
+      static_cast<unsigned long>(snapshot.midi_in_events),
+      static_cast<unsigned long>(snapshot.midi_in_drops),
+      static_cast<unsigned long>(snapshot.midi_in_latency_us),
+      static_cast<unsigned long>(snapshot.midi_in_max_latency_us),
+      static_cast<unsigned long>(snapshot.render_pipeline),
+      static_cast<unsigned long>(snapshot.render_underruns),
+      static_cast<unsigned long>(snapshot.render_depth),
+      static_cast<unsigned long>(snapshot.render_min_depth),
+      static_cast<unsigned long>(snapshot.render_output_drops));
+  const bool ok =
+      n > 0 && static_cast<size_t>(n) < sizeof(payload) &&
+      append_doorbell(payload, sizeof(payload), n, 0,
+                      snapshot.core0_doorbell) &&
+      append_doorbell(payload, sizeof(payload), n, 1,
+                      piko_doorbell_stats()) &&
+      append_queues(payload, sizeof(payload), n, snapshot) &&
+      append_format(payload, sizeof(payload), n, "END\n");
+  if (!ok) {
     write_u32(0);
     flush_serial();
     return;
@@ -417,12 +944,9 @@ void piko_sample_manager_core() {
   tusb_init();
   while (true) {
     service_usb();
-    if (!serial_connected()) {
-      sleep_ms(1);
-      continue;
-    }
-    if (!command_interface_ready) {
-      sleep_ms(1);
+    service_requests();
+    if (!serial_connected() || !command_interface_ready) {
+      piko_doorbell_wait(make_timeout_time_ms(1));
       continue;
     }
 
@@ -431,7 +955,9 @@ void piko_sample_manager_core() {
       continue;
     }
 
-    switch (value & 0xff) {
+    const uint8_t command = static_cast<uint8_t>(value);
+    if (!pipelined_command(command)) drain_requests();
+    switch (command) {
       case 'X':
         send_sync();
         break;
@@ -450,13 +976,12 @@ void piko_sample_manager_core() {
         flush_serial();
         break;
       case 'S':
-        write_str(piko_request_stop_playback() ? "OK\n" : "ERR\n");
-        flush_serial();
+        submit_request(PikoRequestType::StopPlayback, 0, true);
         break;
       case 'B':
-        piko_request_stop_playback();
+        request_and_wait(PikoRequestType::StopPlayback, 0);
         handle_info();
-        piko_request_start_playback();
+        submit_request(PikoRequestType::StartPlayback, 0, false);
         break;
       case 'C':
         handle_clock_input_mode();
@@ -464,9 +989,41 @@ void piko_sample_manager_core() {
       case 'P':
         handle_pulse_ppqn();
         break;
+      case 'F':
+        handle_clock_filter();
+        break;
+      case 'L':
+        handle_output_offset();
+        break;
+      case 'V':
+        handle_slaved_playback();
+        break;
+      case 'H':
+        handle_flywheel();
+        break;
+      case 'G':
+        handle_trigger_out();
+        break;
+      case 'Q':
+        handle_grain_interp();
+        break;
+      case 'Z':
+        submit_request(PikoRequestType::ResetClockStatistics, 0, true);
+        break;
       case 'D':
         handle_clock_diagnostics();
         break;
+      case 'M':
+        handle_engine_diagnostics();
+        break;
+      case 'K':
+        handle_clock_capture();
+        break;
+#if TRACE_ENABLED == 1
+      case 'T':
+        handle_trace();
+        break;
+#endif
       case 'U':
         handle_bootloader_reset();
         break;
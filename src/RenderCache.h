@@ -0,0 +1,66 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct RenderCacheEntry {
+  uint8_t input;       // frame entering the lowpass, kept to restore its history
+  uint8_t output;      // final processed frame
+  int16_t lpf_output;  // lowpass output before the 8-bit cast, may overshoot
+};
+
+// Memoizes the processed output per source frame while the engine is in a
+// deterministic steady state. Entries are tagged by a parameter signature;
+// any signature change invalidates the whole cache. Frames past Frames are
+// never cached, so long loops are only partially memoized; the caller also
+// keeps head crossfades out of it. Owned by the audio
+// ISR; counters may be read from other contexts as plain 32-bit loads.
+template <size_t Frames>
+class RenderCache {
+  static_assert(Frames % 32u == 0, "cache frames must fill bitmap words");
+
+ public:
+  // Returns true when the signature differed and the cache was invalidated.
+  bool setSignature(uint32_t signature) {
+    if (signature == signature_) return false;
+    signature_ = signature;
+    invalidate();
+    return true;
+  }
+
+  bool lookup(uint32_t frame, RenderCacheEntry& entry) {
+    if (frame >= Frames || (valid_[frame >> 5u] & bit(frame)) == 0) {
+      ++misses_;
+      return false;
+    }
+    entry = entries_[frame];
+    ++hits_;
+    return true;
+  }
+
+  void store(uint32_t frame, const RenderCacheEntry& entry) {
+    if (frame >= Frames) return;
+    entries_[frame] = entry;
+    valid_[frame >> 5u] |= bit(frame);
+  }
+
+  void invalidate() {
+    for (uint32_t& word : valid_) word = 0;
+    ++invalidations_;
+  }
+
+  static constexpr uint32_t capacity() { return Frames; }
+  uint32_t hits() const { return hits_; }
+  uint32_t misses() const { return misses_; }
+  uint32_t invalidations() const { return invalidations_; }
+
+ private:
+  static uint32_t bit(uint32_t frame) { return 1u << (frame & 31u); }
+
+  RenderCacheEntry entries_[Frames]{};
+  uint32_t valid_[Frames / 32u]{};
+  uint32_t signature_ = 0;
+  volatile uint32_t hits_ = 0;
+  volatile uint32_t misses_ = 0;
+  volatile uint32_t invalidations_ = 0;
+};
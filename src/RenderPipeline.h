@@ -0,0 +1,81 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "SpscQueue.h"
+
+// Hand-off between a renderer running ahead at low priority and the PWM IRQ
+// that outputs one level per carrier tick. Side effects a tick produces (MIDI
+// clock, note-ons, trigger pulses) are deferred with that tick and released
+// by the pop that outputs its level, so they leave at output time instead of
+// up to the ring depth early. The renderer is the only producer and the
+// output IRQ the only consumer; the tick counters are each owned by one side.
+template <typename Output, size_t Levels, size_t Outputs>
+class RenderPipeline {
+ public:
+  // Renderer side.
+  bool full() const { return levels_.size() >= levels_.capacity(); }
+
+  // Attaches an output to the tick being rendered. A full side queue drops it;
+  // drops() counts those.
+  bool defer(const Output& output) {
+    return outputs_.push({render_tick_, output});
+  }
+
+  // Completes the tick being rendered. Only called when !full().
+  void push(uint8_t level) {
+    levels_.push(level);
+    ++render_tick_;
+  }
+
+  // Output side. Pops the next level and hands release() every output
+  // deferred with it, in order. On an underrun level keeps its last value.
+  template <typename Release>
+  bool pop(uint8_t& level, Release&& release) {
+    if (!levels_.pop(level)) {
+      ++underruns_;
+      min_depth_ = 0;
+      return false;
+    }
+    const uint32_t depth = static_cast<uint32_t>(levels_.size());
+    if (depth < min_depth_) min_depth_ = depth;
+    // Outputs are deferred before their tick's level is pushed, so every
+    // output of this tick is already visible.
+    while (have_pending_ || outputs_.pop(pending_)) {
+      have_pending_ = true;
+      if (static_cast<int32_t>(pending_.tick - output_tick_) > 0) break;
+      release(pending_.output);
+      have_pending_ = false;
+    }
+    ++output_tick_;
+    return true;
+  }
+
+  size_t size() const { return levels_.size(); }
+  static constexpr size_t capacity() { return Levels - 1u; }
+  uint32_t underruns() const { return underruns_; }
+  uint32_t drops() const { return outputs_.drops(); }
+
+  // Lowest depth since the last call; call with the output IRQ masked.
+  uint32_t takeMinDepth() {
+    const uint32_t depth = min_depth_;
+    min_depth_ = static_cast<uint32_t>(capacity());
+    return depth;
+  }
+
+ private:
+  struct Tagged {
+    uint32_t tick;
+    Output output;
+  };
+
+  SpscQueue<uint8_t, Levels> levels_;
+  SpscQueue<Tagged, Outputs> outputs_;
+  uint32_t render_tick_ = 0;  // renderer
+  uint32_t output_tick_ = 0;  // output IRQ
+  Tagged pending_{};          // popped, belongs to a later tick
+  bool have_pending_ = false;
+  uint32_t underruns_ = 0;
+  uint32_t min_depth_ = static_cast<uint32_t>(Levels - 1u);
+};
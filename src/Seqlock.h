@@ -0,0 +1,87 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <type_traits>
+
+// Default writer guard: a test-and-set flag. Targets without atomic
+// read-modify-write (the RP2040's Cortex-M0+) supply their own, such as a
+// hardware spin lock.
+class SeqlockFlagGuard {
+ public:
+  bool tryLock() { return !__atomic_test_and_set(&locked_, __ATOMIC_ACQUIRE); }
+  void unlock() { __atomic_clear(&locked_, __ATOMIC_RELEASE); }
+
+ private:
+  bool locked_ = false;
+};
+
+// Publishes a trivially copyable T from any number of writers to any number
+// of readers without blocking either side. Writers never wait: a write that
+// finds another in progress is dropped and reported, which suits periodic
+// telemetry and keeps an interrupt from spinning on the thread it preempted.
+// Readers retry a bounded number of times and report failure instead of
+// returning a torn copy. The payload is copied as relaxed atomic words so
+// concurrent access stays well defined.
+template <typename T, typename Guard = SeqlockFlagGuard>
+class Seqlock {
+  static_assert(std::is_trivially_copyable<T>::value,
+                "seqlock payloads are copied word by word");
+
+ public:
+  bool write(const T& value) {
+    if (!guard_.tryLock()) {
+      // Losing writers race on this count, so it is approximate.
+      __atomic_store_n(&collisions_,
+                       __atomic_load_n(&collisions_, __ATOMIC_RELAXED) + 1u,
+                       __ATOMIC_RELAXED);
+      return false;
+    }
+    uint32_t words[kWords] = {};
+    memcpy(words, &value, sizeof(T));
+    const uint32_t sequence = __atomic_load_n(&sequence_, __ATOMIC_RELAXED);
+    __atomic_store_n(&sequence_, sequence + 1u, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    for (size_t i = 0; i < kWords; ++i) {
+      __atomic_store_n(&words_[i], words[i], __ATOMIC_RELAXED);
+    }
+    __atomic_store_n(&sequence_, sequence + 2u, __ATOMIC_RELEASE);
+    guard_.unlock();
+    return true;
+  }
+
+  // Fills *value with a consistent copy, all zero before the first write.
+  // Fails only if every attempt overlapped a write.
+  bool read(T* value, uint8_t attempts = 8) const {
+    if (value == nullptr) return false;
+    uint32_t words[kWords];
+    for (uint8_t attempt = 0; attempt < attempts; ++attempt) {
+      const uint32_t before = __atomic_load_n(&sequence_, __ATOMIC_ACQUIRE);
+      if (before & 1u) continue;
+      for (size_t i = 0; i < kWords; ++i) {
+        words[i] = __atomic_load_n(&words_[i], __ATOMIC_RELAXED);
+      }
+      __atomic_thread_fence(__ATOMIC_ACQUIRE);
+      if (__atomic_load_n(&sequence_, __ATOMIC_RELAXED) == before) {
+        memcpy(value, words, sizeof(T));
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // Writes dropped because another writer held the guard.
+  uint32_t collisions() const {
+    return __atomic_load_n(&collisions_, __ATOMIC_RELAXED);
+  }
+
+ private:
+  static constexpr size_t kWords = (sizeof(T) + 3u) / 4u;
+
+  uint32_t sequence_ = 0;  // odd while a write is in progress
+  uint32_t words_[kWords] = {};
+  uint32_t collisions_ = 0;
+  Guard guard_;
+};
@@ -3,60 +3,123 @@
 #include <stddef.h>
 #include <stdint.h>
 
-// A bounded single-producer/single-consumer queue. The producer owns head and
-// the consumer owns tail; the barriers make it suitable for RP2040 IRQ/core
-// hand-offs as well as native tests.
+// A bounded single-producer/single-consumer queue holding up to Capacity - 1
+// entries. The producer owns head and the consumer owns tail. Each side
+// publishes its index with a release store and reads the other's with an
+// acquire load, so entries written before a push are visible after the
+// matching pop; that holds for RP2040 IRQ/core hand-offs as well as native
+// threads. push_n/pop_n move a batch for the price of one index exchange.
 template <typename T, size_t Capacity>
 class SpscQueue {
   static_assert(Capacity > 1, "queue needs at least two slots");
+  static_assert(Capacity <= 0x80000000u, "indices are 32-bit");
 
  public:
   bool push(const T& value) {
-    const uint32_t head = head_;
+    const uint32_t head = load<__ATOMIC_RELAXED>(head_);
     const uint32_t next = increment(head);
-    if (next == tail_) {
-      ++drops_;
+    if (next == load<__ATOMIC_ACQUIRE>(tail_)) {
+      addDrops(1);
       return false;
     }
     entries_[head] = value;
-    barrier();
-    head_ = next;
+    store<__ATOMIC_RELEASE>(head_, next);
     return true;
   }
 
+  // Pushes as many of values[0..count) as fit, in order. The rest count as
+  // drops. Returns the number pushed.
+  size_t push_n(const T* values, size_t count) {
+    const uint32_t head = load<__ATOMIC_RELAXED>(head_);
+    const uint32_t tail = load<__ATOMIC_ACQUIRE>(tail_);
+    const size_t room = freeSlots(head, tail);
+    const size_t n = count < room ? count : room;
+    uint32_t index = head;
+    for (size_t i = 0; i < n; ++i) {
+      entries_[index] = values[i];
+      index = increment(index);
+    }
+    if (n > 0) store<__ATOMIC_RELEASE>(head_, index);
+    if (n < count) addDrops(static_cast<uint32_t>(count - n));
+    return n;
+  }
+
   bool pop(T& value) {
-    const uint32_t tail = tail_;
-    if (tail == head_) {
+    const uint32_t tail = load<__ATOMIC_RELAXED>(tail_);
+    if (tail == load<__ATOMIC_ACQUIRE>(head_)) {
       return false;
     }
     value = entries_[tail];
-    barrier();
-    tail_ = increment(tail);
+    store<__ATOMIC_RELEASE>(tail_, increment(tail));
     return true;
   }
 
+  // Pops up to max_count entries into out. Returns the number popped.
+  size_t pop_n(T* out, size_t max_count) {
+    const uint32_t tail = load<__ATOMIC_RELAXED>(tail_);
+    const uint32_t head = load<__ATOMIC_ACQUIRE>(head_);
+    const size_t used = usedSlots(head, tail);
+    const size_t n = max_count < used ? max_count : used;
+    uint32_t index = tail;
+    for (size_t i = 0; i < n; ++i) {
+      out[i] = entries_[index];
+      index = increment(index);
+    }
+    if (n > 0) store<__ATOMIC_RELEASE>(tail_, index);
+    return n;
+  }
+
+  // Consumer side: discards everything queued so far.
   void clear() {
-    tail_ = head_;
-    barrier();
+    store<__ATOMIC_RELEASE>(tail_, load<__ATOMIC_ACQUIRE>(head_));
   }
 
-  uint32_t drops() const { return drops_; }
-  bool empty() const { return head_ == tail_; }
+  uint32_t drops() const { return load<__ATOMIC_RELAXED>(drops_); }
+  bool empty() const {
+    return load<__ATOMIC_ACQUIRE>(head_) == load<__ATOMIC_ACQUIRE>(tail_);
+  }
+  size_t size() const {
+    return usedSlots(load<__ATOMIC_ACQUIRE>(head_),
+                     load<__ATOMIC_ACQUIRE>(tail_));
+  }
+  static constexpr size_t capacity() { return Capacity - 1u; }
 
  private:
+  static constexpr bool kPowerOfTwo = (Capacity & (Capacity - 1u)) == 0;
+
+  // Power-of-two capacities wrap with a mask; others compare and reset.
   static uint32_t increment(uint32_t index) {
+    if (kPowerOfTwo) return (index + 1u) & (Capacity - 1u);
     ++index;
     return index == Capacity ? 0u : index;
   }
 
-  static void barrier() {
-#if defined(__GNUC__)
-    __atomic_thread_fence(__ATOMIC_SEQ_CST);
-#endif
+  static size_t usedSlots(uint32_t head, uint32_t tail) {
+    if (kPowerOfTwo) return (head - tail) & (Capacity - 1u);
+    return head >= tail ? head - tail : Capacity - tail + head;
+  }
+
+  static size_t freeSlots(uint32_t head, uint32_t tail) {
+    return Capacity - 1u - usedSlots(head, tail);
+  }
+
+  // Only the producer writes drops_, so a load and store suffice.
+  void addDrops(uint32_t count) {
+    store<__ATOMIC_RELAXED>(drops_, load<__ATOMIC_RELAXED>(drops_) + count);
+  }
+
+  template <int Order>
+  static uint32_t load(const uint32_t& value) {
+    return __atomic_load_n(&value, Order);
+  }
+
+  template <int Order>
+  static void store(uint32_t& value, uint32_t next) {
+    __atomic_store_n(&value, next, Order);
   }
 
   T entries_[Capacity]{};
-  volatile uint32_t head_ = 0;
-  volatile uint32_t tail_ = 0;
-  volatile uint32_t drops_ = 0;
+  uint32_t head_ = 0;
+  uint32_t tail_ = 0;
+  uint32_t drops_ = 0;
 };
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "Log2Histogram.h"
+#include "SpscQueue.h"
+
+// Wait-time telemetry for one queue. The consumer writes the latency fields
+// and the producer high_water, so every field has a single writer and reads
+// from either side see whole values, if not all from the same instant.
+struct SpscQueueStats {
+  uint32_t timed;           // items dequeued so far
+  uint32_t min_latency_us;  // 0 until the first item
+  uint32_t max_latency_us;
+  uint32_t high_water;      // most entries queued at once
+  piko::Log2Histogram latency_histogram;
+};
+
+// SpscQueue with the same interface that stamps each entry at push and
+// measures its wait at pop. Clock is a type with a static uint32_t nowUs():
+// the firmware reads the microsecond timer, tests supply a fake. Batches are
+// stamped and timed once per chunk of kChunk entries.
+template <typename T, size_t Capacity, typename Clock>
+class TimedSpscQueue {
+ public:
+  bool push(const T& value) {
+    if (!queue_.push({value, Clock::nowUs()})) return false;
+    noteOccupancy();
+    return true;
+  }
+
+  size_t push_n(const T* values, size_t count) {
+    size_t pushed = 0;
+    while (pushed < count) {
+      Entry chunk[kChunk];
+      const size_t n = count - pushed < kChunk ? count - pushed : kChunk;
+      const uint32_t now_us = Clock::nowUs();
+      for (size_t i = 0; i < n; ++i) chunk[i] = {values[pushed + i], now_us};
+      const size_t accepted = queue_.push_n(chunk, n);
+      pushed += accepted;
+      if (accepted < n) {
+        // push_n counted this chunk's overflow; count the rest too.
+        dropRemainder(count - pushed - (n - accepted));
+        break;
+      }
+    }
+    if (pushed > 0) noteOccupancy();
+    return pushed;
+  }
+
+  bool pop(T& value) {
+    Entry entry;
+    if (!queue_.pop(entry)) return false;
+    record(Clock::nowUs() - entry.enqueued_us);
+    value = entry.item;
+    return true;
+  }
+
+  size_t pop_n(T* out, size_t max_count) {
+    size_t popped = 0;
+    while (popped < max_count) {
+      Entry chunk[kChunk];
+      const size_t want =
+          max_count - popped < kChunk ? max_count - popped : kChunk;
+      const size_t n = queue_.pop_n(chunk, want);
+      if (n == 0) break;
+      const uint32_t now_us = Clock::nowUs();
+      for (size_t i = 0; i < n; ++i) {
+        record(now_us - chunk[i].enqueued_us);
+        out[popped + i] = chunk[i].item;
+      }
+      popped += n;
+      if (n < want) break;
+    }
+    return popped;
+  }
+
+  void clear() { queue_.clear(); }
+  uint32_t drops() const { return queue_.drops() + extra_drops_; }
+  bool empty() const { return queue_.empty(); }
+  size_t size() const { return queue_.size(); }
+  static constexpr size_t capacity() { return Capacity - 1u; }
+
+  SpscQueueStats stats() const {
+    SpscQueueStats out = stats_;
+    if (out.timed == 0) out.min_latency_us = 0;
+    return out;
+  }
+
+ private:
+  static constexpr size_t kChunk = 8;
+
+  struct Entry {
+    T item;
+    uint32_t enqueued_us;
+  };
+
+  void noteOccupancy() {
+    const uint32_t used = static_cast<uint32_t>(queue_.size());
+    if (used > stats_.high_water) stats_.high_water = used;
+  }
+
+  void record(uint32_t latency_us) {
+    ++stats_.timed;
+    if (latency_us < stats_.min_latency_us) stats_.min_latency_us = latency_us;
+    if (latency_us > stats_.max_latency_us) stats_.max_latency_us = latency_us;
+    stats_.latency_histogram.add(latency_us);
+  }
+
+  // Producer side, like SpscQueue's own drop count.
+  void dropRemainder(size_t count) {
+    extra_drops_ += static_cast<uint32_t>(count);
+  }
+
+  SpscQueue<Entry, Capacity> queue_;
+  SpscQueueStats stats_{0, UINT32_MAX, 0, 0, {}};
+  uint32_t extra_drops_ = 0;
+};
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <stdint.h>
+
+namespace piko {
+
+// Engine events recorded into the per-core trace rings. The comment on each
+// names its two arguments.
+enum class TraceEvent : uint8_t {
+  BeatOnset = 0,     // TraceBeatSource bits, beats since reset
+  RetrigStart = 1,   // retrig_sel | repeats << 8, repeat length in frames
+  RetrigEnd = 2,     // repeats played, 0
+  HeadSwitch = 3,    // new head | 0x100 for a retrigger, start frame
+  Clock = 4,         // ClockEventType | ClockOutcome << 8, edge timestamp
+  QueueDrop = 5,     // TraceQueue, total drops on that queue
+  FlashBegin = 6,    // TraceFlashOp, flash offset
+  FlashEnd = 7,      // TraceFlashOp, flash offset
+};
+
+enum TraceBeatSource : uint16_t {
+  kTraceBeatTransport = 1u << 0,
+  kTraceBeatReset = 1u << 1,
+  kTraceBeatSoftSync = 1u << 2,
+};
+
+enum class TraceQueue : uint16_t {
+  ClockEvent = 0,
+  MidiByte = 1,
+  UsbMidiClock = 2,
+  UsbMidiNote = 3,
+  UsbMidiRealtime = 4,
+  UsbMidiInput = 5,
+};
+
+inline const char* traceQueueName(TraceQueue queue) {
+  switch (queue) {
+    case TraceQueue::ClockEvent:
+      return "clock_event";
+    case TraceQueue::MidiByte:
+      return "midi_byte";
+    case TraceQueue::UsbMidiClock:
+      return "usb_midi_clock";
+    case TraceQueue::UsbMidiNote:
+      return "usb_midi_note";
+    case TraceQueue::UsbMidiRealtime:
+      return "usb_midi_realtime";
+    case TraceQueue::UsbMidiInput:
+      return "usb_midi_input";
+  }
+  return "unknown";
+}
+
+enum class TraceFlashOp : uint16_t { Erase = 0, Program = 1 };
+
+// One record as stored on the device and sent by the trace download. Fields
+// are little-endian on the wire in declaration order.
+struct TraceRecord {
+  uint32_t timestamp_us;
+  TraceEvent event;
+  uint8_t core;
+  uint16_t arg0;
+  uint32_t arg1;
+};
+static_assert(sizeof(TraceRecord) == 12, "trace record is 12 bytes");
+
+inline const char* traceEventName(TraceEvent event) {
+  switch (event) {
+    case TraceEvent::BeatOnset:
+      return "BEAT";
+    case TraceEvent::RetrigStart:
+      return "RETRIG_START";
+    case TraceEvent::RetrigEnd:
+      return "RETRIG_END";
+    case TraceEvent::HeadSwitch:
+      return "HEAD_SWITCH";
+    case TraceEvent::Clock:
+      return "CLOCK";
+    case TraceEvent::QueueDrop:
+      return "QUEUE_DROP";
+    case TraceEvent::FlashBegin:
+      return "FLASH_BEGIN";
+    case TraceEvent::FlashEnd:
+      return "FLASH_END";
+  }
+  return "UNKNOWN";
+}
+
+}  // namespace piko
@@ -0,0 +1,130 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "Log2Histogram.h"
+
+// Edge timing of the alarm-driven trigger output.
+struct TriggerOutStats {
+  uint32_t pulses;
+  uint32_t late;          // rises whose time had passed when they were armed
+  uint32_t overlaps;      // rises that replaced a pending one or cut one short
+  uint32_t max_error_us;  // rising edge against its scheduled time
+  piko::Log2Histogram error_histogram;
+};
+
+// Schedules trigger pulses from the ClockSync transport phase (one eighth
+// note per 2^32) at a configurable PPQN, keeping every division-th pulse.
+// Like MidiClockOut the phase is unwrapped into a position that never runs
+// backwards and pulses sit at absolute positions, so tempo changes never
+// accumulate drift. Each pulse is handed out shortly before it is due with
+// its delay in microseconds, worked out from the phase advanced per carrier,
+// so a hardware alarm can raise the output between carriers. The rate is the
+// smaller of this carrier's advance and the last one, so a forward phase
+// snap does not pass for a tempo jump.
+class TriggerClock {
+ public:
+  static constexpr uint32_t kLookaheadCarriers = 2;
+
+  static bool validPpqn(uint8_t ppqn) {
+    return ppqn == 1 || ppqn == 2 || ppqn == 4 || ppqn == 8 || ppqn == 12 ||
+           ppqn == 24;
+  }
+  static bool validDivision(uint8_t division) {
+    return division >= 1 && division <= 16;
+  }
+  static bool validPulseWidthMs(uint8_t width_ms) {
+    return width_ms >= 1 && width_ms <= 100;
+  }
+
+  void setCarrierHz(uint32_t carrier_hz) {
+    carrier_us_q16_ = (1000000ull << 16u) / (carrier_hz == 0 ? 1 : carrier_hz);
+  }
+
+  // Takes effect from the next pulse on the new grid.
+  void configure(uint8_t ppqn, uint8_t division) {
+    ppqn_ = validPpqn(ppqn) ? ppqn : 2;
+    division_ = validDivision(division) ? division : 1;
+    rebase_ = true;
+  }
+
+  // Counts divisions again from the next pulse on the grid.
+  void restart() { rebase_ = true; }
+
+  // Called once per carrier. schedule(delay_us) receives every pulse due
+  // within the lookahead, measured from the time of this call. Pulses the
+  // phase jumped past are skipped except the latest, which goes out at once.
+  template <typename Schedule>
+  void update(uint32_t phase_q32, bool running, Schedule&& schedule) {
+    const int32_t delta = static_cast<int32_t>(phase_q32 - last_phase_);
+    const int32_t rate =
+        last_delta_ > 0 && last_delta_ < delta ? last_delta_ : delta;
+    last_phase_ = phase_q32;
+    last_delta_ = delta;
+    transport_q32_ += delta;
+
+    if (!running) {
+      running_ = false;
+      return;
+    }
+    if (!running_) {
+      running_ = true;
+      rebase_ = true;
+    }
+    if (transport_q32_ > position_q32_) position_q32_ = transport_q32_;
+    if (rebase_) {
+      rebase_ = false;
+      next_pulse_ = (position_q32_ * ppqn_ + kQuarterQ32 - 1) >> 33u;
+      next_position_q32_ = pulsePosition(next_pulse_);
+    }
+    // Holding or snapped back: no rate to schedule from.
+    if (rate <= 0) return;
+
+    const int64_t horizon =
+        position_q32_ + static_cast<int64_t>(rate) * kLookaheadCarriers;
+    while (next_position_q32_ <= horizon) {
+      const int64_t following = pulsePosition(next_pulse_ + division_);
+      if (following <= position_q32_) {
+        ++skipped_;
+      } else {
+        const int64_t ahead = next_position_q32_ > position_q32_
+                                  ? next_position_q32_ - position_q32_
+                                  : 0;
+        schedule(static_cast<uint32_t>(
+            ((static_cast<uint64_t>(ahead) * carrier_us_q16_) /
+             static_cast<uint32_t>(rate)) >>
+            16u));
+        ++scheduled_;
+      }
+      next_pulse_ += division_;
+      next_position_q32_ = following;
+    }
+  }
+
+  uint8_t ppqn() const { return ppqn_; }
+  uint8_t division() const { return division_; }
+  uint32_t scheduled() const { return scheduled_; }
+  uint32_t skipped() const { return skipped_; }
+
+ private:
+  static constexpr int64_t kQuarterQ32 = int64_t{1} << 33u;
+
+  // First phase position at or after pulse n on the PPQN grid.
+  int64_t pulsePosition(int64_t n) const {
+    return (n * kQuarterQ32 + ppqn_ - 1) / ppqn_;
+  }
+
+  uint32_t last_phase_ = 0;
+  int32_t last_delta_ = 0;
+  int64_t transport_q32_ = 0;  // unwrapped transport position
+  int64_t position_q32_ = 0;   // monotonic position pulses are derived from
+  int64_t next_pulse_ = 0;     // index on the PPQN grid
+  int64_t next_position_q32_ = 0;
+  uint64_t carrier_us_q16_ = 1u << 16u;
+  uint32_t scheduled_ = 0;
+  uint32_t skipped_ = 0;
+  uint8_t ppqn_ = 2;
+  uint8_t division_ = 1;
+  bool running_ = false;
+  bool rebase_ = true;
+};
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <stdint.h>
+
+// Keeps the read position inside a slice locked to the transport phase.
+// Instead of letting playback free-run between beats and jump at the next
+// one, the source-frame increment is trimmed in proportion to how far the
+// frames played since the slice onset are from the frames the transport
+// phase calls for. Owned by the audio ISR; the cost per call is constant.
+class VarispeedSlave {
+ public:
+  // An error of 2^kGainShift frames trims the rate by the full base rate,
+  // so small errors are worked off over a few hundred frames.
+  static constexpr uint32_t kGainShift = 8;
+  // Trim is capped at 1/16 of the base rate (about a semitone).
+  static constexpr uint32_t kMaxTrimShift = 4;
+
+  void restart() { frames_ = 0; }
+  void advance() { ++frames_; }
+
+  // Returns the per-carrier increment for the next carrier. Errors beyond a
+  // quarter slice are not tempo error but a beat credited before the phase
+  // wrapped; those run at the base rate until the phase catches up.
+  uint64_t increment(uint64_t base_q32, uint32_t phase_q32,
+                     uint32_t slice_frames) {
+    const uint32_t expected = static_cast<uint32_t>(
+        (static_cast<uint64_t>(phase_q32) * slice_frames) >> 32u);
+    error_frames_ = static_cast<int32_t>(expected - frames_);
+    const int32_t limit = static_cast<int32_t>(slice_frames / 4u);
+    if (error_frames_ > limit || error_frames_ < -limit) return base_q32;
+    const uint32_t magnitude = static_cast<uint32_t>(
+        error_frames_ < 0 ? -error_frames_ : error_frames_);
+    if (magnitude > max_error_frames_) max_error_frames_ = magnitude;
+    const int64_t max_trim = static_cast<int64_t>(base_q32 >> kMaxTrimShift);
+    int64_t trim =
+        (static_cast<int64_t>(base_q32) * error_frames_) >> kGainShift;
+    if (trim > max_trim) trim = max_trim;
+    if (trim < -max_trim) trim = -max_trim;
+    return static_cast<uint64_t>(static_cast<int64_t>(base_q32) + trim);
+  }
+
+  uint32_t frames() const { return frames_; }
+  int32_t errorFrames() const { return error_frames_; }
+  // Largest error the loop has corrected, in frames.
+  uint32_t maxErrorFrames() const { return max_error_frames_; }
+
+ private:
+  uint32_t frames_ = 0;
+  int32_t error_frames_ = 0;
+  uint32_t max_error_frames_ = 0;
+};
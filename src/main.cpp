@@ -10,6 +10,8 @@
 #include "hardware/flash.h"  // flash memory
 #include "hardware/irq.h"    // interrupts
 #include "hardware/pwm.h"    // pwm
+#include "hardware/structs/scb.h"      // sleep on exit
+#include "hardware/structs/systick.h"  // isr cycle counter
 #include "hardware/sync.h"   // wait for interrupt
 #include "pico/binary_info.h"
 #include "pico/stdlib.h"  // stdlib
@@ -17,10 +19,20 @@
 #include "tusb.h"
 
 #include "PikoAudioBank.h"
+#include "PikoArena.h"
+#include "PikoQueue.h"
+#include "BeatRepeat.h"
 #include "ClockSync.h"
+#include "GrainInterp.h"
+#include "IsrGovernor.h"
+#include "MidiClockOut.h"
 #include "PikoRuntime.h"
 #include "PikoSampleManager.h"
+#include "RenderCache.h"
+#include "RenderPipeline.h"
 #include "SpscQueue.h"
+#include "TriggerClock.h"
+#include "VarispeedSlave.h"
 // pikocore files
 #include "doth/button.h"
 #include "doth/delay.h"
@@ -48,14 +60,14 @@
 #define DISTORTION_MAX 30
 #define VOLUME_REDUCE_MAX 30
 #define HEAD_SHIFT 10  // crossfade time in samples (2^HEAD_SHIFT)
+#define HEAD_SHIFT_SHORT 7  // crossfade used while the isr is over budget
 #define AUDIO_PIN 20   // audio out
 #ifdef PICO_DEFAULT_LED_PIN
 #define LED_PIN PICO_DEFAULT_LED_PIN
 #endif
 #define CLOCK_PIN 22  // clock in pin
 #define TRIGO_PIN 21  // trigger out pin
-#define MAIN_LOOP_HZ 4
-#define MAIN_LOOP_DELAY 50
+#define MAIN_LOOP_PERIOD_US 250  // one control-loop pass; 16 passes = 250 Hz
 
 #if WS2812_ENABLED == 1
 #include "doth/WS2812.hpp"
@@ -79,8 +91,18 @@
 #define SAVE_PROB_TUNNEL 12
 #define SAVE_CLOCK_INPUT_MODE 13
 #define SAVE_PULSE_PPQN 14
+#define SAVE_DELAY 15
+#define SAVE_CLOCK_FILTER 16  // 0 median, 1..6 pll bandwidth shift
+#define SAVE_OUTPUT_OFFSET 17  // needs two bytes, signed microseconds
+#define SAVE_SLAVED_PLAYBACK 19
+#define SAVE_FLYWHEEL_MS 20  // needs two bytes, 0 disables the flywheel
+#define SAVE_TRIGGER_PPQN 22
+#define SAVE_TRIGGER_DIVISION 23
+#define SAVE_TRIGGER_WIDTH_MS 24
+#define SAVE_GRAIN_INTERP 25  // GrainInterp + 1, so older pages read as unset
 #define CLOCK_INPUT_CLOCK 0
 #define CLOCK_INPUT_MIDI 1
+#define CLOCK_INPUT_USB_MIDI 2
 #define MIDI_NOTES_AVAILABLE_TOTAL 28
 static constexpr uint32_t kKnobMax = 4095u;
 static constexpr uint32_t kStretchQ8One = 256u;
@@ -91,6 +113,19 @@ static constexpr uint32_t kGrainLengthSamples = 2048u;
 static constexpr uint32_t kGrainHopSamples = 1024u;
 static constexpr uint32_t kGrainHopShift = 10u;
 static constexpr uint64_t kTimestretchPhaseIncQ32 = 1ull << 32u;
+static constexpr int8_t kPitchSemitonesMax = 12;
+// 2^(n/12) in Q16 for n = -12..12
+static const uint32_t pitch_ratio_q16[2 * kPitchSemitonesMax + 1] = {
+    32768, 34716, 36781, 38968, 41285, 43740,  46341,  49097,  52016,
+    55109, 58386, 61858, 65536, 69433, 73562,  77936,  82570,  87480,
+    92682, 98193, 104032, 110218, 116772, 123715, 131072};
+static constexpr uint32_t kBeatRepeatFrames = 8192u;
+static constexpr uint32_t kRenderCacheFrames = 8192u;
+static constexpr uint8_t kDelayDivisions = 5;
+// delay time per division in Q8 quarter notes: off, 1/16, dotted 1/16, 1/8,
+// dotted 1/8
+static const uint16_t delay_division_q8[kDelayDivisions] = {0, 64, 96, 128,
+                                                            192};
 static constexpr uint16_t kPwmWrap = 2047u;
 static constexpr uint16_t kPwmLevelScale = (kPwmWrap + 1u) / 256u;
 uint8_t midi_notes_available[MIDI_NOTES_AVAILABLE_TOTAL] = {
@@ -109,13 +144,26 @@ Knob input_knob[NUM_KNOBS];
 LEDArray ledarray;
 
 TriggerOut output_trigger;
+TriggerClock trigger_clock;
+uint8_t trigger_width_ms = 10;
 
 // audio tracking
 uint8_t audio_now = 0;
+// One carrier period is kPwmWrap + 1 cycles at clkdiv 1.
+IsrGovernor isr_governor(kPwmWrap + 1u);
+DegradeLevel governor_level = DegradeLevel::Full;
+bool governor_filter_bypass = false;
 uint64_t playback_phase_q32 = 0;
 uint64_t playback_increment_q32 = 1;
 uint64_t playback_effective_increment_q32 = 1;
+// Slice playback trimmed towards the transport phase; equals the effective
+// increment whenever slaving is off or not applicable.
+bool slaved_playback = false;
+VarispeedSlave varispeed;
+uint64_t playback_slaved_increment_q32 = 1;
 uint32_t pwm_carrier_hz = 1;
+// Wall time per source frame at the current tempo, for USB MIDI note lengths.
+uint32_t playback_us_per_frame_q16 = 0;
 uint32_t playback_target_bpm_x100 = 16500;
 bool do_mute = false;
 uint8_t do_mute_debounce = 0;
@@ -132,6 +180,7 @@ uint32_t phase_sample[] = {0, 0};
 uint32_t phase_retrig = 0;
 bool phase_head = 0;
 uint32_t phase_xfade = 0;
+uint8_t xfade_shift = HEAD_SHIFT;
 
 // beat tracking
 uint16_t select_beat = 0;
@@ -162,6 +211,11 @@ TimestretchGrain timestretch_grains[2] = {
     {0, kTimestretchPhaseIncQ32, kGrainHopSamples}};
 uint8_t timestretch_audio_now = 128;
 bool timestretch_active = false;
+int8_t timestretch_pitch_semitones = 0;
+uint64_t timestretch_pitch_inc_q32 = kTimestretchPhaseIncQ32;
+GrainInterp timestretch_interp = GrainInterp::Linear;
+GrainInterp timestretch_interp_set = GrainInterp::Linear;
+bool timestretch_single_grain = false;
 bool timestretch_grains_initialized = false;
 bool do_lock_clock = false;
 
@@ -190,7 +244,6 @@ uint8_t retrig_count = 0;
 uint8_t retrig_max = 2;
 uint8_t retrig_filter = 0;
 uint8_t retrig_filter_change = 0;
-int8_t retrig_pitch_change = 0;
 uint8_t retrig_volume_reduce = 0;
 uint8_t button_on = NUM_BUTTONS;
 uint8_t button_on2 = 3;
@@ -199,6 +252,22 @@ bool button_filter_on = false;
 uint8_t retrig_volume_reduce_change = 0;
 bool retrig_pitch_up = false;
 bool retrig_pitch_down = false;
+bool retrig_reverse = false;
+bool retrig_capturing = false;
+uint32_t retrig_capture_start = 0;
+// Pitch of the current retrigger pass in BeatRepeat rate units. Captured
+// passes replay at this rate; all others play the source this much faster.
+uint32_t retrig_rate_q8 = BeatRepeat<kBeatRepeatFrames>::kRateOne;
+RetrigEnvelope retrig_envelope;
+BeatRepeat<kBeatRepeatFrames> beat_repeat;
+
+// delay
+Delay delay;
+uint8_t delay_division = 0;
+
+// render memoization
+RenderCache<kRenderCacheFrames> render_cache;
+uint16_t render_cache_stable_beats = 0;
 
 // bpm configuring
 bool flag_half_time = 0;  // specifies quarter note or not
@@ -221,6 +290,7 @@ Onewiremidi *onewiremidi;
 int8_t midi_button1 = -1;
 int8_t midi_button2 = -1;
 volatile bool clock_input_ittybittymidi = false;
+volatile uint8_t clock_input_mode = CLOCK_INPUT_CLOCK;
 volatile uint8_t pulse_ppqn = 2;
 
 struct MidiByteEvent {
@@ -229,15 +299,62 @@ struct MidiByteEvent {
 };
 
 piko::ClockSync clock_sync;
-SpscQueue<piko::ClockEvent, 32> clock_event_queue;
-SpscQueue<MidiByteEvent, 64> midi_byte_queue;
+PikoQueue<piko::ClockEvent, 32> clock_event_queue;
+PikoQueue<MidiByteEvent, 64> midi_byte_queue;
 uint32_t core1_stack[2048] __attribute__((aligned(8)));
 
-inline void set_audio_pwm_level(uint8_t level) {
+inline void output_audio_level(uint8_t level) {
   pwm_set_gpio_level(AUDIO_PIN,
                       static_cast<uint16_t>(level) * kPwmLevelScale);
 }
 
+// A MIDI clock byte, note-on or trigger pulse raised while rendering a tick.
+struct TransportOutput {
+  enum class Kind : uint8_t { MidiRealtime, NoteOn, Trigger };
+  Kind kind;
+  uint8_t data1;      // realtime status or note
+  uint8_t data2;      // note velocity
+  uint32_t time_us;   // note length or trigger delay
+};
+
+void send_transport_output(const TransportOutput &output) {
+  switch (output.kind) {
+    case TransportOutput::Kind::MidiRealtime:
+      piko_usb_midi_realtime(output.data1, time_us_32());
+      break;
+    case TransportOutput::Kind::NoteOn:
+      piko_usb_midi_note_on(output.data1, output.data2, output.time_us);
+      break;
+    case TransportOutput::Kind::Trigger:
+      output_trigger.Schedule(output.time_us);
+      break;
+  }
+}
+
+#if RENDER_PIPELINE == 1
+// Pipeline mode: a lowest-priority user IRQ renders carrier ticks ahead into
+// this ring and the PWM IRQ only outputs them, so a slow tick (a beat onset,
+// a grain restart) borrows from the ring instead of overrunning the carrier
+// period. Transport outputs ride with their tick and leave when its level is
+// output, so they keep time with the audio rather than the renderer.
+constexpr size_t kRenderRingSize = 64;
+constexpr size_t kRenderRefillDepth = 48;  // wake the renderer at or below
+RenderPipeline<TransportOutput, kRenderRingSize, 32> render_pipeline;
+uint render_irq = 0;
+uint8_t rendered_level = 128;  // the current render pass's output
+uint8_t output_level = 128;    // held through an underrun
+
+inline void set_audio_pwm_level(uint8_t level) { rendered_level = level; }
+inline void emit_transport_output(const TransportOutput &output) {
+  render_pipeline.defer(output);
+}
+#else
+inline void set_audio_pwm_level(uint8_t level) { output_audio_level(level); }
+inline void emit_transport_output(const TransportOutput &output) {
+  send_transport_output(output);
+}
+#endif
+
 /*
  * HELPER FUNCTIONS
  * knobs / clock in can set these inputs
@@ -277,25 +394,72 @@ void param_set_break(uint16_t knob_val, uint8_t &filter_fc_,
       (uint8_t)(distortion_ * 1095 / DISTORTION_MAX + 3000);
 }
 
+// The delay advances once per source frame, and source frames run faster or
+// slower with the tempo, so the tap is measured at the sample's own tempo.
+// It only changes with the sample, never with the clock.
+void update_delay_time() {
+  delay.SetTimeQ16(Delay::BeatsToFramesQ16(
+      delay_division_q8[delay_division], sample_source_bpm * 100u,
+      SAMPLE_RATE));
+}
+
+// The delay line lives in the shared arena. It is detached whenever a bank
+// upload borrows the arena and re-attached, empty, once the upload is done;
+// attaching starts the tap at the time last set.
+void service_delay_arena() {
+  uint8_t *arena = piko_arena_audio_acquire();
+  if (arena == nullptr) {
+    delay.Detach();
+  } else if (!delay.Attached()) {
+    delay.Attach(arena, PIKO_ARENA_SIZE);
+  }
+}
+
 void update_playback_rate() {
   playback_target_bpm_x100 = clock_sync.targetBpmX100();
   playback_increment_q32 = piko::ClockSync::playbackIncrementQ32(
       pwm_carrier_hz, playback_target_bpm_x100, sample_source_bpm);
   if (playback_increment_q32 == 0) playback_increment_q32 = 1;
-
-  // Retrigger pitch historically adjusted the number of carrier periods per
-  // source frame. Preserve that behavior while keeping the base rate
-  // fractional instead of rounding it to a whole PWM period.
-  const uint64_t period_q16 = (1ull << 48u) / playback_increment_q32;
-  int64_t adjusted_period_q16 =
-      static_cast<int64_t>(period_q16) +
-      (static_cast<int64_t>(retrig_pitch_change) << 16u);
-  if (adjusted_period_q16 < (1 << 16u)) adjusted_period_q16 = 1 << 16u;
+  // Pitch is applied by the grain engine and the beat-repeat replay rate.
+  // A retrigger pass that is not replaying a capture pitches by running the
+  // source-frame clock at its rate instead.
   playback_effective_increment_q32 =
-      (1ull << 48u) / static_cast<uint64_t>(adjusted_period_q16);
-  if (playback_effective_increment_q32 == 0) {
-    playback_effective_increment_q32 = 1;
+      beat_repeat.sourceIncrementQ32(playback_increment_q32, retrig_rate_q8);
+  playback_slaved_increment_q32 = playback_effective_increment_q32;
+  uint64_t ticks_per_frame_q16 =
+      (1ull << 48u) / playback_effective_increment_q32;
+  if (ticks_per_frame_q16 > UINT32_MAX) ticks_per_frame_q16 = UINT32_MAX;
+  const uint64_t us_per_frame_q16 =
+      ticks_per_frame_q16 * 1000000u / pwm_carrier_hz;
+  playback_us_per_frame_q16 = us_per_frame_q16 > UINT32_MAX
+                                  ? UINT32_MAX
+                                  : static_cast<uint32_t>(us_per_frame_q16);
+}
+
+uint32_t frames_to_us(uint32_t frames) {
+  return static_cast<uint32_t>(
+      (static_cast<uint64_t>(frames) * playback_us_per_frame_q16) >> 16u);
+}
+
+// Once per source frame: retrims the slice read rate so the frames played
+// since the onset follow the transport phase. Retriggers, half-time slices
+// and the grain engine keep the plain tempo-derived rate.
+void update_slaved_increment() {
+  if (!slaved_playback || timestretch_active || fx_retrig || flag_half_time) {
+    playback_slaved_increment_q32 = playback_effective_increment_q32;
+    return;
   }
+  playback_slaved_increment_q32 = varispeed.increment(
+      playback_effective_increment_q32,
+      static_cast<uint32_t>(clock_sync.transportPhaseQ32()),
+      sample_frames_per_slice);
+}
+
+void param_set_slaved_playback(bool enabled) {
+  const uint32_t interrupts = save_and_disable_interrupts();
+  slaved_playback = enabled;
+  playback_slaved_increment_q32 = playback_effective_increment_q32;
+  restore_interrupts(interrupts);
 }
 
 void param_set_bpm(uint16_t bpm) {
@@ -311,6 +475,60 @@ void param_set_bpm(uint16_t bpm) {
 #endif
 }
 
+void param_set_delay(uint8_t division) {
+  const uint32_t interrupts = save_and_disable_interrupts();
+  delay_division = division % kDelayDivisions;
+  update_delay_time();
+  restore_interrupts(interrupts);
+}
+
+void param_set_clock_filter(uint8_t value) {
+  const uint32_t interrupts = save_and_disable_interrupts();
+  if (value == 0) {
+    clock_sync.setFilterMode(piko::ClockFilterMode::Median, 0);
+  } else {
+    clock_sync.setFilterMode(piko::ClockFilterMode::Pll, value);
+  }
+  restore_interrupts(interrupts);
+}
+
+void param_set_output_offset(int16_t offset_us) {
+  const uint32_t interrupts = save_and_disable_interrupts();
+  clock_sync.setOutputOffsetUs(offset_us);
+  restore_interrupts(interrupts);
+}
+
+void param_set_flywheel(uint16_t max_ms) {
+  const uint32_t interrupts = save_and_disable_interrupts();
+  clock_sync.setFlywheelMs(max_ms);
+  restore_interrupts(interrupts);
+}
+
+void param_set_trigger_out(uint8_t ppqn, uint8_t division, uint8_t width_ms) {
+  trigger_width_ms = width_ms;
+  const uint32_t interrupts = save_and_disable_interrupts();
+  trigger_clock.configure(ppqn, division);
+  output_trigger.SetPulseWidth(width_ms);
+  restore_interrupts(interrupts);
+}
+
+// The governor still drops to nearest-sample grains under load; the setting
+// returns once it restores that level.
+void param_set_grain_interp(GrainInterp interp) {
+  const uint32_t interrupts = save_and_disable_interrupts();
+  timestretch_interp_set = interp;
+  if (governor_level < DegradeLevel::NearestGrains) {
+    timestretch_interp = interp;
+  }
+  restore_interrupts(interrupts);
+}
+
+void clock_statistics_reset() {
+  const uint32_t interrupts = save_and_disable_interrupts();
+  clock_sync.resetStatistics();
+  restore_interrupts(interrupts);
+}
+
 void param_set_volume(uint16_t knobval, uint8_t &distortion_,
                       uint8_t &volume_reduce_) {
   if (knobval < 2000) {
@@ -377,6 +595,7 @@ void refresh_sample_timing(uint16_t sample_index) {
     sample_source_bpm = BPM_SAMPLED;
   }
   update_playback_rate();
+  update_delay_time();
 }
 
 uint32_t stretch_from_knob_q8(uint16_t knob) {
@@ -392,6 +611,25 @@ void set_timestretch_knob(uint16_t knob) {
   stretch_q8 = stretch_from_knob_q8(knob);
 }
 
+void param_set_pitch(int8_t semitones) {
+  if (semitones > kPitchSemitonesMax) semitones = kPitchSemitonesMax;
+  if (semitones < -kPitchSemitonesMax) semitones = -kPitchSemitonesMax;
+  const uint64_t inc_q32 =
+      static_cast<uint64_t>(pitch_ratio_q16[semitones + kPitchSemitonesMax])
+      << 16u;
+  const uint32_t interrupts = save_and_disable_interrupts();
+  timestretch_pitch_semitones = semitones;
+  timestretch_pitch_inc_q32 = inc_q32;
+  restore_interrupts(interrupts);
+}
+
+int8_t pitch_from_knob(uint16_t knob) {
+  return static_cast<int8_t>(
+      static_cast<int32_t>(knob) * (2 * kPitchSemitonesMax + 1) /
+          (kKnobMax + 1) -
+      kPitchSemitonesMax);
+}
+
 uint64_t wrap_stretch_phase(uint64_t phase_q32, uint32_t frame_count) {
   if (frame_count == 0) {
     return 0;
@@ -431,18 +669,10 @@ uint32_t grain_window(uint16_t age) {
 int16_t read_interpolated_stretch_sample(uint16_t sample_index,
                                          uint64_t phase_q32) {
   const uint32_t frame_count = raw_len(sample_index);
-  phase_q32 = wrap_stretch_phase(phase_q32, frame_count);
-  const uint32_t frame = static_cast<uint32_t>(phase_q32 >> 32u);
-  const uint32_t next_frame = frame + 1u < frame_count ? frame + 1u : 0u;
-  const uint32_t frac = static_cast<uint32_t>(phase_q32);
-
-  const int16_t a = static_cast<int16_t>(raw_val(sample_index, frame)) - 128;
-  const int16_t b =
-      static_cast<int16_t>(raw_val(sample_index, next_frame)) - 128;
-  const int32_t diff = static_cast<int32_t>(b) - static_cast<int32_t>(a);
-  return static_cast<int16_t>(
-      static_cast<int32_t>(a) +
-      static_cast<int32_t>((static_cast<int64_t>(diff) * frac) >> 32u));
+  return interpolateGrainSample(
+      timestretch_interp, frame_count,
+      wrap_stretch_phase(phase_q32, frame_count),
+      [sample_index](uint32_t frame) { return raw_val(sample_index, frame); });
 }
 
 void invalidate_timestretch_grains() {
@@ -454,11 +684,12 @@ void initialize_timestretch_grains() {
   timestretch_phase_q32 = wrap_stretch_phase(timestretch_phase_q32, frame_count);
   const uint64_t previous_grain_offset =
       static_cast<uint64_t>(kGrainHopSamples) * kTimestretchPhaseIncQ32;
-  timestretch_grains[0] = {timestretch_phase_q32, kTimestretchPhaseIncQ32, 0};
+  timestretch_grains[0] = {timestretch_phase_q32, timestretch_pitch_inc_q32,
+                           0};
   timestretch_grains[1] = {
       subtract_stretch_phase(timestretch_phase_q32, previous_grain_offset,
                              frame_count),
-      kTimestretchPhaseIncQ32, static_cast<uint16_t>(kGrainHopSamples)};
+      timestretch_pitch_inc_q32, static_cast<uint16_t>(kGrainHopSamples)};
   timestretch_grains_initialized = true;
 }
 
@@ -488,8 +719,10 @@ void advance_timestretch_grain(TimestretchGrain &grain) {
     return;
   }
 
+  // Each new grain picks up the current pitch; the overlap-add window hides
+  // the ratio change between neighbouring grains.
   grain.start_phase_q32 = timestretch_phase_q32;
-  grain.phase_inc_q32 = kTimestretchPhaseIncQ32;
+  grain.phase_inc_q32 = timestretch_pitch_inc_q32;
   grain.age = 0;
 }
 
@@ -499,8 +732,24 @@ uint8_t render_stretched_sample() {
   }
 
   int32_t mixed = 0;
-  accumulate_timestretch_grain(timestretch_grains[0], mixed);
-  accumulate_timestretch_grain(timestretch_grains[1], mixed);
+  if (timestretch_single_grain) {
+    // Only the louder grain is read, at full weight; its window edge clicks
+    // once per hop but halves the flash reads.
+    const TimestretchGrain &grain =
+        grain_window(timestretch_grains[0].age) >=
+                grain_window(timestretch_grains[1].age)
+            ? timestretch_grains[0]
+            : timestretch_grains[1];
+    const uint64_t grain_phase =
+        grain.start_phase_q32 +
+        (static_cast<uint64_t>(grain.age) * grain.phase_inc_q32);
+    mixed = static_cast<int32_t>(
+                read_interpolated_stretch_sample(sample, grain_phase)) *
+            static_cast<int32_t>(kGrainHopSamples);
+  } else {
+    accumulate_timestretch_grain(timestretch_grains[0], mixed);
+    accumulate_timestretch_grain(timestretch_grains[1], mixed);
+  }
 
   advance_timestretch_phase_by(timestretch_source_inc_q32);
   advance_timestretch_grain(timestretch_grains[0]);
@@ -518,18 +767,115 @@ uint8_t render_stretched_sample() {
 }
 
 void reset_retrig_fx() {
+  if (fx_retrig) PIKO_TRACE(piko::TraceEvent::RetrigEnd, retrig_count, 0);
   retrig_filter = 0;
   retrig_pitch_up = false;
   retrig_pitch_down = false;
-  retrig_pitch_change = 0;
   retrig_volume_reduce = 0;
   retrig_volume_reduce_change = 0;
   button_filter_on = false;
   fx_retrig = false;
   btn_retrig = false;
+  retrig_reverse = false;
+  retrig_capturing = false;
+  retrig_rate_q8 = BeatRepeat<kBeatRepeatFrames>::kRateOne;
+  beat_repeat.stop();
   update_playback_rate();
 }
 
+// Every pass of a pitched retrigger, the first included, is a semitone on
+// from the last. The first pass renders from flash and is captured post-FX;
+// later passes replay that capture at the pass rate. Retriggers too long to
+// capture keep rendering and pitch through the source-frame clock.
+void advance_beat_repeat(uint32_t length) {
+  if (!fx_retrig) return;
+  retrig_rate_q8 = BeatRepeat<kBeatRepeatFrames>::stepSemitone(
+      retrig_rate_q8, retrig_pitch_up, retrig_pitch_down);
+  if (retrig_count <= 1) {
+    retrig_capture_start = beat_repeat.position();
+    retrig_capturing = length <= beat_repeat.capacity();
+    retrig_envelope.reset();
+  } else if (retrig_capturing) {
+    if (beat_repeat.active()) {
+      beat_repeat.restart();
+    } else if (!beat_repeat.start(retrig_capture_start, length,
+                                  retrig_reverse)) {
+      retrig_capturing = false;
+    }
+  }
+  if (beat_repeat.active()) beat_repeat.setRate(retrig_rate_q8);
+  update_playback_rate();
+}
+
+// Lays the retrigger envelope over a frame that already carries the full
+// effect chain: the capturing pass as it renders, and every replay.
+uint8_t apply_retrig_envelope(uint8_t value) {
+  return retrig_envelope.apply(
+      value, retrig_volume_reduce,
+      static_cast<uint32_t>(retrig_filter) * retrig_filter_change, LPF_MAX);
+}
+
+// With no probabilities, held buttons, retriggers or stretch, the output for a
+// source frame is a pure function of the parameters in the cache signature.
+bool render_cache_steady() {
+  return !timestretch_active && !fx_retrig && !btn_retrig &&
+         button_on >= NUM_BUTTONS && probability_jump == 0 &&
+         probability_direction == 0 && probability_retrig == 0 &&
+         probability_gate == 0 && probability_tunnel == 0 &&
+         delay_division == 0;
+}
+
+uint32_t render_cache_signature() {
+  uint32_t hash = 2166136261u;
+  const uint32_t values[] = {sample,
+                             distortion,
+                             volume_reduce,
+                             volume_mod,
+                             filter_fc,
+                             filter_q,
+                             button_filter,
+                             playback_target_bpm_x100,
+                             piko_audio_sample_count(),
+                             static_cast<uint32_t>(governor_level)};
+  for (const uint32_t value : values) {
+    hash = (hash ^ value) * 16777619u;
+  }
+  // Zero is reserved for "bank changed" so it never matches a live state.
+  return hash | 1u;
+}
+
+// Returns true when the current audio tick may read or fill the cache. Filling
+// waits one full loop after any change so the lowpass history has settled.
+bool update_render_cache() {
+  if (!render_cache_steady()) {
+    render_cache_stable_beats = 0;
+    return false;
+  }
+  if (render_cache.setSignature(render_cache_signature())) {
+    render_cache_stable_beats = 0;
+  }
+  return render_cache_stable_beats >= sample_beats && phase_xfade == 0 &&
+         direction[phase_head] && noise_gate_fade == 0;
+}
+
+// The lowpass runs, and advances its history, only while the combined cutoff
+// is in range and the governor has not bypassed it.
+bool lpf_active(int32_t retrig_cut) {
+  return !governor_filter_bypass &&
+         (filter_fc - retrig_cut - button_filter) <= LPF_MAX;
+}
+
+// Replays the lowpass history a cache hit skipped so the filter continues
+// seamlessly once rendering resumes. A bypassed filter keeps its history, the
+// same as a rendered frame would leave it.
+void restore_lpf_history(const RenderCacheEntry &entry, int32_t retrig_cut) {
+  if (!lpf_active(retrig_cut)) return;
+  x2_f = x1_f;
+  x1_f = entry.input;
+  y2_f = y1_f;
+  y1_f = entry.lpf_output;
+}
+
 void sync_phase_sample_from_timestretch() {
   const uint32_t frame_count = raw_len(sample);
   timestretch_phase_q32 = wrap_stretch_phase(timestretch_phase_q32, frame_count);
@@ -541,7 +887,8 @@ void sync_phase_sample_from_timestretch() {
 
 void update_timestretch_state() {
   const uint32_t target_stretch_q8 = stretch_q8;
-  if (target_stretch_q8 < kStretchQ8Bypass) {
+  if (target_stretch_q8 < kStretchQ8Bypass &&
+      timestretch_pitch_semitones == 0) {
     if (timestretch_active) {
       sync_phase_sample_from_timestretch();
       invalidate_timestretch_grains();
@@ -561,7 +908,10 @@ void update_timestretch_state() {
   }
 
   timestretch_active = true;
-  if (target_stretch_q8 != timestretch_applied_q8) {
+  if (target_stretch_q8 < kStretchQ8Bypass) {
+    timestretch_applied_q8 = kStretchQ8One;
+    timestretch_source_inc_q32 = kTimestretchPhaseIncQ32;
+  } else if (target_stretch_q8 != timestretch_applied_q8) {
     timestretch_applied_q8 = target_stretch_q8;
     timestretch_source_inc_q32 =
         (kTimestretchPhaseIncQ32 << 8u) / target_stretch_q8;
@@ -587,7 +937,119 @@ void sync_timestretch_sample_selection() {
 void do_stop_everything();
 void do_start_everything();
 
+#if USB_MIDI_CLOCK_OUT == 1
+MidiClockOut midi_clock_out;
+
+// Sends 24-PPQN clock over USB while the transport runs. Each message is
+// stamped with the time it became due so core 1 can measure delivery jitter.
+void service_midi_clock_out() {
+  const bool running = !do_mute && !clock_sync.transportPaused();
+  midi_clock_out.update(
+      static_cast<uint32_t>(clock_sync.transportPhaseQ32()), running,
+      [](uint8_t status) {
+        emit_transport_output(
+            {TransportOutput::Kind::MidiRealtime, status, 0, 0});
+      });
+}
+#endif
+
+// Pulses the trigger jack on the transport grid while it runs. The alarm
+// raises the output at the computed time, so the carrier only decides when
+// each pulse is armed.
+void service_trigger_out() {
+  const bool running = !do_mute && !clock_sync.transportPaused();
+  trigger_clock.update(
+      static_cast<uint32_t>(clock_sync.transportPhaseQ32()), running,
+      [](uint32_t delay_us) {
+        emit_transport_output(
+            {TransportOutput::Kind::Trigger, 0, 0, delay_us});
+      });
+}
+
+// MIDI notes hold buttons the same way the panel does; the button scan skips
+// held MIDI buttons so their state is not read back from the GPIO.
+void midi_button_press(uint8_t button) {
+  if (midi_button1 > -1) {
+    midi_button2 = button;
+  } else {
+    midi_button1 = button;
+  }
+  input_button[button].Set(true);
+}
+
+void midi_button_release(uint8_t button) {
+  input_button[button].Set(false);
+  if (midi_button2 > -1) {
+    midi_button2 = -1;
+  } else {
+    midi_button1 = -1;
+  }
+}
+
+#if USB_MIDI_IN == 1
+// Notes from kUsbMidiSliceNote up hold the slice buttons; other notes
+// transpose the grain engine around middle C. CC 1 sets the retrig
+// probability, CC 7 the volume and CC 74 the filter cutoff, each over the
+// same range as its knob.
+constexpr uint8_t kUsbMidiSliceNote = 36;
+uint32_t usb_midi_in_events = 0;
+uint32_t usb_midi_in_latency_us = 0;
+uint32_t usb_midi_in_max_latency_us = 0;
+
+void apply_usb_midi_input(const PikoMidiInputEvent &event) {
+  const uint8_t type = event.status & 0xF0;
+  const bool slice = event.data1 >= kUsbMidiSliceNote &&
+                     event.data1 < kUsbMidiSliceNote + NUM_BUTTONS;
+  if (type == 0x90) {
+    if (slice) {
+      midi_button_press(event.data1 - kUsbMidiSliceNote);
+    } else {
+      param_set_pitch(
+          static_cast<int8_t>(static_cast<int16_t>(event.data1) - 60));
+    }
+  } else if (type == 0x80) {
+    if (slice) midi_button_release(event.data1 - kUsbMidiSliceNote);
+  } else if (type == 0xB0) {
+    switch (event.data1) {
+      case 1:
+        probability_retrig = event.data2 * 2u;
+        break;
+      case 7:
+        param_set_volume(event.data2 * 4095u / 127u, distortion,
+                         volume_reduce);
+        break;
+      case 74:
+        filter_fc = event.data2 * (LPF_MAX + 10) / 127;
+        break;
+      default:
+        break;
+    }
+  }
+}
+
+// Applies whatever core 1 has queued, and measures how long each event took
+// from USB arrival. Runs in the control loop: notes hold buttons and CCs set
+// parameters that the button scan and knob handling also write, so none of
+// it may happen inside the carrier ISR.
+void service_usb_midi_input() {
+  PikoMidiInputEvent event{};
+  while (piko_usb_midi_input_pop(&event)) {
+    apply_usb_midi_input(event);
+    const uint32_t latency = time_us_32() - event.timestamp_us;
+    usb_midi_in_latency_us = (usb_midi_in_latency_us * 7u + latency) / 8u;
+    if (latency > usb_midi_in_max_latency_us) {
+      usb_midi_in_max_latency_us = latency;
+    }
+    ++usb_midi_in_events;
+  }
+}
+#endif
+
 void restart_loop_from_beginning() {
+#if USB_MIDI_CLOCK_OUT == 1
+  midi_clock_out.requestStart();
+#endif
+  trigger_clock.restart();
   reset_retrig_fx();
   beat_num_total = 0;
   select_beat = 0;
@@ -608,8 +1070,11 @@ void restart_loop_from_beginning() {
 void clock_gpio_irq_handler(uint gpio, uint32_t events) {
   if (gpio == CLOCK_PIN && (events & GPIO_IRQ_EDGE_FALL) != 0 &&
       !clock_input_ittybittymidi) {
-    clock_event_queue.push(
-        {piko::ClockEventType::Pulse, time_us_32()});
+    if (!clock_event_queue.push(
+            {piko::ClockEventType::Pulse, time_us_32()})) {
+      PIKO_TRACE(piko::TraceEvent::QueueDrop, piko::TraceQueue::ClockEvent,
+                 clock_event_queue.drops());
+    }
   }
 }
 
@@ -637,24 +1102,30 @@ void midi_pio_irq_handler() {
         break;
     }
     if (is_clock_event) {
-      clock_event_queue.push({type, timestamp_us});
-    } else {
-      midi_byte_queue.push({byte, timestamp_us});
+      if (!clock_event_queue.push({type, timestamp_us})) {
+        PIKO_TRACE(piko::TraceEvent::QueueDrop, piko::TraceQueue::ClockEvent,
+                   clock_event_queue.drops());
+      }
+    } else if (!midi_byte_queue.push({byte, timestamp_us})) {
+      PIKO_TRACE(piko::TraceEvent::QueueDrop, piko::TraceQueue::MidiByte,
+                 midi_byte_queue.drops());
     }
   }
 }
 
-void configure_clock_capture(bool midi) {
+void configure_clock_capture(uint8_t mode) {
   const uint32_t interrupts = save_and_disable_interrupts();
   gpio_set_irq_enabled(CLOCK_PIN, GPIO_IRQ_EDGE_FALL, false);
   pio_set_irq0_source_enabled(pio1, pis_sm0_rx_fifo_not_empty, false);
   Onewiremidi_set_enabled(onewiremidi, false);
+  piko_usb_midi_clock_input_enable(false);
   clock_event_queue.clear();
   midi_byte_queue.clear();
   gpio_acknowledge_irq(CLOCK_PIN, GPIO_IRQ_EDGE_FALL);
 
-  clock_input_ittybittymidi = midi;
-  if (midi) {
+  clock_input_mode = mode;
+  clock_input_ittybittymidi = mode == CLOCK_INPUT_MIDI;
+  if (mode == CLOCK_INPUT_MIDI) {
     pio_gpio_init(pio1, CLOCK_PIN);
     pio_sm_set_consecutive_pindirs(pio1, 0, CLOCK_PIN, 1, false);
     Onewiremidi_set_enabled(onewiremidi, true);
@@ -664,33 +1135,63 @@ void configure_clock_capture(bool midi) {
     gpio_set_function(CLOCK_PIN, GPIO_FUNC_SIO);
     gpio_set_dir(CLOCK_PIN, GPIO_IN);
     gpio_pull_down(CLOCK_PIN);
-    gpio_set_irq_enabled(CLOCK_PIN, GPIO_IRQ_EDGE_FALL, true);
-    clock_sync.setSource(piko::ClockSource::Pulse, pulse_ppqn, time_us_32());
+    if (mode == CLOCK_INPUT_USB_MIDI) {
+      // The jack stays an idle input; core 1 feeds clock from the USB host.
+      piko_usb_midi_clock_input_enable(true);
+      clock_sync.setSource(piko::ClockSource::UsbMidi, pulse_ppqn,
+                           time_us_32());
+    } else {
+      gpio_set_irq_enabled(CLOCK_PIN, GPIO_IRQ_EDGE_FALL, true);
+      clock_sync.setSource(piko::ClockSource::Pulse, pulse_ppqn,
+                           time_us_32());
+    }
   }
   update_playback_rate();
   restore_interrupts(interrupts);
 }
 
+void process_clock_event(const piko::ClockEvent& event) {
+  if (event.type == piko::ClockEventType::MidiStart ||
+      event.type == piko::ClockEventType::MidiContinue) {
+    do_start_everything();
+    soft_sync = false;
+    btn_reset = false;
+  } else if (event.type == piko::ClockEventType::MidiStop) {
+    do_stop_everything();
+    soft_sync = false;
+    btn_reset = false;
+  }
+  const piko::ClockOutcome outcome = clock_sync.process(event);
+  piko_clock_capture_record(
+      {event.timestamp_us, event.type, outcome, clock_sync.state(), 0});
+  PIKO_TRACE(piko::TraceEvent::Clock,
+             static_cast<uint16_t>(event.type) |
+                 static_cast<uint16_t>(outcome) << 8,
+             event.timestamp_us);
+  if (clock_sync.consumeLoopRestart()) {
+    restart_loop_from_beginning();
+  }
+}
+
 bool service_clock_transport(uint32_t& now_us) {
-  piko::ClockEvent event{};
-  while (clock_event_queue.pop(event)) {
-    // Keep the carrier's cached time at least as new as the latest timestamp.
-    // GPIO capture can preempt PWM after its queue check but before this drain.
-    now_us = event.timestamp_us;
-    if (event.type == piko::ClockEventType::MidiStart ||
-        event.type == piko::ClockEventType::MidiContinue) {
-      do_start_everything();
-      soft_sync = false;
-      btn_reset = false;
-    } else if (event.type == piko::ClockEventType::MidiStop) {
-      do_stop_everything();
-      soft_sync = false;
-      btn_reset = false;
+  piko::ClockEvent events[8];
+  size_t count = 0;
+  while ((count = clock_event_queue.pop_n(events, 8)) > 0) {
+    for (size_t i = 0; i < count; ++i) {
+      // Keep the carrier's cached time at least as new as the latest
+      // timestamp. GPIO capture can preempt PWM after its queue check but
+      // before this drain.
+      now_us = events[i].timestamp_us;
+      process_clock_event(events[i]);
     }
-    clock_sync.process(event);
-    if (clock_sync.consumeLoopRestart()) {
-      restart_loop_from_beginning();
+  }
+  piko::ClockEvent event{};
+  while (piko_usb_midi_clock_pop(&event)) {
+    // USB timestamps are compensated backwards, so only move time forward.
+    if (static_cast<int32_t>(event.timestamp_us - now_us) > 0) {
+      now_us = event.timestamp_us;
     }
+    process_clock_event(event);
   }
   const uint32_t target = clock_sync.targetBpmX100();
   if (target != playback_target_bpm_x100) {
@@ -700,19 +1201,42 @@ bool service_clock_transport(uint32_t& now_us) {
   return clock_sync.advanceCarrier(now_us);
 }
 
+// Sheds quality in a fixed order as the governor runs out of headroom:
+// shorter head crossfades, nearest-sample grains, no lowpass, one voice.
+void apply_governor_level(DegradeLevel level) {
+  if (level == governor_level) return;
+  governor_level = level;
+  xfade_shift =
+      level >= DegradeLevel::ShortCrossfade ? HEAD_SHIFT_SHORT : HEAD_SHIFT;
+  timestretch_interp = level >= DegradeLevel::NearestGrains
+                           ? GrainInterp::Nearest
+                           : timestretch_interp_set;
+  governor_filter_bypass = level >= DegradeLevel::FilterBypass;
+  timestretch_single_grain = level >= DegradeLevel::FewerVoices;
+  if (timestretch_single_grain) {
+    phase_xfade = 0;
+  } else if (phase_xfade > (1u << xfade_shift)) {
+    phase_xfade = 1u << xfade_shift;
+  }
+}
+
 /*
  * PWM INTERRUPT LOGIC (main audio thread)
  */
-void pwm_interrupt_handler() {
-  pwm_clear_irq(pwm_gpio_to_slice_num(AUDIO_PIN));
-
+void render_carrier() {
   static uint16_t timing_check_divider = 0;
   static uint32_t cached_now_us = 0;
-  if (++timing_check_divider >= 1024u || !clock_event_queue.empty()) {
+  if (++timing_check_divider >= 1024u || !clock_event_queue.empty() ||
+      piko_usb_midi_clock_pending()) {
     timing_check_divider = 0;
     cached_now_us = time_us_32();
   }
   const bool transport_beat = service_clock_transport(cached_now_us);
+  service_delay_arena();
+#if USB_MIDI_CLOCK_OUT == 1
+  service_midi_clock_out();
+#endif
+  service_trigger_out();
 
   // Match the legacy external-clock pause: after two missing expected pulses,
   // hold the current sample position and mute until capture resumes. Clock
@@ -723,6 +1247,7 @@ void pwm_interrupt_handler() {
   }
 
   if (piko_audio_bank_mutating() || piko_audio_sample_count() == 0) {
+    render_cache.setSignature(0);
     if (transport_beat) {
       ++beat_num_total;
       beat_onset = true;
@@ -769,18 +1294,25 @@ void pwm_interrupt_handler() {
     if (soft_sync) {
       printf("softsync\n");
     }
+#endif
+#if TRACE_ENABLED == 1
+    const uint16_t beat_sources =
+        (transport_beat ? piko::kTraceBeatTransport : 0) |
+        (btn_reset ? piko::kTraceBeatReset : 0) |
+        (soft_sync ? piko::kTraceBeatSoftSync : 0);
 #endif
     soft_sync = false;
     beat_num_total++;
+    PIKO_TRACE(piko::TraceEvent::BeatOnset, beat_sources, beat_num_total);
     beat_onset = true;
     beat_led = 1 - beat_led;
+    if (render_cache_stable_beats < 0xffffu) ++render_cache_stable_beats;
     noise_gate_val = 0;
     if (btn_reset) {
       beat_led = 1;
       beat_num_total = 0;
     }
     gpio_put(LED_PIN, beat_led);
-    output_trigger.Trigger();
 
     if (do_mute_debounce > 0) {
       do_mute_debounce--;
@@ -872,6 +1404,7 @@ void pwm_interrupt_handler() {
         uint8_t r2 = randint(0, 100);
         uint8_t r3 = randint(0, 100);
         uint8_t r4 = randint(0, 100);
+        retrig_reverse = randint(0, 100) < 20;
         retrig_count = 0;
         // retrig_sel = randint(0, 11);
         // if (retrig_sel == 4) {
@@ -937,6 +1470,8 @@ void pwm_interrupt_handler() {
         playback_phase_q32 =
             (1ull << 32u) - playback_effective_increment_q32;
         phase_retrig = (retrig_len(retrig_sel) << flag_half_time) - 1;
+        PIKO_TRACE(piko::TraceEvent::RetrigStart, retrig_sel | retrig_max << 8,
+                   retrig_len(retrig_sel) << flag_half_time);
       }
     }
   }
@@ -948,7 +1483,7 @@ void pwm_interrupt_handler() {
 
   // Fractional source-frame scheduling. At unity this is exactly 24 kHz on
   // average even though 24 kHz is not an integer divisor of the PWM carrier.
-  playback_phase_q32 += playback_effective_increment_q32;
+  playback_phase_q32 += playback_slaved_increment_q32;
   const bool audio_tick = playback_phase_q32 >= (1ull << 32u);
   if (audio_tick) playback_phase_q32 -= 1ull << 32u;
   if (!audio_tick && !beat_onset) {
@@ -1066,14 +1601,19 @@ void pwm_interrupt_handler() {
         printf("select_beat:%d for %d samples\n", select_beat,
                retrig_len(retrig_sel) << flag_half_time);
 #endif
-        piko_usb_midi_note_on(midi_notes_set[(select_beat % 8)], 127);
+        emit_transport_output(
+            {TransportOutput::Kind::NoteOn, midi_notes_set[(select_beat % 8)],
+             127, frames_to_us(sample_frames_per_slice << flag_half_time)});
 
         if (do_switch_heads) {
           phase_head = 1 - phase_head;  // switch heads
-          phase_xfade = 1 << HEAD_SHIFT;
+          phase_xfade = timestretch_single_grain ? 0 : 1u << xfade_shift;
         }
         phase_sample[phase_head] =
             select_beat * (sample_frames_per_slice << flag_half_time);
+        PIKO_TRACE(piko::TraceEvent::HeadSwitch, phase_head,
+                   phase_sample[phase_head]);
+        varispeed.restart();
 
         // random direction for the new head
         if (probability_direction > 0) {
@@ -1104,6 +1644,8 @@ void pwm_interrupt_handler() {
             }
           }
         }
+        varispeed.advance();
+        update_slaved_increment();
         for (uint8_t i = 0; i < 2; i++) {
           if (direction[i]) {
             phase_sample[i]++;
@@ -1133,8 +1675,11 @@ void pwm_interrupt_handler() {
             retrig_filter--;
           }
 
-          piko_usb_midi_note_on(midi_notes_set[(select_beat % 8)],
-                                120 * retrig_count / retrig_max);
+          emit_transport_output(
+              {TransportOutput::Kind::NoteOn,
+               midi_notes_set[(select_beat % 8)],
+               static_cast<uint8_t>(120 * retrig_count / retrig_max),
+               frames_to_us(retrig_len(retrig_sel) << flag_half_time)});
 
           // printf("retrig_volume_reduce_change: %d\n",
           //        retrig_volume_reduce_change);
@@ -1158,13 +1703,6 @@ void pwm_interrupt_handler() {
               retrig_volume_reduce++;
             }
           }
-          if (retrig_pitch_up) {
-            retrig_pitch_change++;
-            update_playback_rate();
-          } else if (retrig_pitch_down) {
-            retrig_pitch_change--;
-            update_playback_rate();
-          }
           if (retrig_count >= retrig_max) {
             reset_retrig_fx();
           }
@@ -1179,15 +1717,42 @@ void pwm_interrupt_handler() {
 #endif
           // setup
           phase_head = 1 - phase_head;  // switch heads
-          phase_xfade = 1 << HEAD_SHIFT;
+          phase_xfade = timestretch_single_grain ? 0 : 1u << xfade_shift;
           phase_sample[phase_head] =
               select_beat * (sample_frames_per_slice << flag_half_time);
+          PIKO_TRACE(piko::TraceEvent::HeadSwitch, phase_head | 0x100u,
+                     phase_sample[phase_head]);
           phase_retrig = 0;
+          advance_beat_repeat(retrig_len(retrig_sel) << flag_half_time);
         }
       }
     }
   }
 
+  if (beat_repeat.active()) {
+    audio_now = apply_retrig_envelope(beat_repeat.next());
+    set_audio_pwm_level(audio_now);
+    return;
+  }
+
+  // A capturing retrigger renders its first pass without the retrigger
+  // envelope, captures that, and applies the envelope to what it plays, the
+  // same as every replay.
+  const uint8_t retrig_shift = retrig_capturing ? 0 : retrig_volume_reduce;
+  const uint8_t retrig_cut =
+      retrig_capturing ? 0 : retrig_filter * retrig_filter_change;
+
+  const bool render_cacheable = audio_tick && update_render_cache();
+  const uint32_t render_frame = phase_sample[phase_head];
+  RenderCacheEntry cached{};
+  if (render_cacheable && render_cache.lookup(render_frame, cached)) {
+    restore_lpf_history(cached, retrig_cut);
+    audio_now = cached.output;
+    beat_repeat.capture(audio_now);
+    set_audio_pwm_level(audio_now);
+    return;
+  }
+
   // determine sample
   if (timestretch_active) {
     audio_now = timestretch_audio_now;
@@ -1199,14 +1764,14 @@ void pwm_interrupt_handler() {
 
       // new head
       uint32_t u = (uint32_t)raw_val(sample, phase_sample[phase_head]);
-      u = u * ((1 << HEAD_SHIFT) - phase_xfade);  // fade it in
+      u = u * ((1u << xfade_shift) - phase_xfade);  // fade it in
 
       // old head
       uint32_t v = (uint32_t)raw_val(sample, phase_sample[1 - phase_head]);
       v = v * phase_xfade;  // fade it out
 
       // combine
-      u = (u + v) >> HEAD_SHIFT;
+      u = (u + v) >> xfade_shift;
 
       // set to audio now
       audio_now = (uint8_t)u;
@@ -1247,16 +1812,16 @@ void pwm_interrupt_handler() {
           if (audio_now > 128) audio_now = 128;
         }
       }
-      if ((volume_mod + retrig_volume_reduce + noise_gate_fade) > 0 &&
+      if ((volume_mod + retrig_shift + noise_gate_fade) > 0 &&
           audio_now != 128) {
         if (audio_now > 128) {
           audio_now = ((audio_now - 128) >>
-                       (volume_mod + retrig_volume_reduce + noise_gate_fade)) +
+                       (volume_mod + retrig_shift + noise_gate_fade)) +
                       128;
         } else {
           audio_now =
               128 - ((128 - audio_now) >>
-                     (volume_mod + retrig_volume_reduce + noise_gate_fade));
+                     (volume_mod + retrig_shift + noise_gate_fade));
         }
       }
     }  // </volume>
@@ -1272,11 +1837,10 @@ void pwm_interrupt_handler() {
     // </bitcrush>
 
     // <filter>
-    if ((filter_fc - (retrig_filter * retrig_filter_change) - button_filter) <=
-        LPF_MAX) {
+    const uint8_t filter_input = audio_now;
+    if (lpf_active(retrig_cut)) {
       audio_now = (uint8_t)filter_lpf(
-          (int64_t)audio_now,
-          (filter_fc - (retrig_filter * retrig_filter_change) - button_filter),
+          (int64_t)audio_now, (filter_fc - retrig_cut - button_filter),
           filter_q);
       // } else {
       // audio_now = (uint8_t)filter_lpf((int64_t)audio_now, LPF_MAX, filter_q);
@@ -1284,12 +1848,21 @@ void pwm_interrupt_handler() {
     // </filter>
 
     // <delay>
-    // audio_now = delay.Update(audio_now);
+    if (delay_division > 0) {
+      audio_now = delay.Update(audio_now, audio_tick);
+    }
     // </delay>
 
     // <dither>
     // audio_now = ditherer.Update(audio_now);
     // </dither>
+  if (render_cacheable) {
+    render_cache.store(render_frame, {filter_input, audio_now,
+                                      static_cast<int16_t>(y1_f)});
+  }
+  const uint8_t audio_dry = audio_now;
+  if (retrig_capturing) audio_now = apply_retrig_envelope(audio_dry);
+  if (audio_tick) beat_repeat.capture(audio_dry);
   set_audio_pwm_level(audio_now);
 }
 
@@ -1305,6 +1878,10 @@ void print_buf(const uint8_t *buf, size_t len) {
 
 void do_stop_everything() { do_mute = true; }
 void do_start_everything() {
+#if USB_MIDI_CLOCK_OUT == 1
+  midi_clock_out.requestStart();
+#endif
+  trigger_clock.restart();
   do_mute_debounce = 8;
   button_on = NUM_BUTTONS;
   button_on2 = NUM_BUTTONS;
@@ -1314,16 +1891,77 @@ void do_start_everything() {
   retrig_filter = 0;
   retrig_pitch_up = false;
   retrig_pitch_down = false;
-  retrig_pitch_change = 0;
   retrig_volume_reduce = 0;
   retrig_volume_reduce_change = 0;
   button_filter_on = false;
   fx_retrig = false;
   btn_retrig = false;
+  retrig_reverse = false;
+  retrig_capturing = false;
+  retrig_rate_q8 = BeatRepeat<kBeatRepeatFrames>::kRateOne;
+  beat_repeat.stop();
   do_mute = false;
   update_playback_rate();
 }
 
+// The control loop runs one pass per MAIN_LOOP_PERIOD_US. Between passes
+// core 0 sleeps with SLEEPONEXIT set, so the PWM and other interrupts run
+// and go straight back to sleep without resuming the loop. Only this timer
+// clears the bit and lets the loop run.
+volatile bool control_pass_due = false;
+repeating_timer_t control_pass_timer;
+
+bool control_pass_timer_callback(repeating_timer_t *timer) {
+  (void)timer;
+  control_pass_due = true;
+  scb_hw->scr &= ~M0PLUS_SCR_SLEEPONEXIT_BITS;
+  return true;
+}
+
+void wait_for_control_pass() {
+  while (!control_pass_due) {
+    // Masked so the timer cannot clear the bit between this read and write.
+    const uint32_t interrupts = save_and_disable_interrupts();
+    if (!control_pass_due) scb_hw->scr |= M0PLUS_SCR_SLEEPONEXIT_BITS;
+    restore_interrupts(interrupts);
+    if (!control_pass_due) __wfi();
+  }
+  control_pass_due = false;
+}
+
+#if RENDER_PIPELINE == 1
+void pwm_interrupt_handler() {
+  pwm_clear_irq(pwm_gpio_to_slice_num(AUDIO_PIN));
+  render_pipeline.pop(output_level, send_transport_output);
+  if (render_pipeline.size() <= kRenderRefillDepth) {
+    irq_set_pending(render_irq);
+  }
+  output_audio_level(output_level);
+}
+
+// Renders until the ring is full. The governor sees each tick's cycles as
+// before; they include any PWM IRQ that preempted the tick, which is small.
+void render_irq_handler() {
+  while (!render_pipeline.full()) {
+    const uint32_t start = systick_hw->cvr;
+    render_carrier();
+    render_pipeline.push(rendered_level);
+    const uint32_t used = (start - systick_hw->cvr) & 0x00ffffffu;
+    apply_governor_level(isr_governor.update(used));
+  }
+}
+#else
+void pwm_interrupt_handler() {
+  // SysTick counts down from 2^24 at clk_sys; the IRQ is far shorter than a
+  // wrap, so a masked difference is the cycles spent rendering.
+  const uint32_t start = systick_hw->cvr;
+  pwm_clear_irq(pwm_gpio_to_slice_num(AUDIO_PIN));
+  render_carrier();
+  const uint32_t used = (start - systick_hw->cvr) & 0x00ffffffu;
+  apply_governor_level(isr_governor.update(used));
+}
+#endif
+
 uint32_t current_time() { return to_ms_since_boot(get_absolute_time()); }
 
 uint16_t *sort_int32_t(uint32_t array[], int n) {
@@ -1359,12 +1997,7 @@ void midi_note_off(uint8_t note) {
   printf("note_off: %d\n", note);
 #endif
 #if MIDI_NOTE_KEY == 1
-  input_button[note % NUM_BUTTONS].Set(false);
-  if (midi_button2 > -1) {
-    midi_button2 = -1;
-  } else {
-    midi_button1 = -1;
-  }
+  midi_button_release(note % NUM_BUTTONS);
 #endif
 }
 
@@ -1373,17 +2006,15 @@ void midi_note_on(uint8_t note, uint8_t velocity) {
   printf("note_on: %d\n", note);
 #endif
 #if MIDI_NOTE_KEY == 1
-  if (midi_button1 > -1) {
-    midi_button2 = note % NUM_BUTTONS;
-  } else {
-    midi_button1 = note % NUM_BUTTONS;
-  }
-  input_button[note % NUM_BUTTONS].Set(true);
+  midi_button_press(note % NUM_BUTTONS);
+#else
+  // notes transpose the grain engine relative to middle C
+  param_set_pitch(static_cast<int8_t>(static_cast<int16_t>(note) - 60));
 #endif
 }
 
-bool piko_clock_input_ittybittymidi() {
-  return clock_input_ittybittymidi;
+uint8_t piko_clock_input_mode() {
+  return clock_input_mode;
 }
 
 uint8_t piko_pulse_ppqn() { return pulse_ppqn; }
@@ -1410,6 +2041,15 @@ int main(void) {
   pwm_clear_irq(audio_pin_slice);
   irq_set_priority(PWM_IRQ_WRAP, 0x40);
   irq_set_exclusive_handler(PWM_IRQ_WRAP, pwm_interrupt_handler);
+#if RENDER_PIPELINE == 1
+  render_irq = static_cast<uint>(user_irq_claim_unused(true));
+  irq_set_priority(render_irq, 0xc0);
+  irq_set_exclusive_handler(render_irq, render_irq_handler);
+#endif
+  // free-running SysTick on clk_sys for the isr budget governor
+  systick_hw->rvr = 0x00ffffffu;
+  systick_hw->cvr = 0;
+  systick_hw->csr = M0PLUS_SYST_CSR_CLKSOURCE_BITS | M0PLUS_SYST_CSR_ENABLE_BITS;
   pwm_set_irq_enabled(audio_pin_slice, false);
   irq_set_enabled(PWM_IRQ_WRAP, false);
   pwm_config config = pwm_get_default_config();
@@ -1419,6 +2059,7 @@ int main(void) {
   pwm_set_gpio_level(AUDIO_PIN, 0);
   pwm_carrier_hz = clock_get_hz(clk_sys) / (kPwmWrap + 1u);
   clock_sync.setCarrierHz(pwm_carrier_hz);
+  trigger_clock.setCarrierHz(pwm_carrier_hz);
 
   if (piko_audio_sample_count() > 0) refresh_sample_timing(0);
   param_set_bpm(BPM_SAMPLED);
@@ -1464,9 +2105,13 @@ int main(void) {
   save_data[SAVE_GATE + 1] = (uint8_t)noise_gate_thresh;
   save_data[SAVE_CLOCK_INPUT_MODE] = CLOCK_INPUT_CLOCK;
   save_data[SAVE_PULSE_PPQN] = 2;
+  save_data[SAVE_TRIGGER_PPQN] = 2;
+  save_data[SAVE_TRIGGER_DIVISION] = 1;
+  save_data[SAVE_TRIGGER_WIDTH_MS] = trigger_width_ms;
+  save_data[SAVE_GRAIN_INTERP] = static_cast<uint8_t>(GrainInterp::Linear) + 1u;
 
   // initializer trigger
-  output_trigger.Init(TRIGO_PIN, 10, MAIN_LOOP_HZ);
+  output_trigger.Init(TRIGO_PIN, trigger_width_ms);
 
   // initialize control loop variables
   uint32_t clock_ms = 0;
@@ -1501,8 +2146,16 @@ int main(void) {
     print_buf(save_data, FLASH_PAGE_SIZE);
 #endif
     uint32_t ints = save_and_disable_interrupts();
+    PIKO_TRACE(piko::TraceEvent::FlashBegin, piko::TraceFlashOp::Erase,
+               PIKO_SETTINGS_FLASH_OFFSET);
     flash_range_erase(PIKO_SETTINGS_FLASH_OFFSET, FLASH_SECTOR_SIZE);
+    PIKO_TRACE(piko::TraceEvent::FlashEnd, piko::TraceFlashOp::Erase,
+               PIKO_SETTINGS_FLASH_OFFSET);
+    PIKO_TRACE(piko::TraceEvent::FlashBegin, piko::TraceFlashOp::Program,
+               PIKO_SETTINGS_FLASH_OFFSET);
     flash_range_program(PIKO_SETTINGS_FLASH_OFFSET, save_data, FLASH_PAGE_SIZE);
+    PIKO_TRACE(piko::TraceEvent::FlashEnd, piko::TraceFlashOp::Program,
+               PIKO_SETTINGS_FLASH_OFFSET);
     restore_interrupts(ints);
   };
 
@@ -1517,7 +2170,7 @@ int main(void) {
                                      clock_gpio_irq_handler);
   irq_set_priority(IO_IRQ_BANK0, 0x00);
   irq_set_enabled(IO_IRQ_BANK0, true);
-  configure_clock_capture(false);
+  configure_clock_capture(CLOCK_INPUT_CLOCK);
 
 // LED
 #if WS2812_ENABLED == 1
@@ -1535,19 +2188,33 @@ int main(void) {
 
   piko_sample_manager_set_ready();
   pwm_clear_irq(audio_pin_slice);
+#if RENDER_PIPELINE == 1
+  irq_set_enabled(render_irq, true);
+  irq_set_pending(render_irq);
+#endif
   pwm_set_irq_enabled(audio_pin_slice, true);
   irq_set_enabled(PWM_IRQ_WRAP, true);
+  // Negative: the period runs start to start, so pass length does not drift.
+  add_repeating_timer_us(-MAIN_LOOP_PERIOD_US, control_pass_timer_callback,
+                         nullptr, &control_pass_timer);
 
   // control loop
   while (1) {
-    __wfi();  // Wait for Interrupt
+    wait_for_control_pass();
     clock_ms++;
-
-    MidiByteEvent midi_byte{};
-    while (midi_byte_queue.pop(midi_byte)) {
-      Onewiremidi_receive_byte(onewiremidi, midi_byte.byte,
-                               midi_byte.timestamp_us);
+    piko_doorbell_count_wakeup();
+
+    MidiByteEvent midi_bytes[16];
+    size_t midi_count = 0;
+    while ((midi_count = midi_byte_queue.pop_n(midi_bytes, 16)) > 0) {
+      for (size_t i = 0; i < midi_count; ++i) {
+        Onewiremidi_receive_byte(onewiremidi, midi_bytes[i].byte,
+                                 midi_bytes[i].timestamp_us);
+      }
     }
+#if USB_MIDI_IN == 1
+    service_usb_midi_input();
+#endif
 #if WS2812_ENABLED == 1
     if (clock_ms % 200 == 0) {
       const uint8_t knob_a_led =
@@ -1568,15 +2235,17 @@ int main(void) {
     if (debounce_sample > 0) {
       debounce_sample--;
     }
+    // Core 1 rings after every request, so the queue is only read then.
+    const bool doorbell = piko_doorbell_take() > 0;
     PikoRequest request{};
-    while (piko_runtime_pop_request(&request)) {
+    while (doorbell && piko_runtime_pop_request(&request)) {
       bool ok = true;
       switch (request.type) {
         case PikoRequestType::SetClockMode:
-          if (request.value > 1) {
+          if (request.value > CLOCK_INPUT_USB_MIDI) {
             ok = false;
           } else {
-            configure_clock_capture(request.value == CLOCK_INPUT_MIDI);
+            configure_clock_capture(request.value);
             save_data[SAVE_CLOCK_INPUT_MODE] = request.value;
             save_settings();
           }
@@ -1593,6 +2262,76 @@ int main(void) {
             save_settings();
           }
           break;
+        case PikoRequestType::SetClockFilter:
+          if (request.value != 0 &&
+              !piko::ClockSync::validPllShift(request.value)) {
+            ok = false;
+          } else {
+            param_set_clock_filter(request.value);
+            save_data[SAVE_CLOCK_FILTER] = request.value;
+            save_settings();
+          }
+          break;
+        case PikoRequestType::SetOutputOffset: {
+          const int16_t offset_us = static_cast<int16_t>(request.value);
+          if (!piko::ClockSync::validOutputOffsetUs(offset_us)) {
+            ok = false;
+          } else {
+            param_set_output_offset(offset_us);
+            save_data[SAVE_OUTPUT_OFFSET] = (uint8_t)(offset_us >> 8);
+            save_data[SAVE_OUTPUT_OFFSET + 1] = (uint8_t)offset_us;
+            save_settings();
+          }
+          break;
+        }
+        case PikoRequestType::SetSlavedPlayback:
+          if (request.value > 1) {
+            ok = false;
+          } else {
+            param_set_slaved_playback(request.value == 1);
+            save_data[SAVE_SLAVED_PLAYBACK] = request.value;
+            save_settings();
+          }
+          break;
+        case PikoRequestType::SetFlywheel:
+          if (!piko::ClockSync::validFlywheelMs(request.value)) {
+            ok = false;
+          } else {
+            param_set_flywheel(request.value);
+            save_data[SAVE_FLYWHEEL_MS] = (uint8_t)(request.value >> 8);
+            save_data[SAVE_FLYWHEEL_MS + 1] = (uint8_t)request.value;
+            save_settings();
+          }
+          break;
+        case PikoRequestType::SetTriggerOut: {
+          const uint8_t ppqn = request.value & 0xffu;
+          const uint8_t division = (request.value >> 8u) & 0xffu;
+          const uint8_t width_ms = (request.value >> 16u) & 0xffu;
+          if (!TriggerClock::validPpqn(ppqn) ||
+              !TriggerClock::validDivision(division) ||
+              !TriggerClock::validPulseWidthMs(width_ms)) {
+            ok = false;
+          } else {
+            param_set_trigger_out(ppqn, division, width_ms);
+            save_data[SAVE_TRIGGER_PPQN] = ppqn;
+            save_data[SAVE_TRIGGER_DIVISION] = division;
+            save_data[SAVE_TRIGGER_WIDTH_MS] = width_ms;
+            save_settings();
+          }
+          break;
+        }
+        case PikoRequestType::SetGrainInterp:
+          if (!validGrainInterp(request.value)) {
+            ok = false;
+          } else {
+            param_set_grain_interp(static_cast<GrainInterp>(request.value));
+            save_data[SAVE_GRAIN_INTERP] = request.value + 1u;
+            save_settings();
+          }
+          break;
+        case PikoRequestType::ResetClockStatistics:
+          clock_statistics_reset();
+          break;
         case PikoRequestType::StopPlayback:
           do_stop_everything();
           break;
@@ -1600,16 +2339,67 @@ int main(void) {
           do_start_everything();
           break;
       }
-      piko_runtime_ack_request(request.id, ok);
+      piko_runtime_complete_request(request.id, ok);
     }
 
     if (clock_ms % 1000u == 0) {
       const uint32_t interrupts = save_and_disable_interrupts();
       const piko::ClockDiagnostics clock_diagnostics = clock_sync.diagnostics();
+      const uint32_t trigger_skipped = trigger_clock.skipped();
+      const uint8_t trigger_ppqn = trigger_clock.ppqn();
+      const uint8_t trigger_division = trigger_clock.division();
       restore_interrupts(interrupts);
       piko_publish_clock_snapshot({
-          clock_diagnostics, clock_event_queue.drops(),
-          midi_byte_queue.drops() + piko_usb_midi_queue_drops()});
+          clock_diagnostics,
+          clock_event_queue.drops() + piko_usb_midi_clock_drops(),
+          midi_byte_queue.drops() + piko_usb_midi_queue_drops(),
+          output_trigger.Stats(), trigger_skipped, trigger_ppqn,
+          trigger_division, trigger_width_ms});
+      PikoEngineSnapshot engine{};
+      engine.render_cache_hits = render_cache.hits();
+      engine.render_cache_misses = render_cache.misses();
+      engine.render_cache_invalidations = render_cache.invalidations();
+      engine.governor_level = static_cast<uint32_t>(governor_level);
+      engine.grain_interp = static_cast<uint32_t>(timestretch_interp_set);
+      for (uint8_t i = 0; i < IsrGovernor::kLevels; ++i) {
+        engine.governor_entries[i] =
+            isr_governor.entries(static_cast<DegradeLevel>(i));
+      }
+      engine.isr_peak_cycles = isr_governor.peakCycles();
+      engine.isr_budget_cycles = isr_governor.budget();
+      engine.isr_overruns = isr_governor.overruns();
+      engine.delay_clamps = delay.Clamps();
+      engine.slaved_playback = slaved_playback ? 1u : 0u;
+      engine.slave_error_frames = varispeed.errorFrames();
+      engine.slave_max_error_frames = varispeed.maxErrorFrames();
+#if USB_MIDI_IN == 1
+      engine.midi_in_events = usb_midi_in_events;
+      engine.midi_in_drops = piko_usb_midi_input_drops();
+      engine.midi_in_latency_us = usb_midi_in_latency_us;
+      engine.midi_in_max_latency_us = usb_midi_in_max_latency_us;
+#endif
+      engine.core0_doorbell = piko_doorbell_stats();
+#if RENDER_PIPELINE == 1
+      engine.render_pipeline = 1;
+      const uint32_t render_interrupts = save_and_disable_interrupts();
+      engine.render_underruns = render_pipeline.underruns();
+      engine.render_min_depth = render_pipeline.takeMinDepth();
+      restore_interrupts(render_interrupts);
+      engine.render_depth = static_cast<uint32_t>(render_pipeline.size());
+      engine.render_output_drops = render_pipeline.drops();
+#endif
+#if QUEUE_TELEMETRY == 1
+      piko_runtime_queue_telemetry(engine.queues);
+      const uint32_t queue_interrupts = save_and_disable_interrupts();
+      engine.queues[static_cast<uint32_t>(piko::TraceQueue::ClockEvent)] = {
+          static_cast<uint32_t>(clock_event_queue.capacity()),
+          clock_event_queue.drops(), clock_event_queue.stats()};
+      engine.queues[static_cast<uint32_t>(piko::TraceQueue::MidiByte)] = {
+          static_cast<uint32_t>(midi_byte_queue.capacity()),
+          midi_byte_queue.drops(), midi_byte_queue.stats()};
+      restore_interrupts(queue_interrupts);
+#endif
+      piko_publish_engine_snapshot(engine);
     }
     // flash works
     if (debounce_saving > 0 && clock_ms > 64000) {
@@ -1671,16 +2461,60 @@ int main(void) {
         probability_retrig = save_data[SAVE_PROB_RETRIG];
         probability_gate = save_data[SAVE_PROB_GATE];
         probability_tunnel = save_data[SAVE_PROB_TUNNEL];
-        clock_input_ittybittymidi =
-            save_data[SAVE_CLOCK_INPUT_MODE] == CLOCK_INPUT_MIDI;
-        save_data[SAVE_CLOCK_INPUT_MODE] =
-            clock_input_ittybittymidi ? CLOCK_INPUT_MIDI : CLOCK_INPUT_CLOCK;
+        if (save_data[SAVE_CLOCK_INPUT_MODE] > CLOCK_INPUT_USB_MIDI) {
+          save_data[SAVE_CLOCK_INPUT_MODE] = CLOCK_INPUT_CLOCK;
+        }
         pulse_ppqn = piko::ClockSync::validPulsePpqn(
                          save_data[SAVE_PULSE_PPQN])
                          ? save_data[SAVE_PULSE_PPQN]
                          : 2;
         save_data[SAVE_PULSE_PPQN] = pulse_ppqn;
-        configure_clock_capture(clock_input_ittybittymidi);
+        configure_clock_capture(save_data[SAVE_CLOCK_INPUT_MODE]);
+        param_set_delay(save_data[SAVE_DELAY]);
+        save_data[SAVE_DELAY] = delay_division;
+        if (!piko::ClockSync::validPllShift(save_data[SAVE_CLOCK_FILTER])) {
+          save_data[SAVE_CLOCK_FILTER] = 0;
+        }
+        param_set_clock_filter(save_data[SAVE_CLOCK_FILTER]);
+        int16_t output_offset_us =
+            (int16_t)((save_data[SAVE_OUTPUT_OFFSET] << 8) +
+                      save_data[SAVE_OUTPUT_OFFSET + 1]);
+        if (!piko::ClockSync::validOutputOffsetUs(output_offset_us)) {
+          output_offset_us = 0;
+          save_data[SAVE_OUTPUT_OFFSET] = 0;
+          save_data[SAVE_OUTPUT_OFFSET + 1] = 0;
+        }
+        param_set_output_offset(output_offset_us);
+        if (save_data[SAVE_SLAVED_PLAYBACK] > 1) {
+          save_data[SAVE_SLAVED_PLAYBACK] = 0;
+        }
+        param_set_slaved_playback(save_data[SAVE_SLAVED_PLAYBACK] == 1);
+        uint16_t flywheel_ms = (save_data[SAVE_FLYWHEEL_MS] << 8) +
+                               save_data[SAVE_FLYWHEEL_MS + 1];
+        if (!piko::ClockSync::validFlywheelMs(flywheel_ms)) {
+          flywheel_ms = 0;
+          save_data[SAVE_FLYWHEEL_MS] = 0;
+          save_data[SAVE_FLYWHEEL_MS + 1] = 0;
+        }
+        param_set_flywheel(flywheel_ms);
+        if (!TriggerClock::validPpqn(save_data[SAVE_TRIGGER_PPQN]) ||
+            !TriggerClock::validDivision(save_data[SAVE_TRIGGER_DIVISION]) ||
+            !TriggerClock::validPulseWidthMs(
+                save_data[SAVE_TRIGGER_WIDTH_MS])) {
+          save_data[SAVE_TRIGGER_PPQN] = 2;
+          save_data[SAVE_TRIGGER_DIVISION] = 1;
+          save_data[SAVE_TRIGGER_WIDTH_MS] = 10;
+        }
+        param_set_trigger_out(save_data[SAVE_TRIGGER_PPQN],
+                              save_data[SAVE_TRIGGER_DIVISION],
+                              save_data[SAVE_TRIGGER_WIDTH_MS]);
+        if (save_data[SAVE_GRAIN_INTERP] == 0 ||
+            !validGrainInterp(save_data[SAVE_GRAIN_INTERP] - 1u)) {
+          save_data[SAVE_GRAIN_INTERP] =
+              static_cast<uint8_t>(GrainInterp::Linear) + 1u;
+        }
+        param_set_grain_interp(
+            static_cast<GrainInterp>(save_data[SAVE_GRAIN_INTERP] - 1u));
         sequencer.Load(save_data);
 #ifdef DEBUG_SAVE
         printf("volume_reduce: %d\n", volume_reduce);
@@ -1729,6 +2563,17 @@ int main(void) {
                             save_data);
           }
         }
+        if (input_button[2].ChangedHigh(true) ||
+            input_button[3].ChangedHigh(true) ||
+            input_button[4].ChangedHigh(true) ||
+            input_button[5].ChangedHigh(true)) {
+          if (input_button[2].On() && input_button[3].On() &&
+              input_button[4].On() && input_button[5].On()) {
+            // cycle delay time
+            param_set_delay(delay_division + 1);
+            save_data[SAVE_DELAY] = delay_division;
+          }
+        }
         if (input_button[0].ChangedHigh(true) ||
             input_button[3].ChangedHigh(true) ||
             input_button[4].ChangedHigh(true) ||
@@ -1908,8 +2753,12 @@ int main(void) {
                                   probability_tunnel, save_data);
                   break;
                 case 1:
-                  // stretch
-                  set_timestretch_knob(input_knob[i].Value());
+                  // stretch, or pitch while a button is held
+                  if (button_on < NUM_BUTTONS) {
+                    param_set_pitch(pitch_from_knob(input_knob[i].Value()));
+                  } else {
+                    set_timestretch_knob(input_knob[i].Value());
+                  }
                   break;
                 case 2:
                   // gate probability
@@ -1993,9 +2842,6 @@ int main(void) {
       // adc reading end
     }
 
-    // trig out
-    output_trigger.Update();
-
     if (ledarray_binary_debounce > 0) {
       ledarray_binary_debounce--;
       ledarray.SetBinary(ledarray_binary);
@@ -2021,8 +2867,5 @@ int main(void) {
       }
     }
     ledarray.Update();
-
-    // sleep this thread
-    sleep_us(MAIN_LOOP_DELAY);
   }
 }
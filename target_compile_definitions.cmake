@@ -8,5 +8,10 @@ target_compile_definitions(${PIKOCODE_TARGET} PRIVATE
     MIDI_RESET_EVERY_BEAT=16
     MIDI_CLOCK_MULTIPLIER=2
     MIDI_NOTE_KEY=0
+    USB_MIDI_CLOCK_OUT=0
+    USB_MIDI_IN=1
+    RENDER_PIPELINE=0
+    TRACE_ENABLED=0
+    QUEUE_TELEMETRY=0
     PCB_V2_LAYOUT=0
 )
@@ -0,0 +1,262 @@
+// Replays a clock capture downloaded with the 'K' command through ClockSync
+// and prints tempo, phase-error and state traces as CSV.
+//
+//   clock_replay capture.bin [--ppqn 1|2|4] [--carrier-hz N] [--states]
+//                [--filter median|pll] [--pll-shift N]
+//                [--output-offset-us N] [--flywheel-ms N]
+//
+// The file holds the reply exactly as sent: u32 payload length, u32 version,
+// u32 records written, u32 record count, u32 device time, then 8-byte
+// ClockCaptureRecord entries. Version 2 inserts the device's pulse PPQN,
+// filter mode, PLL shift, output offset and flywheel limit before the
+// records; the replay uses them unless overridden on the command line, and
+// version 1 captures fall back to the defaults. The source is MIDI when the
+// capture contains any MIDI event and pulse input otherwise.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <optional>
+#include <vector>
+
+#include "ClockSync.h"
+
+using piko::ClockCaptureRecord;
+using piko::ClockEventType;
+using piko::ClockFilterMode;
+using piko::ClockOutcome;
+using piko::ClockSource;
+using piko::ClockState;
+using piko::ClockSync;
+
+namespace {
+
+constexpr uint32_t kCaptureVersion = 2u;
+constexpr uint32_t kDefaultCarrierHz = 121093u;  // 248 MHz / 2048
+
+struct ClockSettings {
+  uint8_t ppqn = 2;
+  ClockFilterMode filter_mode = ClockFilterMode::Median;
+  uint8_t pll_shift = 2;
+  int32_t output_offset_us = 0;
+  uint32_t flywheel_ms = 0;
+};
+
+struct Capture {
+  uint32_t version = 0;
+  uint32_t written = 0;
+  uint32_t device_time_us = 0;
+  ClockSettings settings;
+  std::vector<ClockCaptureRecord> records;
+};
+
+struct Overrides {
+  std::optional<uint8_t> ppqn;
+  std::optional<ClockFilterMode> filter_mode;
+  std::optional<uint8_t> pll_shift;
+  std::optional<int32_t> output_offset_us;
+  std::optional<uint32_t> flywheel_ms;
+};
+
+uint32_t readLe32(const uint8_t* bytes) {
+  return static_cast<uint32_t>(bytes[0]) |
+         (static_cast<uint32_t>(bytes[1]) << 8u) |
+         (static_cast<uint32_t>(bytes[2]) << 16u) |
+         (static_cast<uint32_t>(bytes[3]) << 24u);
+}
+
+bool loadCapture(const char* path, Capture& capture) {
+  FILE* file = fopen(path, "rb");
+  if (file == nullptr) {
+    fprintf(stderr, "clock_replay: cannot open %s\n", path);
+    return false;
+  }
+  std::vector<uint8_t> bytes;
+  uint8_t buffer[4096];
+  size_t n = 0;
+  while ((n = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+    bytes.insert(bytes.end(), buffer, buffer + n);
+  }
+  fclose(file);
+
+  if (bytes.size() < 20u) {
+    fprintf(stderr, "clock_replay: capture too short\n");
+    return false;
+  }
+  const uint32_t payload = readLe32(&bytes[0]);
+  const uint32_t version = readLe32(&bytes[4]);
+  const uint32_t count = readLe32(&bytes[12]);
+  if (version == 0 || version > kCaptureVersion) {
+    fprintf(stderr, "clock_replay: unsupported capture version %u\n",
+            version);
+    return false;
+  }
+  const uint32_t header = version >= 2u ? 36u : 16u;
+  if (payload != header + count * 8u || bytes.size() < 4u + payload) {
+    fprintf(stderr, "clock_replay: truncated capture (%u records)\n", count);
+    return false;
+  }
+  capture.version = version;
+  capture.written = readLe32(&bytes[8]);
+  capture.device_time_us = readLe32(&bytes[16]);
+  if (version >= 2u) {
+    ClockSettings& settings = capture.settings;
+    settings.ppqn = static_cast<uint8_t>(readLe32(&bytes[20]));
+    settings.filter_mode = static_cast<ClockFilterMode>(readLe32(&bytes[24]));
+    settings.pll_shift = static_cast<uint8_t>(readLe32(&bytes[28]));
+    settings.output_offset_us = static_cast<int32_t>(readLe32(&bytes[32]));
+    settings.flywheel_ms = readLe32(&bytes[36]);
+    if (!ClockSync::validPulsePpqn(settings.ppqn) ||
+        !ClockSync::validPllShift(settings.pll_shift) ||
+        !ClockSync::validOutputOffsetUs(settings.output_offset_us) ||
+        !ClockSync::validFlywheelMs(settings.flywheel_ms) ||
+        (settings.filter_mode != ClockFilterMode::Median &&
+         settings.filter_mode != ClockFilterMode::Pll)) {
+      fprintf(stderr, "clock_replay: capture has invalid clock settings\n");
+      return false;
+    }
+  }
+  capture.records.resize(count);
+  for (uint32_t i = 0; i < count; ++i) {
+    const uint8_t* record = &bytes[4u + header + i * 8u];
+    ClockCaptureRecord& r = capture.records[i];
+    r.timestamp_us = readLe32(record);
+    r.type = static_cast<ClockEventType>(record[4]);
+    r.outcome = static_cast<ClockOutcome>(record[5]);
+    r.state = static_cast<ClockState>(record[6]);
+    r.reserved = record[7];
+  }
+  return true;
+}
+
+void usage() {
+  fprintf(stderr,
+          "usage: clock_replay capture.bin [--ppqn 1|2|4] [--carrier-hz N] "
+          "[--states] [--filter median|pll] [--pll-shift N] "
+          "[--output-offset-us N] [--flywheel-ms N]\n");
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  const char* path = nullptr;
+  Overrides overrides;
+  uint32_t carrier_hz = kDefaultCarrierHz;
+  bool print_states = false;
+  bool valid = true;
+  for (int i = 1; i < argc; ++i) {
+    if (strcmp(argv[i], "--ppqn") == 0 && i + 1 < argc) {
+      overrides.ppqn = static_cast<uint8_t>(atoi(argv[++i]));
+      valid = valid && ClockSync::validPulsePpqn(*overrides.ppqn);
+    } else if (strcmp(argv[i], "--filter") == 0 && i + 1 < argc) {
+      const char* filter = argv[++i];
+      overrides.filter_mode = strcmp(filter, "pll") == 0
+                                  ? ClockFilterMode::Pll
+                                  : ClockFilterMode::Median;
+      valid = valid && (strcmp(filter, "pll") == 0 ||
+                        strcmp(filter, "median") == 0);
+    } else if (strcmp(argv[i], "--pll-shift") == 0 && i + 1 < argc) {
+      overrides.pll_shift = static_cast<uint8_t>(atoi(argv[++i]));
+      valid = valid && ClockSync::validPllShift(*overrides.pll_shift);
+    } else if (strcmp(argv[i], "--output-offset-us") == 0 && i + 1 < argc) {
+      overrides.output_offset_us = static_cast<int32_t>(atoi(argv[++i]));
+      valid = valid && ClockSync::validOutputOffsetUs(*overrides.output_offset_us);
+    } else if (strcmp(argv[i], "--flywheel-ms") == 0 && i + 1 < argc) {
+      overrides.flywheel_ms =
+          static_cast<uint32_t>(strtoul(argv[++i], nullptr, 10));
+      valid = valid && ClockSync::validFlywheelMs(*overrides.flywheel_ms);
+    } else if (strcmp(argv[i], "--carrier-hz") == 0 && i + 1 < argc) {
+      carrier_hz = static_cast<uint32_t>(strtoul(argv[++i], nullptr, 10));
+    } else if (strcmp(argv[i], "--states") == 0) {
+      print_states = true;
+    } else if (path == nullptr && argv[i][0] != '-') {
+      path = argv[i];
+    } else {
+      usage();
+      return 2;
+    }
+  }
+  if (path == nullptr || !valid || carrier_hz == 0) {
+    usage();
+    return 2;
+  }
+
+  Capture capture;
+  if (!loadCapture(path, capture)) return 1;
+  if (capture.records.empty()) {
+    fprintf(stderr, "clock_replay: capture is empty\n");
+    return 0;
+  }
+
+  ClockSource source = ClockSource::Pulse;
+  for (const ClockCaptureRecord& r : capture.records) {
+    if (r.type != ClockEventType::Pulse) source = ClockSource::Midi;
+  }
+
+  ClockSettings settings = capture.settings;
+  settings.ppqn = overrides.ppqn.value_or(settings.ppqn);
+  settings.filter_mode = overrides.filter_mode.value_or(settings.filter_mode);
+  settings.pll_shift = overrides.pll_shift.value_or(settings.pll_shift);
+  settings.output_offset_us =
+      overrides.output_offset_us.value_or(settings.output_offset_us);
+  settings.flywheel_ms = overrides.flywheel_ms.value_or(settings.flywheel_ms);
+  fprintf(stderr,
+          "clock_replay: capture v%u, ppqn %u, %s filter, pll shift %u, "
+          "output offset %d us, flywheel %u ms\n",
+          capture.version, settings.ppqn,
+          piko::clockFilterModeName(settings.filter_mode), settings.pll_shift,
+          settings.output_offset_us, settings.flywheel_ms);
+
+  const uint32_t start_us = capture.records.front().timestamp_us;
+  ClockSync clock(carrier_hz);
+  clock.setSource(source, settings.ppqn, start_us);
+  clock.setFilterMode(settings.filter_mode, settings.pll_shift);
+  clock.setOutputOffsetUs(settings.output_offset_us);
+  clock.setFlywheelMs(settings.flywheel_ms);
+
+  printf("t_us,event,device_outcome,replay_outcome,device_state,replay_state,"
+         "bpm_x100,target_bpm_x100,phase_error_us,jitter_us\n");
+  uint64_t carrier = 0;
+  uint32_t beats = 0;
+  uint32_t outcome_mismatches = 0;
+  uint32_t state_mismatches = 0;
+  ClockState last_state = clock.state();
+  for (const ClockCaptureRecord& r : capture.records) {
+    const uint32_t offset_us = r.timestamp_us - start_us;
+    const uint64_t event_carrier =
+        static_cast<uint64_t>(offset_us) * carrier_hz / 1000000u;
+    for (; carrier < event_carrier; ++carrier) {
+      const uint32_t now_us =
+          start_us + static_cast<uint32_t>(carrier * 1000000u / carrier_hz);
+      if (clock.advanceCarrier(now_us)) ++beats;
+      if (print_states && clock.state() != last_state) {
+        printf("%u,STATE,,,,%s,,,,\n", now_us - start_us,
+               piko::clockStateName(clock.state()));
+      }
+      last_state = clock.state();
+    }
+
+    const ClockOutcome outcome = clock.process({r.type, r.timestamp_us});
+    last_state = clock.state();
+    const piko::ClockDiagnostics d = clock.diagnostics();
+    if (outcome != r.outcome) ++outcome_mismatches;
+    if (d.state != r.state) ++state_mismatches;
+    printf("%u,%s,%s,%s,%s,%s,%u,%u,%d,%u\n", offset_us,
+           piko::clockEventTypeName(r.type), piko::clockOutcomeName(r.outcome),
+           piko::clockOutcomeName(outcome), piko::clockStateName(r.state),
+           piko::clockStateName(d.state), d.measured_bpm_x100,
+           d.target_bpm_x100, d.phase_error_us, d.jitter_us);
+  }
+
+  const piko::ClockDiagnostics d = clock.diagnostics();
+  fprintf(stderr,
+          "clock_replay: %zu records (%u written on device), %u beats, "
+          "accepted %u rejected %u missed %u, max phase error %u us, "
+          "%u outcome and %u state mismatches\n",
+          capture.records.size(), capture.written, beats, d.accepted_events,
+          d.rejected_events, d.missed_events, d.max_phase_error_us,
+          outcome_mismatches, state_mismatches);
+  return 0;
+}
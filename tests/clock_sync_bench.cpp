@@ -0,0 +1,148 @@
+#include <stdint.h>
+#include <stdio.h>
+
+#include <chrono>
+
+#include "ClockSync.h"
+
+using piko::ClockEvent;
+using piko::ClockEventType;
+using piko::ClockFilterMode;
+using piko::ClockSource;
+using piko::ClockSync;
+
+namespace {
+
+using BenchClock = std::chrono::steady_clock;
+
+constexpr uint32_t kCarrierHz = 121093u;  // 248 MHz / 2048
+constexpr uint32_t kSeconds = 60u;
+
+struct Stream {
+  const char* name;
+  ClockSource source;
+  uint8_t ppqn;  // landmarks per quarter note
+  ClockEventType type;
+  uint32_t bpm_x100;
+  uint32_t jitter_us;
+  ClockFilterMode filter;
+};
+
+struct Result {
+  double carrier_ns;
+  double process_ns;
+  uint64_t carriers;
+  uint64_t events;
+  uint64_t beats;
+};
+
+uint32_t lcg(uint32_t& state) {
+  state = state * 1664525u + 1013904223u;
+  return state >> 8u;
+}
+
+double elapsedNs(BenchClock::time_point a, BenchClock::time_point b) {
+  return std::chrono::duration<double, std::nano>(b - a).count();
+}
+
+// Cost of the timing calls themselves, subtracted from per-event timings.
+double timerOverheadNs() {
+  constexpr uint32_t kSamples = 100000u;
+  double total = 0;
+  for (uint32_t i = 0; i < kSamples; ++i) {
+    const auto a = BenchClock::now();
+    const auto b = BenchClock::now();
+    total += elapsedNs(a, b);
+  }
+  return total / kSamples;
+}
+
+Result run(const Stream& stream, double overhead_ns) {
+  ClockSync clock(kCarrierHz);
+  clock.setSource(stream.source, stream.ppqn <= 4 ? stream.ppqn : 2, 0);
+  clock.setFilterMode(stream.filter, 2);
+  if (stream.type == ClockEventType::MidiClock) {
+    clock.process({ClockEventType::MidiStart, 0});
+  }
+
+  const uint64_t interval_ns =
+      6000000000000ull / (static_cast<uint64_t>(stream.bpm_x100) * stream.ppqn);
+  uint32_t seed = 12345u;
+  Result result{};
+  double carrier_ns = 0;
+  double process_ns = 0;
+  uint64_t carrier = 0;
+  const uint64_t total_carriers = static_cast<uint64_t>(kCarrierHz) * kSeconds;
+  for (uint64_t edge = 1;; ++edge) {
+    const int32_t jitter =
+        stream.jitter_us == 0
+            ? 0
+            : static_cast<int32_t>(lcg(seed) % (2u * stream.jitter_us + 1u)) -
+                  static_cast<int32_t>(stream.jitter_us);
+    const uint32_t edge_us =
+        static_cast<uint32_t>(edge * interval_ns / 1000u) + jitter;
+    const uint64_t edge_carrier =
+        static_cast<uint64_t>(edge_us) * kCarrierHz / 1000000u;
+    if (edge_carrier >= total_carriers) break;
+
+    const auto a = BenchClock::now();
+    for (; carrier < edge_carrier; ++carrier) {
+      const uint32_t now_us =
+          static_cast<uint32_t>(carrier * 1000000u / kCarrierHz);
+      if (clock.advanceCarrier(now_us)) ++result.beats;
+    }
+    const auto b = BenchClock::now();
+    clock.process({stream.type, edge_us});
+    const auto c = BenchClock::now();
+    carrier_ns += elapsedNs(a, b) - overhead_ns;
+    process_ns += elapsedNs(b, c) - overhead_ns;
+    ++result.events;
+  }
+
+  // The carrier loop also pays for computing now_us; time that alone.
+  const auto a = BenchClock::now();
+  volatile uint32_t sink = 0;
+  for (uint64_t i = 0; i < carrier; ++i) {
+    sink = sink + static_cast<uint32_t>(i * 1000000u / kCarrierHz);
+  }
+  const auto b = BenchClock::now();
+  carrier_ns -= elapsedNs(a, b);
+
+  result.carriers = carrier;
+  result.carrier_ns = carrier_ns / static_cast<double>(carrier);
+  result.process_ns = process_ns / static_cast<double>(result.events);
+  return result;
+}
+
+}  // namespace
+
+int main() {
+  constexpr ClockFilterMode kMedian = ClockFilterMode::Median;
+  constexpr ClockFilterMode kPll = ClockFilterMode::Pll;
+  const Stream streams[] = {
+      {"pulse-2ppqn", ClockSource::Pulse, 2, ClockEventType::Pulse, 12000, 0,
+       kMedian},
+      {"pulse-2ppqn-jitter", ClockSource::Pulse, 2, ClockEventType::Pulse,
+       12000, 800, kMedian},
+      {"midi-24ppqn", ClockSource::Midi, 24, ClockEventType::MidiClock, 12000,
+       0, kMedian},
+      {"midi-24ppqn-jitter", ClockSource::Midi, 24, ClockEventType::MidiClock,
+       17400, 300, kMedian},
+      {"midi-24ppqn-pll", ClockSource::Midi, 24, ClockEventType::MidiClock,
+       12000, 0, kPll},
+      {"midi-24ppqn-jitter-pll", ClockSource::Midi, 24,
+       ClockEventType::MidiClock, 17400, 300, kPll},
+  };
+  const double overhead_ns = timerOverheadNs();
+  printf("%-22s %12s %12s %10s %8s %8s\n", "stream", "ns/carrier",
+         "ns/process", "carriers", "events", "beats");
+  for (const Stream& stream : streams) {
+    const Result r = run(stream, overhead_ns);
+    printf("%-22s %12.2f %12.2f %10llu %8llu %8llu\n", stream.name,
+           r.carrier_ns, r.process_ns,
+           static_cast<unsigned long long>(r.carriers),
+           static_cast<unsigned long long>(r.events),
+           static_cast<unsigned long long>(r.beats));
+  }
+  return 0;
+}
@@ -4,13 +4,19 @@
 
 #include <cmath>
 #include <initializer_list>
+#include <vector>
 
 #include "ClockSync.h"
+#include "EventRing.h"
+#include "MidiClockOut.h"
 #include "SpscQueue.h"
+#include "TriggerClock.h"
 
 using piko::ClockDiagnostics;
 using piko::ClockEvent;
 using piko::ClockEventType;
+using piko::ClockFilterMode;
+using piko::ClockOutcome;
 using piko::ClockSource;
 using piko::ClockState;
 using piko::ClockSync;
@@ -39,36 +45,43 @@ void testPulseDivisions() {
 }
 
 void testMidiClockAndTransport() {
-  ClockSync clock(1000);
-  clock.setSource(ClockSource::Midi, 2, 0);
-  clock.process({ClockEventType::MidiStart, 0});
-  uint32_t now = 0;
-  uint32_t beats = 0;
-  for (uint32_t tick = 0; tick <= 2000; ++tick) {
-    now = tick * 1000u;
-    if (tick % 21u == 0) {
-      // Rounded 120 BPM MIDI clock (20.833 ms) stays well inside filtering.
-      clock.process({ClockEventType::MidiClock, now});
+  // The one-wire and USB MIDI sources share the same 24-PPQN handling.
+  for (const ClockSource source : {ClockSource::Midi, ClockSource::UsbMidi}) {
+    ClockSync clock(1000);
+    clock.setSource(source, 2, 0);
+    clock.process({ClockEventType::MidiStart, 0});
+    uint32_t now = 0;
+    uint32_t beats = 0;
+    for (uint32_t tick = 0; tick <= 2000; ++tick) {
+      now = tick * 1000u;
+      if (tick % 21u == 0) {
+        // Rounded 120 BPM MIDI clock (20.833 ms) stays well inside filtering.
+        clock.process({ClockEventType::MidiClock, now});
+      }
+      if (clock.advanceCarrier(now)) ++beats;
     }
-    if (clock.advanceCarrier(now)) ++beats;
-  }
-  const ClockDiagnostics d = clock.diagnostics();
-  assert(d.state == ClockState::Locked);
-  assert(d.measured_bpm_x100 > 11800u && d.measured_bpm_x100 < 12100u);
-  assert(beats >= 7u && beats <= 9u);
+    const ClockDiagnostics d = clock.diagnostics();
+    assert(d.state == ClockState::Locked);
+    assert(d.measured_bpm_x100 > 11800u && d.measured_bpm_x100 < 12100u);
+    assert(beats >= 7u && beats <= 9u);
 
-  clock.advanceCarrier(now + 50000u);
-  assert(clock.diagnostics().state == ClockState::Holdover);
-  assert(clock.transportPaused());
-  clock.process({ClockEventType::MidiContinue, now + 60000u});
-  assert(clock.midiRunning());
-  assert(!clock.transportPaused());
+    // A gap of a few dropped clocks is bridged; a longer one holds over.
+    clock.advanceCarrier(now + 50000u);
+    assert(clock.diagnostics().state == ClockState::Locked);
+    clock.advanceCarrier(now + 120000u);
+    assert(clock.diagnostics().state == ClockState::Holdover);
+    assert(clock.transportPaused());
+    clock.process({ClockEventType::MidiContinue, now + 130000u});
+    assert(clock.midiRunning());
+    assert(!clock.transportPaused());
 
-  const uint32_t stop_time = now + 70000u;
-  clock.process({ClockEventType::MidiStop, stop_time});
-  assert(!clock.midiRunning());
-  for (uint32_t i = 0; i < 1000; ++i) {
-    assert(!clock.advanceCarrier(stop_time + i * 1000u));
+    const uint32_t stop_time = now + 140000u;
+    clock.process({ClockEventType::MidiStop, stop_time});
+    assert(!clock.midiRunning());
+    for (uint32_t i = 0; i < 1000; ++i) {
+      assert(!clock.advanceCarrier(stop_time + i * 1000u));
+    }
+    assert(clock.diagnostics().source == source);
   }
 }
 
@@ -127,6 +140,94 @@ void testTempoChangeHoldoverAndReacquisition() {
   assert(!short_holdover.consumeLoopRestart());
 }
 
+void testFlywheelCoastsThroughDropouts() {
+  // Pulses stop for 1.2 s and return on the original grid.
+  ClockSync clock(1000);
+  clock.setFlywheelMs(2000);
+  clock.setSource(ClockSource::Pulse, 2, 0);
+  uint32_t beats_in_gap = 0;
+  for (uint32_t tick = 0; tick <= 4000; ++tick) {
+    const uint32_t now = tick * 1000u;
+    const bool gap = now > 1500000u && now < 2750000u;
+    if (tick % 250u == 0 && !gap) clock.process({ClockEventType::Pulse, now});
+    const bool beat = clock.advanceCarrier(now);
+    if (gap && beat) ++beats_in_gap;
+    if (now == 2100000u) {
+      // A glitch between coasted pulse slots does not end the coast.
+      assert(clock.process({ClockEventType::Pulse, now}) ==
+             ClockOutcome::Rejected);
+      assert(clock.state() == ClockState::Flywheel);
+    }
+    if (now == 2500000u) {
+      assert(clock.state() == ClockState::Flywheel);
+      assert(!clock.transportPaused());
+    }
+  }
+  ClockDiagnostics d = clock.diagnostics();
+  assert(d.rejected_events == 1u);
+  assert(beats_in_gap == 4u);  // 1.75 .. 2.5 s, one per eighth
+  assert(d.state == ClockState::Locked);
+  assert(d.flywheel_entries == 1u && d.flywheel_recoveries == 1u);
+  assert(d.flywheel_expiries == 0u);
+  assert(d.flywheel_time_ms >= 700u && d.flywheel_time_ms <= 800u);
+  assert(d.missed_events == 4u);
+  assert(std::abs(d.relock_phase_error_us) <= 2500);
+  assert(!clock.consumeLoopRestart());
+
+  // A clock that returns off the coasted grid re-locks on its second edge.
+  ClockSync shifted(1000);
+  shifted.setFlywheelMs(2000);
+  lockPulse(shifted, 2, 0, 250000);
+  for (uint32_t now = 500000; now <= 3000000; now += 1000) {
+    if (now >= 1600000u && (now - 1600000u) % 250000u == 0) {
+      const ClockOutcome outcome =
+          shifted.process({ClockEventType::Pulse, now});
+      assert(outcome == (now == 1600000u ? ClockOutcome::Rejected
+                                         : ClockOutcome::Accepted));
+    }
+    shifted.advanceCarrier(now);
+  }
+  d = shifted.diagnostics();
+  assert(d.state == ClockState::Locked);
+  assert(d.flywheel_recoveries == 1u && d.flywheel_expiries == 0u);
+
+  // A gap longer than the limit falls back to the paused holdover.
+  ClockSync expired(1000);
+  expired.setFlywheelMs(500);
+  lockPulse(expired, 2, 0, 250000);
+  for (uint32_t now = 500000; now <= 2000000; now += 1000) {
+    expired.advanceCarrier(now);
+  }
+  d = expired.diagnostics();
+  assert(d.state == ClockState::Holdover);
+  assert(expired.transportPaused());
+  assert(d.flywheel_expiries == 1u);
+
+  // Dropped 24-PPQN MIDI clocks keep the ordinal within the eighth. Two are
+  // bridged without leaving lock; six take the flywheel.
+  ClockSync midi(10000);
+  midi.setFlywheelMs(1000);
+  midi.setSource(ClockSource::Midi, 2, 0);
+  midi.process({ClockEventType::MidiStart, 0});
+  uint32_t beats = 0;
+  for (uint32_t tick = 0; tick < 30000; ++tick) {
+    const uint32_t now = tick * 100u;
+    // 125 BPM: exactly 20 ms per clock; clocks 50-51 and 100-105 are lost.
+    const uint32_t index = tick / 200u;
+    const bool lost = (index >= 50u && index <= 51u) ||
+                      (index >= 100u && index <= 105u);
+    if (tick % 200u == 0 && !lost) {
+      midi.process({ClockEventType::MidiClock, now});
+    }
+    if (midi.advanceCarrier(now)) ++beats;
+  }
+  d = midi.diagnostics();
+  assert(d.state == ClockState::Locked);
+  assert(d.flywheel_entries == 1u && d.flywheel_recoveries == 1u);
+  assert(std::abs(d.relock_phase_error_us) <= 500);
+  assert(beats >= 11u && beats <= 13u);  // 3 s at 125 BPM, no extra beats
+}
+
 void testTimestampWraparound() {
   ClockSync clock(1000000);
   const uint32_t start = 0xffff0000u;
@@ -159,6 +260,101 @@ void testQueueOverflow() {
   assert(!queue.pop(value));
 }
 
+// Ramps a 2-PPQN clock from 120 BPM by shortening each interval 250 us and
+// returns the RMS phase error over the last 30 of 40 edges.
+double rampPhaseErrorRms(ClockSync& clock, uint32_t& interval) {
+  uint32_t now = 500000u;
+  interval = 250000u;
+  double sum_sq = 0.0;
+  for (uint32_t i = 0; i < 40; ++i) {
+    interval -= 250u;
+    const uint32_t edge = now + interval;
+    for (; now < edge; now += 10u) clock.advanceCarrier(now);
+    clock.process({ClockEventType::Pulse, edge});
+    if (i >= 10) {
+      const double error = clock.diagnostics().phase_error_us;
+      sum_sq += error * error;
+    }
+  }
+  return std::sqrt(sum_sq / 30.0);
+}
+
+void testPllFilterTracksRamp() {
+  ClockSync clock(100000);
+  clock.setFilterMode(ClockFilterMode::Pll, 2);
+  assert(clock.diagnostics().filter_mode == ClockFilterMode::Pll);
+  lockPulse(clock, 2, 0, 250000);
+  assert(clock.diagnostics().state == ClockState::Locked);
+  assert(clock.diagnostics().measured_bpm_x100 == 12000u);
+
+  // Ramp 120 -> ~126 BPM.
+  uint32_t interval = 0;
+  const double pll_rms = rampPhaseErrorRms(clock, interval);
+  const ClockDiagnostics d = clock.diagnostics();
+  assert(d.state == ClockState::Locked);
+  assert(d.rejected_events == 0u);
+  const uint32_t true_bpm_x100 = 6000000000u / (interval * 2u);
+  assert(d.measured_bpm_x100 + 100u > true_bpm_x100 &&
+         d.measured_bpm_x100 < true_bpm_x100 + 100u);
+  assert(d.phase_error_us < 10000 && d.phase_error_us > -10000);
+
+  // The drift term keeps the loop at least as close to a ramp as the median
+  // filter, which re-slews the whole error every edge.
+  ClockSync median(100000);
+  lockPulse(median, 2, 0, 250000);
+  const double median_rms = rampPhaseErrorRms(median, interval);
+  assert(pll_rms <= median_rms);
+
+  // Switching back keeps the tracked tempo instead of re-acquiring.
+  clock.setFilterMode(ClockFilterMode::Median, 0);
+  assert(clock.diagnostics().filter_mode == ClockFilterMode::Median);
+  assert(clock.diagnostics().measured_bpm_x100 == d.measured_bpm_x100);
+  assert(!ClockSync::validPllShift(0) && !ClockSync::validPllShift(7));
+}
+
+void testProcessOutcomes() {
+  ClockSync clock(1000000);
+  clock.setSource(ClockSource::Pulse, 2, 0);
+  assert(clock.process({ClockEventType::Pulse, 10000}) ==
+         ClockOutcome::Accepted);
+  assert(clock.process({ClockEventType::Pulse, 11000}) ==
+         ClockOutcome::Rejected);  // bounce
+  assert(clock.process({ClockEventType::Pulse, 260000}) ==
+         ClockOutcome::Accepted);
+  assert(clock.process({ClockEventType::MidiClock, 270000}) ==
+         ClockOutcome::Ignored);
+
+  clock.setSource(ClockSource::Midi, 2, 300000);
+  assert(clock.process({ClockEventType::MidiStart, 300000}) ==
+         ClockOutcome::Transport);
+  assert(clock.process({ClockEventType::MidiClock, 310000}) ==
+         ClockOutcome::Accepted);
+  assert(clock.process({ClockEventType::Pulse, 320000}) ==
+         ClockOutcome::Ignored);
+  assert(clock.process({ClockEventType::MidiStop, 330000}) ==
+         ClockOutcome::Transport);
+  assert(clock.state() == ClockState::Unlocked);
+}
+
+void testEventRingOverwriteAndHold() {
+  EventRing<uint32_t, 4> ring;
+  assert(ring.size() == 0u);
+  for (uint32_t i = 1; i <= 6; ++i) ring.push(i);
+  assert(ring.written() == 6u);
+  assert(ring.size() == 4u);
+  assert(ring.at(0) == 3u && ring.at(3) == 6u);
+
+  ring.hold(true);
+  ring.push(7);
+  assert(ring.heldDrops() == 1u);
+  assert(ring.at(3) == 6u);
+  ring.clear();
+  ring.hold(false);
+  assert(ring.size() == 0u);
+  ring.push(8);
+  assert(ring.size() == 1u && ring.at(0) == 8u);
+}
+
 void testPhaseLandmarksAndLongTermAccuracy() {
   ClockSync clock(1000);
   clock.setSource(ClockSource::Internal, 2, 0);
@@ -231,17 +427,292 @@ void testPlaybackRatios() {
   }
 }
 
+void testOutputOffsetShiftsBeats() {
+  for (const int32_t offset_us : {0, 10000, -10000}) {
+    ClockSync clock(1000);
+    clock.setOutputOffsetUs(offset_us);
+    clock.setSource(ClockSource::Pulse, 2, 0);
+    std::vector<uint32_t> beats;
+    for (uint32_t tick = 0; tick <= 10000; ++tick) {
+      const uint32_t now = tick * 1000u;
+      if (tick % 250u == 0) clock.process({ClockEventType::Pulse, now});
+      if (clock.advanceCarrier(now) && now >= 3000000u && now < 10000000u) {
+        beats.push_back(now);
+      }
+    }
+    // One beat per eighth, each leading (positive) or lagging its landmark.
+    assert(beats.size() == 28u);
+    for (const uint32_t beat : beats) {
+      const int32_t from_pulse =
+          static_cast<int32_t>((beat + 125000u) % 250000u) - 125000;
+      assert(std::abs(from_pulse + offset_us) <= 2000);
+    }
+    const ClockDiagnostics d = clock.diagnostics();
+    assert(d.state == ClockState::Locked);
+    assert(d.output_offset_us == offset_us);
+    assert(std::abs(d.phase_error_us) <= 2500);
+  }
+  ClockSync clock(1000);
+  assert(!ClockSync::validOutputOffsetUs(20001));
+  clock.setOutputOffsetUs(-30000);
+  assert(clock.diagnostics().output_offset_us == 0);
+}
+
+void testMidiClockOut() {
+  constexpr uint32_t kCarrierHz = 10000u;
+  ClockSync clock(kCarrierHz);
+  clock.setSource(ClockSource::Internal, 2, 0);
+  clock.setInternalBpmX100(12000);
+  MidiClockOut out;
+  std::vector<uint8_t> messages;
+  std::vector<uint32_t> clock_carriers;
+  uint32_t carrier = 0;
+  auto run = [&](uint32_t carriers, bool running) {
+    for (uint32_t i = 0; i < carriers; ++i, ++carrier) {
+      clock.advanceCarrier(carrier * (1000000u / kCarrierHz));
+      out.update(static_cast<uint32_t>(clock.transportPhaseQ32()), running,
+                 [&](uint8_t status) {
+                   messages.push_back(status);
+                   if (status == MidiClockOut::kClock) {
+                     clock_carriers.push_back(carrier);
+                   }
+                 });
+    }
+  };
+
+  // Start waits for the first eighth boundary at 250 ms; the remaining
+  // 9.75 s at 120 BPM carry 48 clocks per second.
+  run(10u * kCarrierHz, true);
+  assert(messages.front() == MidiClockOut::kStart);
+  assert(clock_carriers.front() >= 2499u && clock_carriers.front() <= 2500u);
+  assert(clock_carriers.size() == 469u);
+  for (size_t i = 1; i < clock_carriers.size(); ++i) {
+    const uint32_t gap = clock_carriers[i] - clock_carriers[i - 1u];
+    assert(gap == 208u || gap == 209u);  // 20.833 ms per clock
+  }
+  // Ticks are derived from absolute phase, so the count never drifts.
+  const uint32_t span = clock_carriers.back() - clock_carriers.front();
+  assert(span >= 97499u && span <= 97501u);  // 39 eighths
+
+  // Stop and Continue bracket a paused run without restarting the song.
+  messages.clear();
+  run(1000u, false);
+  assert(messages.size() == 1u && messages[0] == MidiClockOut::kStop);
+  messages.clear();
+  run(1000u, true);
+  assert(messages.front() == MidiClockOut::kContinue);
+
+  // A restart while running lands Start on the next eighth without
+  // dropping or inserting a clock.
+  out.requestStart();
+  messages.clear();
+  clock_carriers.clear();
+  run(kCarrierHz, true);
+  size_t start_index = messages.size();
+  uint32_t clocks_before_start = 0;
+  for (size_t i = 0; i < messages.size(); ++i) {
+    if (messages[i] == MidiClockOut::kStart) {
+      start_index = i;
+      break;
+    }
+    ++clocks_before_start;
+  }
+  assert(start_index < messages.size());
+  assert(clocks_before_start < MidiClockOut::kTicksPerEighth);
+  assert(messages[start_index + 1u] == MidiClockOut::kClock);
+  for (size_t i = 1; i < clock_carriers.size(); ++i) {
+    const uint32_t gap = clock_carriers[i] - clock_carriers[i - 1u];
+    assert(gap == 208u || gap == 209u);
+  }
+
+  // A backwards phase snap holds the clock until the transport catches up.
+  MidiClockOut snapped;
+  uint32_t clocks = 0;
+  auto count = [&](uint8_t status) {
+    if (status == MidiClockOut::kClock) ++clocks;
+  };
+  snapped.update(0, true, count);
+  snapped.update(0x60000000u, true, count);
+  assert(clocks == 5u);
+  snapped.update(0x30000000u, true, count);
+  snapped.update(0x5fffffffu, true, count);
+  assert(clocks == 5u);
+  snapped.update(0xa0000000u, true, count);
+  assert(clocks == 8u);
+  assert(snapped.clocks() == clocks);
+}
+
+void testTriggerClock() {
+  constexpr uint32_t kCarrierHz = 10000u;
+  constexpr uint32_t kCarrierUs = 1000000u / kCarrierHz;
+  ClockSync clock(kCarrierHz);
+  clock.setSource(ClockSource::Internal, 2, 0);
+  clock.setInternalBpmX100(12000);
+  TriggerClock trigger;
+  trigger.setCarrierHz(kCarrierHz);
+  std::vector<uint32_t> rises;
+  uint32_t carrier = 0;
+  auto run = [&](uint32_t carriers, bool running) {
+    for (uint32_t i = 0; i < carriers; ++i, ++carrier) {
+      const uint32_t now_us = carrier * kCarrierUs;
+      clock.advanceCarrier(now_us);
+      trigger.update(static_cast<uint32_t>(clock.transportPhaseQ32()),
+                     running,
+                     [&](uint32_t delay_us) {
+                       // Never further ahead than the lookahead.
+                       assert(delay_us <=
+                              TriggerClock::kLookaheadCarriers * kCarrierUs);
+                       rises.push_back(now_us + delay_us);
+                     });
+    }
+  };
+  // Pulses land between carriers at absolute grid times, so the error
+  // against the ideal period stays within a microsecond over the run.
+  auto assert_period = [&](double period_us) {
+    assert(rises.size() > 2u);
+    for (size_t i = 1; i < rises.size(); ++i) {
+      const double ideal = rises.front() + period_us * i;
+      assert(std::fabs(rises[i] - ideal) <= 1.0);
+    }
+  };
+
+  // Two PPQN: one pulse per eighth, 250 ms at 120 BPM.
+  trigger.configure(2, 1);
+  run(10u * kCarrierHz, true);
+  assert(rises.size() == 40u);
+  assert_period(250000.0);
+
+  // Multiplied: 24 PPQN is a pulse every 20.833 ms.
+  trigger.configure(24, 1);
+  rises.clear();
+  run(5u * kCarrierHz, true);
+  assert(rises.size() == 240u);
+  assert_period(500000.0 / 24.0);
+
+  // Divided: one pulse per bar, restarted from the next quarter.
+  trigger.configure(1, 4);
+  rises.clear();
+  run(9u * kCarrierHz, true);
+  assert(rises.size() == 4u || rises.size() == 5u);
+  assert_period(2000000.0);
+
+  // Nothing while stopped; the grid resumes on its next pulse.
+  rises.clear();
+  run(kCarrierHz, false);
+  assert(rises.empty());
+  trigger.configure(2, 1);
+  run(kCarrierHz, true);
+  assert(rises.size() == 4u);
+  assert_period(250000.0);
+  assert(trigger.skipped() == 0u);
+
+  // A forward snap across several pulses fires only the latest, at once,
+  // and keeps scheduling at the rate from before the snap.
+  TriggerClock snapped;
+  snapped.setCarrierHz(1000000);
+  snapped.configure(24, 1);
+  std::vector<uint32_t> delays;
+  auto record = [&](uint32_t delay_us) { delays.push_back(delay_us); };
+  snapped.update(0, true, record);
+  snapped.update(1000, true, record);
+  assert(delays.size() == 1u && delays[0] == 0u);
+  snapped.update(2000, true, record);
+  snapped.update(0x60000000u, true, record);  // past pulses 1 to 4
+  assert(delays.size() == 2u && delays[1] == 0u);
+  assert(snapped.skipped() == 3u);
+  // Pulse 5 sits 178956971 phase units on, 178956.971 us at 1000 per
+  // microsecond, and is armed two carriers ahead.
+  uint32_t phase = 0x60000000u;
+  uint32_t us = 0;
+  while (delays.size() == 2u) {
+    phase += 1000u;
+    ++us;
+    snapped.update(phase, true, record);
+  }
+  assert(us == 178955u && us + delays[2] == 178956u);
+  // A backward snap across that pulse does not send it again.
+  phase -= 100000u;
+  for (uint32_t i = 0; i < 200u; ++i) {
+    phase += 1000u;
+    snapped.update(phase, true, record);
+  }
+  assert(delays.size() == 3u);
+  assert(snapped.scheduled() == 3u && snapped.skipped() == 3u);
+}
+
 }  // namespace
 
+void testStatisticsHistograms() {
+  using piko::ClockHistogram;
+  assert(ClockHistogram::bucket(0) == 0);
+  assert(ClockHistogram::bucket(1) == 1);
+  assert(ClockHistogram::bucket(3) == 2);
+  assert(ClockHistogram::bucket(4) == 3);
+  assert(ClockHistogram::bucket(1000) == 10);
+  assert(ClockHistogram::bucket(16383) == 14);
+  assert(ClockHistogram::bucket(16384) == 15);
+  assert(ClockHistogram::bucket(0xffffffffu) == 15);
+
+  auto total = [](const ClockHistogram& h) {
+    uint32_t sum = 0;
+    for (const uint32_t count : h.counts) sum += count;
+    return sum;
+  };
+
+  // 120 BPM at 2 PPQN with +/-100 us of alternating jitter, then one edge
+  // 30 ms late: more than a tenth of a pulse, so the median filter snaps.
+  ClockSync clock(10000);
+  clock.setSource(ClockSource::Pulse, 2, 0);
+  uint32_t edges = 0;
+  for (uint32_t tick = 0; tick < 100000u; ++tick) {
+    const uint32_t now = tick * 100u;
+    if (tick % 2500u == 0 && tick != 50000u) {
+      const uint32_t jitter = (tick / 2500u) % 2u == 0 ? 0u : 200u;
+      clock.process({ClockEventType::Pulse, now + jitter});
+      ++edges;
+    } else if (tick == 50300u) {
+      clock.process({ClockEventType::Pulse, now});
+      ++edges;
+    }
+    clock.advanceCarrier(now);
+  }
+  ClockDiagnostics d = clock.diagnostics();
+  assert(d.state == ClockState::Locked);
+  assert(total(d.deviation_histogram) == edges - 1u);
+  assert(total(d.phase_error_histogram) == d.phase_snaps + d.phase_slews);
+  assert(d.phase_snaps >= 1u);
+  assert(d.phase_slews > d.phase_snaps * 10u);
+  // Steady jitter lands around 200 us; only the late edge and its neighbour
+  // reach the 16 ms bucket.
+  assert(d.deviation_histogram.counts[ClockHistogram::bucket(200)] > 20u);
+  assert(d.deviation_histogram.counts[15] <= 2u);
+
+  clock.resetStatistics();
+  d = clock.diagnostics();
+  assert(d.state == ClockState::Locked);
+  assert(total(d.deviation_histogram) == 0u);
+  assert(total(d.phase_error_histogram) == 0u);
+  assert(d.phase_snaps == 0u && d.phase_slews == 0u);
+  assert(d.max_phase_error_us == 0u);
+}
+
 int main() {
   testPulseDivisions();
   testMidiClockAndTransport();
   testBounceJitterAndMissedPulse();
   testTempoChangeHoldoverAndReacquisition();
+  testFlywheelCoastsThroughDropouts();
   testTimestampWraparound();
   testQueueOverflow();
+  testPllFilterTracksRamp();
+  testProcessOutcomes();
+  testEventRingOverwriteAndHold();
   testPhaseLandmarksAndLongTermAccuracy();
   testPlaybackRatios();
+  testOutputOffsetShiftsBeats();
+  testMidiClockOut();
+  testTriggerClock();
+  testStatisticsHistograms();
   puts("clock_sync_test: all tests passed");
   return 0;
 }
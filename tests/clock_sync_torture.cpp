@@ -0,0 +1,363 @@
+// Synthetic clock torture suite. Generates pulse and MIDI clock streams with
+// jitter, drift, tempo ramps, dropped and doubled edges and start/stop storms,
+// runs them through ClockSync on a simulated PWM carrier and reports lock
+// time, steady-state phase and tempo error, false holdovers and CPU time per
+// event.
+//
+//   clock_sync_torture [--csv] [--only NAME] [--seconds N] [--seed N]
+//                      [--filter median|pll|both] [--pll-shift N]
+//                      [--flywheel-ms N]
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include "ClockSync.h"
+
+using piko::ClockEvent;
+using piko::ClockEventType;
+using piko::ClockFilterMode;
+using piko::ClockSource;
+using piko::ClockState;
+using piko::ClockSync;
+
+namespace {
+
+using BenchClock = std::chrono::steady_clock;
+
+constexpr uint32_t kCarrierHz = 121093u;  // 248 MHz / 2048
+constexpr double kStartUs = 1000.0;
+constexpr double kSettleUs = 2000000.0;  // excluded from steady-state stats
+constexpr uint32_t kProtectedEdges = 4;  // never dropped or doubled
+
+struct Scenario {
+  const char* name;
+  ClockSource source;
+  uint8_t ppqn;
+  double bpm_start;
+  double bpm_end;          // linear ramp over ramp_seconds
+  double ramp_seconds;
+  double uniform_jitter_us;  // +/- bound
+  double gaussian_jitter_us;  // sigma
+  double drift_ppm;        // source clock fast (+) or slow (-)
+  double drop_rate;
+  double double_rate;
+  double double_fraction;  // doubled edge position within the interval
+  double storm_period_s;   // MIDI stop/start every period, 0 disables
+  double storm_gap_ms;
+};
+
+struct Edge {
+  double t_us;
+  ClockEventType type;
+};
+
+struct Ideal {
+  double t_us;
+  uint32_t ordinal;  // pulses since the last start
+  double bpm;        // true tempo
+  bool running;
+};
+
+struct Metrics {
+  uint32_t events = 0;
+  double lock_ms = -1.0;
+  double phase_rms_us = 0.0;
+  double phase_max_us = 0.0;
+  double tempo_mean_bpm = 0.0;
+  double tempo_max_bpm = 0.0;
+  uint32_t false_holdovers = 0;
+  uint32_t rejected = 0;
+  uint32_t missed = 0;
+  double ns_per_event = 0.0;
+};
+
+struct Options {
+  bool csv = false;
+  const char* only = nullptr;
+  double seconds = 30.0;
+  uint32_t seed = 1;
+  bool median = true;
+  bool pll = true;
+  uint8_t pll_shift = 2;
+  uint32_t flywheel_ms = 0;
+};
+
+double bpmAt(const Scenario& s, double t_us) {
+  if (s.ramp_seconds <= 0.0) return s.bpm_start;
+  const double x = std::min(1.0, (t_us - kStartUs) / (s.ramp_seconds * 1e6));
+  return s.bpm_start + (s.bpm_end - s.bpm_start) * x;
+}
+
+void generate(const Scenario& s, const Options& options,
+              std::vector<Edge>& edges, std::vector<Ideal>& ideals) {
+  std::mt19937 rng(options.seed);
+  std::uniform_real_distribution<double> unit(0.0, 1.0);
+  std::uniform_real_distribution<double> uniform(-s.uniform_jitter_us,
+                                                 s.uniform_jitter_us);
+  std::normal_distribution<double> gaussian(0.0, s.gaussian_jitter_us);
+  const bool midi = s.source == ClockSource::Midi;
+  const ClockEventType tick =
+      midi ? ClockEventType::MidiClock : ClockEventType::Pulse;
+  const double scale = 1.0 + s.drift_ppm * 1e-6;
+  const double end_us = kStartUs + options.seconds * 1e6;
+  const double storm_us = s.storm_period_s * 1e6;
+
+  double t = kStartUs;
+  double next_storm = storm_us > 0.0 ? kStartUs + storm_us : end_us;
+  uint32_t ordinal = 0;
+  // Jitter never moves a clock ahead of the Start that precedes it.
+  double earliest = t;
+  if (midi) edges.push_back({t, ClockEventType::MidiStart});
+  while (t < end_us) {
+    if (midi && t >= next_storm) {
+      edges.push_back({t, ClockEventType::MidiStop});
+      ideals.push_back({t, 0, 0.0, false});
+      t += s.storm_gap_ms * 1000.0;
+      edges.push_back({t, ClockEventType::MidiStart});
+      earliest = t;
+      next_storm += storm_us;
+      ordinal = 0;
+      continue;
+    }
+    const double bpm = bpmAt(s, t);
+    const double interval = 60e6 / (bpm * s.ppqn) * scale;
+    ideals.push_back({t, ordinal, bpm / scale, true});
+    const bool protect = ordinal < kProtectedEdges;
+    if (protect || unit(rng) >= s.drop_rate) {
+      double jitter = 0.0;
+      if (s.uniform_jitter_us > 0.0) jitter += uniform(rng);
+      if (s.gaussian_jitter_us > 0.0) jitter += gaussian(rng);
+      edges.push_back({std::max(earliest, t + jitter), tick});
+    }
+    if (!protect && unit(rng) < s.double_rate) {
+      edges.push_back({t + interval * s.double_fraction, tick});
+    }
+    ++ordinal;
+    t += interval;
+  }
+  std::stable_sort(edges.begin(), edges.end(),
+                   [](const Edge& a, const Edge& b) { return a.t_us < b.t_us; });
+}
+
+double elapsedNs(BenchClock::time_point a, BenchClock::time_point b) {
+  return std::chrono::duration<double, std::nano>(b - a).count();
+}
+
+double timerOverheadNs() {
+  constexpr uint32_t kSamples = 100000u;
+  double total = 0;
+  for (uint32_t i = 0; i < kSamples; ++i) {
+    const auto a = BenchClock::now();
+    const auto b = BenchClock::now();
+    total += elapsedNs(a, b);
+  }
+  return total / kSamples;
+}
+
+Metrics run(const Scenario& s, const Options& options, ClockFilterMode mode,
+            double overhead_ns) {
+  std::vector<Edge> edges;
+  std::vector<Ideal> ideals;
+  generate(s, options, edges, ideals);
+
+  ClockSync clock(kCarrierHz);
+  clock.setSource(s.source, s.source == ClockSource::Midi ? 2 : s.ppqn, 0);
+  clock.setFilterMode(mode, options.pll_shift);
+  clock.setFlywheelMs(options.flywheel_ms);
+  const uint32_t pulses_per_eighth =
+      s.source == ClockSource::Midi ? 12u : s.ppqn / 2u;
+
+  Metrics m;
+  double phase_sq = 0.0;
+  double tempo_sum = 0.0;
+  uint32_t samples = 0;
+  double process_ns = 0.0;
+  double first_lock_us = -1.0;
+  ClockState last_state = clock.state();
+  size_t next_ideal = 0;
+  uint64_t carrier = 0;
+
+  auto sample = [&](const Ideal& ideal) {
+    if (!ideal.running || clock.state() != ClockState::Locked ||
+        first_lock_us < 0.0 || ideal.t_us - first_lock_us < kSettleUs) {
+      return;
+    }
+    const double expected =
+        pulses_per_eighth == 0
+            ? 0.0
+            : static_cast<double>(ideal.ordinal % pulses_per_eighth) /
+                  pulses_per_eighth;
+    const double actual =
+        static_cast<double>(static_cast<uint32_t>(clock.transportPhaseQ32())) /
+        4294967296.0;
+    double error = actual - expected;
+    error -= std::floor(error + 0.5);
+    const double error_us = std::fabs(error) * 30e6 / ideal.bpm;
+    const double tempo_error =
+        std::fabs(clock.targetBpmX100() / 100.0 - ideal.bpm);
+    phase_sq += error_us * error_us;
+    m.phase_max_us = std::max(m.phase_max_us, error_us);
+    tempo_sum += tempo_error;
+    m.tempo_max_bpm = std::max(m.tempo_max_bpm, tempo_error);
+    ++samples;
+  };
+
+  for (const Edge& edge : edges) {
+    const uint64_t edge_carrier =
+        static_cast<uint64_t>(edge.t_us * kCarrierHz / 1e6);
+    for (; carrier < edge_carrier; ++carrier) {
+      const double now = static_cast<double>(carrier) * 1e6 / kCarrierHz;
+      clock.advanceCarrier(static_cast<uint32_t>(now));
+      const ClockState state = clock.state();
+      if (state == ClockState::Holdover && last_state != state) {
+        ++m.false_holdovers;
+      }
+      last_state = state;
+      while (next_ideal < ideals.size() && ideals[next_ideal].t_us <= now) {
+        sample(ideals[next_ideal++]);
+      }
+    }
+
+    const auto a = BenchClock::now();
+    clock.process({edge.type, static_cast<uint32_t>(edge.t_us)});
+    const auto b = BenchClock::now();
+    process_ns += elapsedNs(a, b) - overhead_ns;
+    ++m.events;
+    last_state = clock.state();
+    if (first_lock_us < 0.0 && last_state == ClockState::Locked) {
+      first_lock_us = edge.t_us;
+      m.lock_ms = (edge.t_us - kStartUs) / 1000.0;
+    }
+  }
+
+  const piko::ClockDiagnostics d = clock.diagnostics();
+  m.rejected = d.rejected_events;
+  m.missed = d.missed_events;
+  m.ns_per_event = m.events == 0 ? 0.0 : process_ns / m.events;
+  if (samples > 0) {
+    m.phase_rms_us = std::sqrt(phase_sq / samples);
+    m.tempo_mean_bpm = tempo_sum / samples;
+  }
+  return m;
+}
+
+const Scenario kScenarios[] = {
+    // name, source, ppqn, bpm a, bpm b, ramp s, uniform, gaussian, ppm,
+    // drop, double, double pos, storm s, storm gap ms
+    {"pulse2-clean", ClockSource::Pulse, 2, 120, 120, 0, 0, 0, 0, 0, 0, 0, 0,
+     0},
+    {"pulse2-uniform1ms", ClockSource::Pulse, 2, 120, 120, 0, 1000, 0, 0, 0,
+     0, 0, 0, 0},
+    {"pulse2-gauss500us", ClockSource::Pulse, 2, 120, 120, 0, 0, 500, 0, 0, 0,
+     0, 0, 0},
+    {"pulse2-drift500ppm", ClockSource::Pulse, 2, 120, 120, 0, 0, 50, 500, 0,
+     0, 0, 0, 0},
+    {"pulse4-ramp100-140", ClockSource::Pulse, 4, 100, 140, 20, 0, 100, 0, 0,
+     0, 0, 0, 0},
+    {"pulse1-60bpm-jitter", ClockSource::Pulse, 1, 60, 60, 0, 2000, 0, 0, 0,
+     0, 0, 0, 0},
+    {"pulse2-drop5pct", ClockSource::Pulse, 2, 120, 120, 0, 0, 100, 0, 0.05,
+     0, 0, 0, 0},
+    {"pulse2-bounce5pct", ClockSource::Pulse, 2, 120, 120, 0, 0, 100, 0, 0,
+     0.05, 0.006, 0, 0},
+    {"pulse2-double5pct", ClockSource::Pulse, 2, 120, 120, 0, 0, 100, 0, 0,
+     0.05, 0.4, 0, 0},
+    {"midi24-clean", ClockSource::Midi, 24, 120, 120, 0, 0, 0, 0, 0, 0, 0, 0,
+     0},
+    {"midi24-gauss300us", ClockSource::Midi, 24, 120, 120, 0, 0, 300, 0, 0,
+     0, 0, 0, 0},
+    {"midi24-ramp120-128", ClockSource::Midi, 24, 120, 128, 16, 0, 200, 0, 0,
+     0, 0, 0, 0},
+    {"midi24-ramp-dj", ClockSource::Midi, 24, 124, 118, 25, 0, 400, 0, 0, 0,
+     0, 0, 0},
+    {"midi24-drop2pct", ClockSource::Midi, 24, 120, 120, 0, 0, 200, 0, 0.02,
+     0, 0, 0, 0},
+    {"midi24-storm", ClockSource::Midi, 24, 120, 120, 0, 0, 200, 0, 0, 0, 0,
+     2.0, 100},
+};
+
+void printHeader(bool csv) {
+  if (csv) {
+    puts("scenario,filter,events,lock_ms,phase_rms_us,phase_max_us,tempo_mean_bpm,"
+         "tempo_max_bpm,false_holdovers,rejected,missed,ns_per_event");
+    return;
+  }
+  printf("%-22s %-6s %7s %9s %10s %10s %9s %9s %6s %7s %6s %8s\n",
+         "scenario", "filter", "events", "lock_ms", "phase_rms", "phase_max", "tempo_avg",
+         "tempo_max", "holdov", "reject", "missed", "ns/event");
+}
+
+void printRow(bool csv, const char* name, ClockFilterMode mode,
+              const Metrics& m) {
+  const char* format =
+      csv ? "%s,%s,%u,%.1f,%.1f,%.1f,%.3f,%.3f,%u,%u,%u,%.1f\n"
+          : "%-22s %-6s %7u %9.1f %10.1f %10.1f %9.3f %9.3f %6u %7u %6u "
+            "%8.1f\n";
+  printf(format, name, piko::clockFilterModeName(mode), m.events, m.lock_ms, m.phase_rms_us, m.phase_max_us,
+         m.tempo_mean_bpm, m.tempo_max_bpm, m.false_holdovers, m.rejected,
+         m.missed, m.ns_per_event);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  Options options;
+  for (int i = 1; i < argc; ++i) {
+    if (strcmp(argv[i], "--csv") == 0) {
+      options.csv = true;
+    } else if (strcmp(argv[i], "--only") == 0 && i + 1 < argc) {
+      options.only = argv[++i];
+    } else if (strcmp(argv[i], "--seconds") == 0 && i + 1 < argc) {
+      options.seconds = atof(argv[++i]);
+    } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+      options.seed = static_cast<uint32_t>(strtoul(argv[++i], nullptr, 10));
+    } else if (strcmp(argv[i], "--filter") == 0 && i + 1 < argc) {
+      const char* filter = argv[++i];
+      options.median = strcmp(filter, "pll") != 0;
+      options.pll = strcmp(filter, "median") != 0;
+    } else if (strcmp(argv[i], "--pll-shift") == 0 && i + 1 < argc) {
+      options.pll_shift = static_cast<uint8_t>(atoi(argv[++i]));
+      if (!ClockSync::validPllShift(options.pll_shift)) {
+        fprintf(stderr, "clock_sync_torture: --pll-shift must be 1..6\n");
+        return 2;
+      }
+    } else if (strcmp(argv[i], "--flywheel-ms") == 0 && i + 1 < argc) {
+      options.flywheel_ms = static_cast<uint32_t>(strtoul(argv[++i], nullptr, 10));
+      if (!ClockSync::validFlywheelMs(options.flywheel_ms)) {
+        fprintf(stderr, "clock_sync_torture: --flywheel-ms must be 0..10000\n");
+        return 2;
+      }
+    } else {
+      fprintf(stderr,
+              "usage: clock_sync_torture [--csv] [--only NAME] [--seconds N] "
+              "[--seed N] [--filter median|pll|both] [--pll-shift N] "
+              "[--flywheel-ms N]\n");
+      return 2;
+    }
+  }
+
+  const double overhead_ns = timerOverheadNs();
+  printHeader(options.csv);
+  for (const Scenario& scenario : kScenarios) {
+    if (options.only != nullptr && strcmp(options.only, scenario.name) != 0) {
+      continue;
+    }
+    if (options.median) {
+      printRow(options.csv, scenario.name, ClockFilterMode::Median,
+               run(scenario, options, ClockFilterMode::Median, overhead_ns));
+    }
+    if (options.pll) {
+      printRow(options.csv, scenario.name, ClockFilterMode::Pll,
+               run(scenario, options, ClockFilterMode::Pll, overhead_ns));
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,459 @@
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include <initializer_list>
+
+#include "BeatRepeat.h"
+#include "GrainInterp.h"
+#include "IsrGovernor.h"
+#include "PikoArena.h"
+#include "RenderCache.h"
+#include "RenderPipeline.h"
+#include "VarispeedSlave.h"
+#include "doth/delay.h"
+
+namespace {
+
+void testBeatRepeatForwardAndReverse() {
+  BeatRepeat<16> repeat;
+  for (uint8_t i = 0; i < 5; ++i) repeat.capture(i);
+  const uint32_t start = repeat.position();
+  assert(!repeat.start(start, 4, false));
+  for (uint8_t i = 10; i < 14; ++i) repeat.capture(i);
+  assert(repeat.start(start, 4, false));
+  for (uint8_t loop = 0; loop < 3; ++loop) {
+    for (uint8_t i = 10; i < 14; ++i) assert(repeat.next() == i);
+  }
+
+  assert(repeat.start(start, 4, true));
+  for (uint8_t i = 13; i >= 10; --i) assert(repeat.next() == i);
+  assert(repeat.next() == 13u);
+  repeat.restart();
+  assert(repeat.next() == 13u);
+}
+
+void testBeatRepeatRateAndOverwrite() {
+  BeatRepeat<8> repeat;
+  const uint32_t start = repeat.position();
+  for (uint8_t i = 0; i < 8; ++i) repeat.capture(i);
+  assert(repeat.start(start, 8, false));
+  repeat.setRate(BeatRepeat<8>::kRateOne * 2u);
+  assert(repeat.next() == 0u);
+  assert(repeat.next() == 2u);
+  assert(repeat.next() == 4u);
+  assert(repeat.next() == 6u);
+  assert(repeat.next() == 0u);
+
+  repeat.setRate(BeatRepeat<8>::kRateOne / 2u);
+  repeat.restart();
+  assert(repeat.next() == 0u);
+  assert(repeat.next() == 0u);
+  assert(repeat.next() == 1u);
+
+  // One more captured frame overwrites the start of the segment.
+  repeat.capture(99);
+  assert(!repeat.start(start, 8, false));
+  assert(!repeat.start(start, 9, false));
+  assert(repeat.start(start + 1u, 8, false));
+  assert(repeat.next() == 1u);
+}
+
+// Peak distance from centre over one retrigger pass of `length` frames.
+uint32_t passLevel(const uint8_t* frames, uint32_t length) {
+  uint32_t level = 0;
+  for (uint32_t i = 0; i < length; ++i) {
+    const uint32_t distance = frames[i] > 128 ? frames[i] - 128u
+                                              : 128u - frames[i];
+    if (distance > level) level = distance;
+  }
+  return level;
+}
+
+void testRetrigEnvelopeRampsFromFirstPass() {
+  // A "volume increases" retrigger: three steps down on the first pass, one
+  // fewer each pass after, with the sweep opening as it goes.
+  constexpr uint32_t kLength = 32;
+  constexpr uint32_t kCutMax = 45;
+  BeatRepeat<64> repeat;
+  RetrigEnvelope envelope;
+  uint8_t played[4][kLength];
+
+  // First pass: rendered dry, captured dry, heard through the envelope.
+  envelope.reset();
+  const uint32_t start = repeat.position();
+  for (uint32_t i = 0; i < kLength; ++i) {
+    const uint8_t dry = i % 2 == 0 ? 240 : 16;
+    repeat.capture(dry);
+    played[0][i] = envelope.apply(dry, 3, 30, kCutMax);
+  }
+  assert(repeat.start(start, kLength, false));
+  for (uint8_t pass = 1; pass < 4; ++pass) {
+    for (uint32_t i = 0; i < kLength; ++i) {
+      played[pass][i] = envelope.apply(repeat.next(), 3 - pass,
+                                       30u - 10u * pass, kCutMax);
+    }
+  }
+
+  uint32_t last = 0;
+  for (uint8_t pass = 0; pass < 4; ++pass) {
+    const uint32_t level = passLevel(played[pass], kLength);
+    assert(level > last);
+    last = level;
+  }
+  // The capture holds the dry first pass, so the last pass is at full level.
+  assert(last == 112u);
+  assert(passLevel(played[0], kLength) <= 112u >> 3u);
+}
+
+// Carrier ticks for one retrigger pass of `frames` source frames at the
+// clock increment BeatRepeat hands out for `rate_q8`.
+uint64_t passCarriers(const BeatRepeat<64>& repeat, uint32_t frames,
+                      uint32_t rate_q8) {
+  const uint64_t base = (24000ull << 32u) / 121093u;
+  const uint64_t increment = repeat.sourceIncrementQ32(base, rate_q8);
+  return ((static_cast<uint64_t>(frames) << 32u) + increment - 1u) / increment;
+}
+
+void testRetrigPitchWithoutCapture() {
+  using Repeat = BeatRepeat<64>;
+  // The first pass is already a semitone up, and steps stop at two octaves.
+  uint32_t rate = Repeat::stepSemitone(Repeat::kRateOne, true, false);
+  assert(rate == Repeat::kSemitoneUpQ8);
+  for (uint32_t i = 1; i < 12; ++i) rate = Repeat::stepSemitone(rate, true, false);
+  // Q8 truncation leaves twelve steps within a semitone of an octave.
+  assert(rate > 2u * Repeat::kSemitoneDownQ8 && rate <= 2u * Repeat::kRateOne);
+  for (uint32_t i = 0; i < 48; ++i) rate = Repeat::stepSemitone(rate, true, false);
+  assert(rate >= 4u * Repeat::kRateOne &&
+         Repeat::stepSemitone(rate, true, false) == rate);
+  rate = Repeat::kRateOne;
+  for (uint32_t i = 0; i < 48; ++i) rate = Repeat::stepSemitone(rate, false, true);
+  assert(rate <= Repeat::kRateOne / 4u &&
+         Repeat::stepSemitone(rate, false, true) == rate);
+  assert(Repeat::stepSemitone(300u, false, false) == 300u);
+
+  // A pass too long to capture never replays, so the source clock carries
+  // the pitch: a semitone up plays the same frames in 256/271 of the time.
+  Repeat repeat;
+  const uint32_t start = repeat.position();
+  for (uint32_t i = 0; i < 100; ++i) repeat.capture(static_cast<uint8_t>(i));
+  assert(!repeat.start(start, 100, false));
+  const uint64_t unpitched = passCarriers(repeat, 100, Repeat::kRateOne);
+  const uint64_t pitched = passCarriers(repeat, 100, Repeat::kSemitoneUpQ8);
+  assert(pitched * Repeat::kSemitoneUpQ8 <= unpitched * 256u + 256u);
+  assert(pitched * Repeat::kSemitoneUpQ8 + 512u >= unpitched * 256u);
+  assert(repeat.sourceIncrementQ32(1u, 1u) == 1u);
+
+  // A captured pass replays at the read rate with the clock left alone.
+  const uint32_t captured = repeat.position();
+  for (uint32_t i = 0; i < 32; ++i) repeat.capture(static_cast<uint8_t>(i));
+  assert(repeat.start(captured, 32, false));
+  repeat.setRate(Repeat::kRateOne * 2u);
+  assert(passCarriers(repeat, 100, Repeat::kRateOne * 2u) == unpitched);
+  assert(repeat.next() == 0u && repeat.next() == 2u);
+}
+
+void testGrainInterpolation() {
+  const uint8_t ramp[] = {100, 110, 120, 130, 140, 150};
+  auto read_ramp = [&ramp](uint32_t frame) { return ramp[frame]; };
+  const uint64_t half = 1ull << 31u;
+  const uint64_t frame2 = 2ull << 32u;
+  for (const GrainInterp mode :
+       {GrainInterp::Nearest, GrainInterp::Linear, GrainInterp::Cubic}) {
+    // Whole frames read back exactly in every tier.
+    assert(interpolateGrainSample(mode, 6, frame2, read_ramp) == 120 - 128);
+  }
+  assert(interpolateGrainSample(GrainInterp::Nearest, 6, frame2 + half,
+                                read_ramp) == 120 - 128);
+  // Linear and Catmull-Rom agree on a straight line.
+  assert(interpolateGrainSample(GrainInterp::Linear, 6, frame2 + half,
+                                read_ramp) == 125 - 128);
+  assert(interpolateGrainSample(GrainInterp::Cubic, 6, frame2 + half,
+                                read_ramp) == 125 - 128);
+  // The last frame interpolates towards the first.
+  assert(interpolateGrainSample(GrainInterp::Linear, 6, (5ull << 32u) + half,
+                                read_ramp) == 125 - 128);
+
+  // On a peak the cubic follows the curve above the straight line.
+  const uint8_t peak[] = {128, 128, 228, 128, 128};
+  auto read_peak = [&peak](uint32_t frame) { return peak[frame]; };
+  const uint64_t frame1 = (1ull << 32u) + half;
+  assert(interpolateGrainSample(GrainInterp::Nearest, 5, frame1, read_peak) ==
+         0);
+  assert(interpolateGrainSample(GrainInterp::Linear, 5, frame1, read_peak) ==
+         50);
+  assert(interpolateGrainSample(GrainInterp::Cubic, 5, frame1, read_peak) ==
+         56);
+
+  assert(validGrainInterp(2) && !validGrainInterp(3));
+}
+
+void testRenderCacheInvalidation() {
+  RenderCache<64> cache;
+  RenderCacheEntry entry{};
+  assert(cache.setSignature(7));
+  assert(!cache.setSignature(7));
+  assert(!cache.lookup(3, entry));
+  cache.store(3, {10, 20, 276});
+  cache.store(200, {1, 2, 2});
+  // The lowpass history keeps the overshoot the 8-bit output clips away.
+  assert(cache.lookup(3, entry) && entry.input == 10u && entry.output == 20u &&
+         entry.lpf_output == 276);
+  assert(!cache.lookup(200, entry));
+  assert(cache.hits() == 1u);
+  assert(cache.misses() == 2u);
+
+  assert(cache.setSignature(8));
+  assert(!cache.lookup(3, entry));
+  assert(cache.invalidations() == 2u);
+  cache.store(63, {5, 6, -3});
+  assert(cache.lookup(63, entry) && entry.output == 6u);
+}
+
+void testRenderPipelineReleasesWithTick() {
+  RenderPipeline<uint32_t, 8, 8> pipeline;
+  uint32_t released[8] = {};
+  uint32_t release_count = 0;
+  auto release = [&](uint32_t output) { released[release_count++] = output; };
+
+  // Render ahead until full: outputs on ticks 1 and 3, two on tick 3.
+  for (uint8_t tick = 0; !pipeline.full(); ++tick) {
+    if (tick == 1) pipeline.defer(100u);
+    if (tick == 3) {
+      pipeline.defer(300u);
+      pipeline.defer(301u);
+    }
+    pipeline.push(static_cast<uint8_t>(10u + tick));
+  }
+  assert(pipeline.size() == 7u);
+
+  // Nothing leaves while rendering; each output waits for its own level.
+  uint8_t level = 0;
+  assert(pipeline.pop(level, release) && level == 10u && release_count == 0);
+  assert(pipeline.pop(level, release) && level == 11u && release_count == 1);
+  assert(released[0] == 100u);
+  assert(pipeline.pop(level, release) && level == 12u && release_count == 1);
+  assert(pipeline.pop(level, release) && level == 13u && release_count == 3);
+  assert(released[1] == 300u && released[2] == 301u);
+  for (uint32_t i = 0; i < 3; ++i) assert(pipeline.pop(level, release));
+  assert(level == 16u && pipeline.takeMinDepth() == 0u);
+
+  // An underrun holds the last level and does not shift later ticks.
+  assert(!pipeline.pop(level, release) && level == 16u);
+  assert(pipeline.underruns() == 1u);
+  pipeline.defer(700u);
+  pipeline.push(17u);
+  assert(pipeline.pop(level, release) && level == 17u && release_count == 4);
+  assert(released[3] == 700u);
+  assert(pipeline.takeMinDepth() == 0u && pipeline.takeMinDepth() == 7u);
+}
+
+void testDelayFractionalTap() {
+  uint8_t line[64];
+  Delay delay;
+  delay.SetMix(100);
+  delay.SetFeedback(0);
+  delay.Attach(line, sizeof(line));
+  delay.SetTimeQ16(10u << 16u);
+  delay.Attach(line, sizeof(line));
+
+  // Nothing written since attaching reads as silence, even at full mix.
+  assert(delay.Update(200) == 200u);
+  for (uint8_t i = 0; i < 9; ++i) assert(delay.Update(128) == 128u);
+  assert(delay.Update(128) == 200u);
+  assert(delay.Update(128) == 128u);
+
+  // A half-frame tap splits the impulse across two output frames.
+  delay.SetTimeQ16((10u << 16u) + 0x8000u);
+  delay.Attach(line, sizeof(line));
+  delay.Update(200);
+  for (uint8_t i = 0; i < 9; ++i) delay.Update(128);
+  assert(delay.Update(128) == 164u);
+  assert(delay.Update(128) == 164u);
+
+  delay.Detach();
+  assert(!delay.Attached());
+  assert(delay.Update(77) == 77u);
+}
+
+void testDelayTempoSync() {
+  // One quarter at 120 BPM is half a second.
+  assert(Delay::BeatsToFramesQ16(256, 12000, 24000) == 12000u << 16u);
+  assert(Delay::BeatsToFramesQ16(128, 12000, 24000) == 6000u << 16u);
+  assert(Delay::BeatsToFramesQ16(256, 0, 24000) == 0u);
+
+  // A 120 BPM sample played at 165 BPM steps through source frames
+  // 165/120 times faster, so a tap sized at the source tempo still lasts one
+  // quarter at the playing tempo: 60/165 s.
+  const uint32_t source_bpm = 120u;
+  const uint32_t target_bpm = 165u;
+  const uint32_t frames =
+      Delay::BeatsToFramesQ16(256, source_bpm * 100u, 24000) >> 16u;
+  assert(frames == 12000u);
+  const uint32_t frames_per_s = 24000u * target_bpm / source_bpm;
+  const uint32_t tap_us =
+      static_cast<uint32_t>(uint64_t{frames} * 1000000u / frames_per_s);
+  const uint32_t quarter_us = 60000000u / target_bpm;
+  assert(tap_us + 1u >= quarter_us && tap_us <= quarter_us + 1u);
+}
+
+void testDelayAttachAndOnsetRenders() {
+  uint8_t line[64];
+  Delay delay;
+  delay.SetMix(100);
+  delay.SetFeedback(0);
+  delay.SetTimeQ16(10u << 16u);
+
+  // Attaching starts the tap at the set time instead of gliding up from 0.
+  delay.Attach(line, sizeof(line));
+  assert(delay.Update(200) == 200u);
+  for (uint8_t i = 0; i < 9; ++i) assert(delay.Update(128) == 128u);
+  assert(delay.Update(128) == 200u);
+
+  // A render that does not advance a source frame reuses the last tap and
+  // leaves the line where it was.
+  delay.Attach(line, sizeof(line));
+  delay.Update(200);
+  for (uint8_t i = 0; i < 9; ++i) {
+    delay.Update(128);
+    assert(delay.Update(100, false) == 100u);
+  }
+  assert(delay.Update(128) == 200u);
+  assert(delay.Update(90, false) == 162u);
+  assert(delay.Update(128) == 128u);
+}
+
+void testDelayClampsToArena() {
+  static uint8_t arena[PIKO_ARENA_SIZE];
+  Delay delay;
+  delay.SetMix(100);
+  delay.SetFeedback(0);
+  delay.Attach(arena, sizeof(arena));
+
+  // A dotted eighth at 120 BPM fits the arena.
+  delay.SetTimeQ16(Delay::BeatsToFramesQ16(192, 12000, 24000));
+  assert(delay.Clamps() == 0u);
+
+  // At 60 BPM it would need 18000 frames; the tap is shortened to the line
+  // and the clamp is counted.
+  delay.SetTimeQ16(Delay::BeatsToFramesQ16(192, 6000, 24000));
+  assert(delay.Clamps() == 1u);
+  // Re-attaching after an upload applies, and counts, the clamp again.
+  delay.Attach(arena, sizeof(arena));
+  assert(delay.Clamps() == 2u);
+  delay.Update(200);
+  const uint32_t tap = PIKO_ARENA_SIZE - 2u;
+  for (uint32_t i = 1; i < tap; ++i) assert(delay.Update(128) == 128u);
+  assert(delay.Update(128) == 200u);
+}
+
+void testIsrGovernorShedsAndRestores() {
+  IsrGovernor governor(2048);
+  for (uint32_t i = 0; i < 10000; ++i) governor.update(1000);
+  assert(governor.level() == DegradeLevel::Full);
+  assert(governor.headroomPercent() >= 50u);
+
+  // A sustained overload sheds one level per hold-off, never past the last.
+  DegradeLevel level = DegradeLevel::Full;
+  for (uint32_t i = 0; i < 4u * IsrGovernor::kHoldoffIrqs + 8u; ++i) {
+    level = governor.update(2100);
+  }
+  assert(level == DegradeLevel::FewerVoices);
+  assert(governor.entries(DegradeLevel::ShortCrossfade) == 1u);
+  assert(governor.entries(DegradeLevel::FewerVoices) == 1u);
+  assert(governor.overruns() > 0u);
+  assert(governor.headroomPercent() == 0u);
+  for (uint32_t i = 0; i < 4096; ++i) governor.update(2100);
+  assert(governor.level() == DegradeLevel::FewerVoices);
+  assert(governor.entries(DegradeLevel::FewerVoices) == 1u);
+
+  // Load between the thresholds holds the current level.
+  for (uint32_t i = 0; i < 4u * IsrGovernor::kRestoreIrqs; ++i) {
+    governor.update(1600);
+  }
+  assert(governor.level() == DegradeLevel::FewerVoices);
+
+  // Quiet load restores one level per calm window.
+  for (uint32_t i = 0; i < 2u * IsrGovernor::kRestoreIrqs; ++i) {
+    governor.update(800);
+  }
+  assert(governor.level() < DegradeLevel::FewerVoices);
+  assert(governor.level() > DegradeLevel::Full);
+  for (uint32_t i = 0; i < 8u * IsrGovernor::kRestoreIrqs; ++i) {
+    governor.update(800);
+  }
+  assert(governor.level() == DegradeLevel::Full);
+  assert(governor.entries(DegradeLevel::Full) == 1u);
+}
+
+// Plays one slice against a transport running `transport_ppm` faster than
+// the tempo-derived rate and returns the frames played when the phase wraps.
+uint32_t playSliceAgainstTransport(bool slaved, int32_t transport_ppm) {
+  constexpr uint32_t kCarrierHz = 121093u;
+  constexpr uint32_t kSliceFrames = 6000u;  // one eighth at 120 BPM, 24 kHz
+  const uint64_t base = (24000ull << 32u) / kCarrierHz;
+  const uint64_t transport_increment =
+      (((1ull << 32u) * 24000u / kSliceFrames) *
+       static_cast<uint64_t>(1000000 + transport_ppm) / 1000000u) /
+      kCarrierHz;
+  VarispeedSlave slave;
+  slave.restart();
+  uint64_t transport = 0;
+  uint64_t playback = 0;
+  uint64_t increment = base;
+  while (transport < (1ull << 32u)) {
+    playback += increment;
+    if (playback >= (1ull << 32u)) {
+      playback -= 1ull << 32u;
+      slave.advance();
+      if (slaved) {
+        increment = slave.increment(base, static_cast<uint32_t>(transport),
+                                    kSliceFrames);
+      }
+    }
+    transport += transport_increment;
+  }
+  return slave.frames();
+}
+
+void testVarispeedSlaveFollowsTransport() {
+  // Free-running playback misses the slice end by the full tempo error
+  // (120 frames at 2%). The proportional loop only keeps a lag of
+  // error * 2^kGainShift, about 5 frames at 2%.
+  assert(playSliceAgainstTransport(false, 20000) < 5900u);
+  for (const int32_t ppm : {-20000, -1000, 0, 1000, 20000}) {
+    const uint32_t frames = playSliceAgainstTransport(true, ppm);
+    assert(frames >= 5992u && frames <= 6008u);
+  }
+
+  // A beat credited before the phase wraps leaves a near-full slice of error,
+  // which runs at the base rate instead of slewing.
+  VarispeedSlave slave;
+  slave.restart();
+  assert(slave.increment(1000000u, 0xf0000000u, 6000u) == 1000000u);
+  assert(slave.errorFrames() > 5000);
+  assert(slave.maxErrorFrames() == 0u);
+  for (uint32_t i = 0; i < 10; ++i) slave.advance();
+  assert(slave.increment(1000000u, 0x00800000u, 6000u) > 1000000u);
+  assert(slave.maxErrorFrames() > 0u);
+}
+
+}  // namespace
+
+int main() {
+  testBeatRepeatForwardAndReverse();
+  testBeatRepeatRateAndOverwrite();
+  testRetrigEnvelopeRampsFromFirstPass();
+  testRetrigPitchWithoutCapture();
+  testGrainInterpolation();
+  testRenderCacheInvalidation();
+  testRenderPipelineReleasesWithTick();
+  testDelayFractionalTap();
+  testDelayTempoSync();
+  testDelayAttachAndOnsetRenders();
+  testDelayClampsToArena();
+  testIsrGovernorShedsAndRestores();
+  testVarispeedSlaveFollowsTransport();
+  puts("engine_test: all tests passed");
+  return 0;
+}
@@ -0,0 +1,117 @@
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "Seqlock.h"
+
+namespace {
+
+// Every word carries the same stamp, so any mix of two writes shows up.
+struct Payload {
+  uint32_t stamp[37];
+  uint8_t tail[3];  // size not a multiple of four
+};
+
+bool consistent(const Payload& p) {
+  for (const uint32_t word : p.stamp) {
+    if (word != p.stamp[0]) return false;
+  }
+  const uint8_t low = static_cast<uint8_t>(p.stamp[0]);
+  return p.tail[0] == low && p.tail[1] == low && p.tail[2] == low;
+}
+
+Payload make(uint32_t stamp) {
+  Payload p{};
+  for (uint32_t& word : p.stamp) word = stamp;
+  for (uint8_t& byte : p.tail) byte = static_cast<uint8_t>(stamp);
+  return p;
+}
+
+struct BusyGuard {
+  bool tryLock() { return false; }
+  void unlock() {}
+};
+
+void testSingleThreaded() {
+  Seqlock<Payload> lock;
+  Payload out = make(99);
+  assert(lock.read(&out));
+  assert(consistent(out) && out.stamp[0] == 0u);
+  assert(!lock.read(nullptr));
+  assert(lock.write(make(7)));
+  assert(lock.read(&out) && out.stamp[0] == 7u && consistent(out));
+  assert(lock.collisions() == 0u);
+
+  Seqlock<Payload, BusyGuard> busy;
+  assert(!busy.write(make(3)));
+  assert(!busy.write(make(4)));
+  assert(busy.collisions() == 2u);
+  assert(busy.read(&out) && out.stamp[0] == 0u);
+}
+
+// Two writers race each other and two readers; no read may ever return a
+// mix of writes, and stamps seen by one reader never run backwards for a
+// single writer.
+void testThreadedTorture() {
+  Seqlock<Payload> lock;
+  std::atomic<bool> stop{false};
+  std::atomic<uint32_t> writes{0};
+  std::vector<std::thread> threads;
+  for (uint32_t writer = 0; writer < 2; ++writer) {
+    threads.emplace_back([&, writer] {
+      // Writer 0 stamps even values, writer 1 odd ones.
+      for (uint32_t n = 1; !stop.load(std::memory_order_relaxed); ++n) {
+        if (lock.write(make(n * 2u + writer))) {
+          writes.fetch_add(1, std::memory_order_relaxed);
+        } else {
+          std::this_thread::yield();
+        }
+      }
+    });
+  }
+
+  std::atomic<uint32_t> reads{0};
+  std::atomic<uint32_t> torn{0};
+  std::vector<std::thread> readers;
+  for (uint32_t reader = 0; reader < 2; ++reader) {
+    readers.emplace_back([&] {
+      uint32_t last[2] = {0, 0};
+      for (uint32_t i = 0; i < 200000u; ++i) {
+        Payload out{};
+        if (!lock.read(&out)) {
+          std::this_thread::yield();
+          continue;
+        }
+        if (!consistent(out)) torn.fetch_add(1, std::memory_order_relaxed);
+        const uint32_t stamp = out.stamp[0];
+        if (stamp < last[stamp & 1u]) {
+          torn.fetch_add(1, std::memory_order_relaxed);
+        }
+        last[stamp & 1u] = stamp;
+        reads.fetch_add(1, std::memory_order_relaxed);
+      }
+    });
+  }
+  for (std::thread& reader : readers) reader.join();
+  stop = true;
+  for (std::thread& writer : threads) writer.join();
+
+  assert(torn.load() == 0u);
+  assert(reads.load() > 0u);
+  assert(writes.load() > 0u);
+  printf("seqlock_test: %u reads, %u writes, %u collisions\n", reads.load(),
+         writes.load(), lock.collisions());
+}
+
+}  // namespace
+
+int main() {
+  testSingleThreaded();
+  testThreadedTorture();
+  puts("seqlock_test: all tests passed");
+  return 0;
+}
@@ -0,0 +1,111 @@
+// SpscQueue throughput: two threads moving items with single push/pop and
+// with push_n/pop_n batches, plus the single-threaded cost of draining a
+// queue the way the firmware's main loop does.
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <chrono>
+#include <thread>
+
+#include "SpscQueue.h"
+
+namespace {
+
+using BenchClock = std::chrono::steady_clock;
+
+constexpr uint32_t kItems = 20000000u;
+constexpr uint32_t kDrainRounds = 200000u;
+
+// Same size as the firmware's ClockEvent and MidiByteEvent entries.
+struct Item {
+  uint32_t value;
+  uint32_t timestamp_us;
+};
+
+double elapsedNs(BenchClock::time_point a, BenchClock::time_point b) {
+  return std::chrono::duration<double, std::nano>(b - a).count();
+}
+
+// Returns items per second through a 64-slot queue.
+template <size_t Batch>
+double threaded() {
+  SpscQueue<Item, 64> queue;
+  const auto start = BenchClock::now();
+  std::thread producer([&] {
+    Item batch[Batch];
+    uint32_t next = 0;
+    while (next < kItems) {
+      size_t pushed = 0;
+      if (Batch == 1) {
+        pushed = queue.push({next, next}) ? 1u : 0u;
+      } else {
+        uint32_t count = Batch;
+        if (count > kItems - next) count = kItems - next;
+        for (uint32_t i = 0; i < count; ++i) batch[i] = {next + i, next + i};
+        pushed = queue.push_n(batch, count);
+      }
+      if (pushed == 0) std::this_thread::yield();
+      next += static_cast<uint32_t>(pushed);
+    }
+  });
+  Item batch[Batch];
+  uint64_t sum = 0;
+  uint32_t received = 0;
+  while (received < kItems) {
+    size_t count = 0;
+    if (Batch == 1) {
+      count = queue.pop(batch[0]) ? 1u : 0u;
+    } else {
+      count = queue.pop_n(batch, Batch);
+    }
+    if (count == 0) std::this_thread::yield();
+    for (size_t i = 0; i < count; ++i) sum += batch[i].value;
+    received += static_cast<uint32_t>(count);
+  }
+  producer.join();
+  const double ns = elapsedNs(start, BenchClock::now());
+  if (sum != static_cast<uint64_t>(kItems) * (kItems - 1u) / 2u) {
+    fprintf(stderr, "spsc_queue_bench: checksum mismatch\n");
+  }
+  return kItems / (ns / 1e9);
+}
+
+// Fills a 32-slot queue and drains it, one pop at a time or in batches of 8.
+// Returns nanoseconds per drained item.
+template <size_t Batch>
+double drain() {
+  SpscQueue<Item, 32> queue;
+  Item fill[31];
+  for (uint32_t i = 0; i < 31; ++i) fill[i] = {i, i};
+  volatile uint32_t sink = 0;
+  double ns = 0;
+  for (uint32_t round = 0; round < kDrainRounds; ++round) {
+    queue.push_n(fill, 31);
+    const auto a = BenchClock::now();
+    Item out[Batch];
+    if (Batch == 1) {
+      while (queue.pop(out[0])) sink = sink + out[0].value;
+    } else {
+      size_t count = 0;
+      while ((count = queue.pop_n(out, Batch)) > 0) {
+        for (size_t i = 0; i < count; ++i) sink = sink + out[i].value;
+      }
+    }
+    ns += elapsedNs(a, BenchClock::now());
+  }
+  return ns / (static_cast<double>(kDrainRounds) * 31.0);
+}
+
+}  // namespace
+
+int main() {
+  printf("%-24s %14s\n", "mode", "Mitems/s");
+  printf("%-24s %14.2f\n", "threaded push/pop", threaded<1>() / 1e6);
+  printf("%-24s %14.2f\n", "threaded push_n/pop_n 8", threaded<8>() / 1e6);
+  printf("%-24s %14.2f\n", "threaded push_n/pop_n 32", threaded<32>() / 1e6);
+  printf("%-24s %14s\n", "mode", "ns/item");
+  printf("%-24s %14.2f\n", "drain pop", drain<1>());
+  printf("%-24s %14.2f\n", "drain pop_n 8", drain<8>());
+  return 0;
+}
@@ -0,0 +1,133 @@
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include <deque>
+#include <thread>
+
+#include "SpscQueue.h"
+
+namespace {
+
+struct Item {
+  uint32_t value;
+  uint32_t check;  // ~value; a torn copy breaks the pair
+};
+
+void testBatchPushPop() {
+  SpscQueue<uint32_t, 8> queue;
+  static_assert(SpscQueue<uint32_t, 8>::capacity() == 7, "one slot spare");
+  const uint32_t first[5] = {1, 2, 3, 4, 5};
+  assert(queue.push_n(first, 5) == 5u);
+  assert(queue.size() == 5u);
+  uint32_t out[8] = {};
+  assert(queue.pop_n(out, 3) == 3u);
+  assert(out[0] == 1u && out[1] == 2u && out[2] == 3u);
+
+  // Two entries remain, so five of six fit and the wrap is crossed.
+  const uint32_t second[6] = {6, 7, 8, 9, 10, 11};
+  assert(queue.push_n(second, 6) == 5u);
+  assert(queue.drops() == 1u);
+  assert(!queue.push(12));
+  assert(queue.drops() == 2u);
+  assert(queue.pop_n(out, 8) == 7u);
+  for (uint32_t i = 0; i < 7; ++i) assert(out[i] == 4u + i);
+  assert(queue.empty());
+  assert(queue.pop_n(out, 8) == 0u);
+  assert(queue.push_n(first, 0) == 0u);
+
+  assert(queue.push(13));
+  queue.clear();
+  assert(queue.empty() && queue.size() == 0u);
+}
+
+// Non-power-of-two capacities take the compare-and-reset path; check it
+// against a reference queue across many wraps.
+void testNonPowerOfTwoMatchesReference() {
+  SpscQueue<uint32_t, 5> queue;
+  std::deque<uint32_t> reference;
+  uint32_t next = 0;
+  uint32_t seed = 7u;
+  for (uint32_t step = 0; step < 10000u; ++step) {
+    seed = seed * 1664525u + 1013904223u;
+    const size_t count = (seed >> 24u) % 6u;
+    if ((seed >> 16u) & 1u) {
+      uint32_t values[5];
+      for (size_t i = 0; i < count; ++i) values[i] = next + i;
+      const size_t pushed = queue.push_n(values, count);
+      assert(pushed == std::min(count, 4u - reference.size()));
+      for (size_t i = 0; i < pushed; ++i) reference.push_back(next++);
+      next += static_cast<uint32_t>(count - pushed);
+    } else {
+      uint32_t out[5];
+      const size_t popped = queue.pop_n(out, count);
+      assert(popped == std::min(count, reference.size()));
+      for (size_t i = 0; i < popped; ++i) {
+        assert(out[i] == reference.front());
+        reference.pop_front();
+      }
+    }
+    assert(queue.size() == reference.size());
+  }
+}
+
+// One producer and one consumer thread, mixing single and batched calls.
+// Every value must arrive once, in order and untorn.
+template <size_t Capacity>
+void stress(uint32_t total) {
+  SpscQueue<Item, Capacity> queue;
+  std::thread producer([&] {
+    uint32_t next = 0;
+    Item batch[7];
+    while (next < total) {
+      size_t pushed = 0;
+      if (next % 3u == 0) {
+        pushed = queue.push({next, ~next}) ? 1u : 0u;
+      } else {
+        uint32_t count = 1u + next % 7u;
+        if (count > total - next) count = total - next;
+        for (uint32_t i = 0; i < count; ++i) {
+          batch[i] = {next + i, ~(next + i)};
+        }
+        pushed = queue.push_n(batch, count);
+      }
+      // Full: let the consumer run, which matters on single-CPU hosts.
+      if (pushed == 0) std::this_thread::yield();
+      next += static_cast<uint32_t>(pushed);
+    }
+  });
+
+  uint32_t expected = 0;
+  Item batch[5];
+  while (expected < total) {
+    size_t count = 0;
+    if (expected % 2u == 0) {
+      count = queue.pop(batch[0]) ? 1u : 0u;
+    } else {
+      count = queue.pop_n(batch, 5);
+    }
+    if (count == 0) std::this_thread::yield();
+    for (size_t i = 0; i < count; ++i) {
+      assert(batch[i].value == expected && batch[i].check == ~expected);
+      ++expected;
+    }
+  }
+  producer.join();
+  assert(queue.empty());
+}
+
+void testThreadedStress() {
+  stress<4>(200000u);
+  stress<64>(1000000u);
+  stress<7>(200000u);
+}
+
+}  // namespace
+
+int main() {
+  testBatchPushPop();
+  testNonPowerOfTwoMatchesReference();
+  testThreadedStress();
+  puts("spsc_queue_test: all tests passed");
+  return 0;
+}
@@ -0,0 +1,115 @@
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "TimedSpscQueue.h"
+
+namespace {
+
+struct FakeClock {
+  static uint32_t now_us;
+  static uint32_t nowUs() { return now_us; }
+};
+uint32_t FakeClock::now_us = 0;
+
+using Queue = TimedSpscQueue<uint32_t, 8, FakeClock>;
+
+void testLatency() {
+  FakeClock::now_us = 1000;
+  Queue queue;
+  SpscQueueStats stats = queue.stats();
+  assert(stats.timed == 0u && stats.min_latency_us == 0u);
+  assert(stats.max_latency_us == 0u && stats.high_water == 0u);
+
+  assert(queue.push(1));
+  FakeClock::now_us += 5;
+  assert(queue.push(2));
+  FakeClock::now_us += 100;
+  uint32_t value = 0;
+  assert(queue.pop(value) && value == 1u);  // waited 105 us
+  FakeClock::now_us += 3;
+  assert(queue.pop(value) && value == 2u);  // waited 103 us
+  assert(!queue.pop(value));
+
+  stats = queue.stats();
+  assert(stats.timed == 2u);
+  assert(stats.min_latency_us == 103u && stats.max_latency_us == 105u);
+  assert(stats.high_water == 2u);
+  // 103 and 105 both land in [64, 128).
+  assert(stats.latency_histogram.counts[piko::Log2Histogram::bucket(100)] ==
+         2u);
+
+  // A zero wait counts in bucket 0, and the stamp survives a clock wrap.
+  assert(queue.push(3));
+  assert(queue.pop(value) && value == 3u);
+  FakeClock::now_us = UINT32_MAX - 9;
+  assert(queue.push(4));
+  FakeClock::now_us = 10;
+  assert(queue.pop(value) && value == 4u);
+  stats = queue.stats();
+  assert(stats.timed == 4u && stats.min_latency_us == 0u);
+  assert(stats.max_latency_us == 105u);
+  assert(stats.latency_histogram.counts[0] == 1u);
+  assert(stats.latency_histogram.counts[piko::Log2Histogram::bucket(20)] ==
+         1u);
+}
+
+void testBatches() {
+  FakeClock::now_us = 50;
+  Queue queue;
+  uint32_t values[12];
+  for (uint32_t i = 0; i < 12; ++i) values[i] = i;
+
+  // Seven slots: the first chunk of eight overflows by one and the last
+  // four never get a chance.
+  assert(queue.push_n(values, 12) == 7u);
+  assert(queue.drops() == 5u);
+  assert(queue.size() == 7u && queue.stats().high_water == 7u);
+  assert(!queue.push(99));
+  assert(queue.drops() == 6u);
+
+  FakeClock::now_us = 80;
+  uint32_t out[12] = {};
+  assert(queue.pop_n(out, 3) == 3u);
+  assert(out[0] == 0u && out[1] == 1u && out[2] == 2u);
+  FakeClock::now_us = 90;
+  assert(queue.pop_n(out, 12) == 4u);
+  assert(out[0] == 3u && out[3] == 6u);
+  assert(queue.empty());
+
+  const SpscQueueStats stats = queue.stats();
+  assert(stats.timed == 7u);
+  assert(stats.min_latency_us == 30u && stats.max_latency_us == 40u);
+  assert(stats.high_water == 7u);
+
+  // Batches longer than one stamp chunk keep their order.
+  assert(queue.push_n(values, 5) == 5u);
+  queue.clear();
+  assert(queue.empty() && queue.stats().timed == 7u);
+}
+
+void testLargeQueueChunks() {
+  FakeClock::now_us = 0;
+  TimedSpscQueue<uint32_t, 32, FakeClock> queue;
+  uint32_t values[20];
+  for (uint32_t i = 0; i < 20; ++i) values[i] = i * 3u;
+  assert(queue.push_n(values, 20) == 20u);
+  assert(queue.drops() == 0u);
+  FakeClock::now_us = 7;
+  uint32_t out[20] = {};
+  assert(queue.pop_n(out, 20) == 20u);
+  for (uint32_t i = 0; i < 20; ++i) assert(out[i] == i * 3u);
+  const SpscQueueStats stats = queue.stats();
+  assert(stats.timed == 20u && stats.high_water == 20u);
+  assert(stats.min_latency_us == 7u && stats.max_latency_us == 7u);
+}
+
+}  // namespace
+
+int main() {
+  testLatency();
+  testBatches();
+  testLargeQueueChunks();
+  puts("timed_spsc_queue_test: all tests passed");
+  return 0;
+}
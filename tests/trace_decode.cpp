@@ -0,0 +1,261 @@
+// Decodes an engine trace downloaded with the 'T' command into a merged
+// timeline of both cores, or into Chrome trace JSON for chrome://tracing and
+// Perfetto.
+//
+//   trace_decode trace.bin [--chrome]
+//
+// The file holds the reply exactly as sent: u32 payload length, u32 version,
+// u32 records written and u32 record count for core 0 then core 1, u32 device
+// time, then 12-byte TraceRecord entries, core 0's before core 1's.
+// Timestamps are ordered by age against the device time, so a trace that
+// crosses the 32-bit microsecond wrap still merges correctly.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "ClockSync.h"
+#include "Trace.h"
+
+using piko::TraceEvent;
+using piko::TraceRecord;
+
+namespace {
+
+constexpr uint32_t kTraceVersion = 1u;
+constexpr size_t kHeaderBytes = 28u;
+constexpr size_t kRecordBytes = 12u;
+
+struct Trace {
+  uint32_t written[2] = {0, 0};
+  uint32_t counts[2] = {0, 0};
+  uint32_t device_time_us = 0;
+  std::vector<TraceRecord> records;
+};
+
+// A record placed on the merged timeline.
+struct Entry {
+  uint64_t t_us;
+  TraceRecord record;
+};
+
+uint32_t readLe32(const uint8_t* bytes) {
+  return static_cast<uint32_t>(bytes[0]) |
+         (static_cast<uint32_t>(bytes[1]) << 8u) |
+         (static_cast<uint32_t>(bytes[2]) << 16u) |
+         (static_cast<uint32_t>(bytes[3]) << 24u);
+}
+
+uint16_t readLe16(const uint8_t* bytes) {
+  return static_cast<uint16_t>(bytes[0] | (bytes[1] << 8u));
+}
+
+bool loadTrace(const char* path, Trace& trace) {
+  FILE* file = fopen(path, "rb");
+  if (file == nullptr) {
+    fprintf(stderr, "trace_decode: cannot open %s\n", path);
+    return false;
+  }
+  std::vector<uint8_t> bytes;
+  uint8_t buffer[4096];
+  size_t n = 0;
+  while ((n = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+    bytes.insert(bytes.end(), buffer, buffer + n);
+  }
+  fclose(file);
+
+  if (bytes.size() < kHeaderBytes) {
+    fprintf(stderr, "trace_decode: trace too short\n");
+    return false;
+  }
+  const uint32_t payload = readLe32(&bytes[0]);
+  const uint32_t version = readLe32(&bytes[4]);
+  if (version != kTraceVersion) {
+    fprintf(stderr, "trace_decode: unsupported trace version %u\n", version);
+    return false;
+  }
+  for (uint32_t core = 0; core < 2; ++core) {
+    trace.written[core] = readLe32(&bytes[8u + core * 8u]);
+    trace.counts[core] = readLe32(&bytes[12u + core * 8u]);
+  }
+  trace.device_time_us = readLe32(&bytes[24]);
+  const uint32_t count = trace.counts[0] + trace.counts[1];
+  if (payload != kHeaderBytes - 4u + count * kRecordBytes ||
+      bytes.size() < 4u + payload) {
+    fprintf(stderr, "trace_decode: truncated trace (%u of %u records)\n",
+            static_cast<uint32_t>((bytes.size() - kHeaderBytes) / kRecordBytes),
+            count);
+    return false;
+  }
+  trace.records.resize(count);
+  for (uint32_t i = 0; i < count; ++i) {
+    const uint8_t* record = &bytes[kHeaderBytes + i * kRecordBytes];
+    TraceRecord& r = trace.records[i];
+    r.timestamp_us = readLe32(record);
+    r.event = static_cast<TraceEvent>(record[4]);
+    r.core = record[5];
+    r.arg0 = readLe16(record + 6);
+    r.arg1 = readLe32(record + 8);
+  }
+  return true;
+}
+
+// Orders both cores' records by age against the device time and rebases
+// them so the oldest sits at zero. A stable sort keeps each core's own order
+// for records in the same microsecond.
+std::vector<Entry> mergeTimeline(const Trace& trace) {
+  std::vector<Entry> entries;
+  entries.reserve(trace.records.size());
+  uint32_t oldest_age = 0;
+  for (const TraceRecord& r : trace.records) {
+    const uint32_t age = trace.device_time_us - r.timestamp_us;
+    oldest_age = std::max(oldest_age, age);
+  }
+  for (const TraceRecord& r : trace.records) {
+    const uint32_t age = trace.device_time_us - r.timestamp_us;
+    entries.push_back({static_cast<uint64_t>(oldest_age - age), r});
+  }
+  std::stable_sort(entries.begin(), entries.end(),
+                   [](const Entry& a, const Entry& b) {
+                     return a.t_us < b.t_us;
+                   });
+  return entries;
+}
+
+const char* flashOpName(uint16_t op) {
+  return static_cast<piko::TraceFlashOp>(op) == piko::TraceFlashOp::Erase
+             ? "erase"
+             : "program";
+}
+
+// Human-readable arguments, shared by both output formats.
+void describe(const TraceRecord& r, char* out, size_t size) {
+  switch (r.event) {
+    case TraceEvent::BeatOnset:
+      snprintf(out, size, "beat=%u%s%s%s", r.arg1,
+               (r.arg0 & piko::kTraceBeatTransport) ? " transport" : "",
+               (r.arg0 & piko::kTraceBeatReset) ? " reset" : "",
+               (r.arg0 & piko::kTraceBeatSoftSync) ? " soft_sync" : "");
+      return;
+    case TraceEvent::RetrigStart:
+      snprintf(out, size, "sel=%u repeats=%u length=%u", r.arg0 & 0xffu,
+               r.arg0 >> 8u, r.arg1);
+      return;
+    case TraceEvent::RetrigEnd:
+      snprintf(out, size, "played=%u", r.arg0);
+      return;
+    case TraceEvent::HeadSwitch:
+      snprintf(out, size, "head=%u start=%u%s", r.arg0 & 0xffu, r.arg1,
+               (r.arg0 & 0x100u) ? " retrig" : "");
+      return;
+    case TraceEvent::Clock:
+      snprintf(out, size, "%s %s edge_us=%u",
+               piko::clockEventTypeName(
+                   static_cast<piko::ClockEventType>(r.arg0 & 0xffu)),
+               piko::clockOutcomeName(
+                   static_cast<piko::ClockOutcome>(r.arg0 >> 8u)),
+               r.arg1);
+      return;
+    case TraceEvent::QueueDrop:
+      snprintf(out, size, "queue=%s drops=%u",
+               piko::traceQueueName(static_cast<piko::TraceQueue>(r.arg0)),
+               r.arg1);
+      return;
+    case TraceEvent::FlashBegin:
+    case TraceEvent::FlashEnd:
+      snprintf(out, size, "%s offset=0x%x", flashOpName(r.arg0), r.arg1);
+      return;
+  }
+  snprintf(out, size, "arg0=%u arg1=%u", r.arg0, r.arg1);
+}
+
+void printTimeline(const std::vector<Entry>& entries) {
+  printf("t_us,core,event,detail\n");
+  char detail[128];
+  for (const Entry& e : entries) {
+    describe(e.record, detail, sizeof(detail));
+    printf("%llu,%u,%s,%s\n", static_cast<unsigned long long>(e.t_us),
+           e.record.core, piko::traceEventName(e.record.event), detail);
+  }
+}
+
+// Retrigs and flash writes become duration slices; everything else is an
+// instant on its core's track.
+void printChrome(const std::vector<Entry>& entries) {
+  printf("{\"traceEvents\":[\n");
+  printf("{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":0,"
+         "\"args\":{\"name\":\"core 0\"}},\n");
+  printf("{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":1,"
+         "\"args\":{\"name\":\"core 1\"}}");
+  char detail[128];
+  for (const Entry& e : entries) {
+    const TraceRecord& r = e.record;
+    const char* name = piko::traceEventName(r.event);
+    const char* phase = "i";
+    switch (r.event) {
+      case TraceEvent::RetrigStart:
+      case TraceEvent::RetrigEnd:
+        name = "RETRIG";
+        phase = r.event == TraceEvent::RetrigStart ? "B" : "E";
+        break;
+      case TraceEvent::FlashBegin:
+      case TraceEvent::FlashEnd:
+        name = r.arg0 == static_cast<uint16_t>(piko::TraceFlashOp::Erase)
+                   ? "FLASH_ERASE"
+                   : "FLASH_PROGRAM";
+        phase = r.event == TraceEvent::FlashBegin ? "B" : "E";
+        break;
+      default:
+        break;
+    }
+    describe(r, detail, sizeof(detail));
+    printf(",\n{\"name\":\"%s\",\"ph\":\"%s\",%s\"ts\":%llu,\"pid\":0,"
+           "\"tid\":%u,\"args\":{\"detail\":\"%s\"}}",
+           name, phase, phase[0] == 'i' ? "\"s\":\"t\"," : "",
+           static_cast<unsigned long long>(e.t_us), r.core, detail);
+  }
+  printf("\n]}\n");
+}
+
+void usage() { fprintf(stderr, "usage: trace_decode trace.bin [--chrome]\n"); }
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  const char* path = nullptr;
+  bool chrome = false;
+  for (int i = 1; i < argc; ++i) {
+    if (strcmp(argv[i], "--chrome") == 0) {
+      chrome = true;
+    } else if (path == nullptr && argv[i][0] != '-') {
+      path = argv[i];
+    } else {
+      usage();
+      return 2;
+    }
+  }
+  if (path == nullptr) {
+    usage();
+    return 2;
+  }
+
+  Trace trace;
+  if (!loadTrace(path, trace)) return 1;
+  const std::vector<Entry> entries = mergeTimeline(trace);
+  if (chrome) {
+    printChrome(entries);
+  } else {
+    printTimeline(entries);
+  }
+  fprintf(stderr,
+          "trace_decode: core 0 %u of %u records, core 1 %u of %u records, "
+          "%llu us span\n",
+          trace.counts[0], trace.written[0], trace.counts[1],
+          trace.written[1],
+          static_cast<unsigned long long>(
+              entries.empty() ? 0 : entries.back().t_us));
+  return 0;
+}
@@ -30,6 +30,7 @@ import {
 } from './bank';
 import {
   ClockDiagnostics,
+  ClockInput,
   DeviceInfo,
   PikocoreSerial,
   hasClockSync,
@@ -618,16 +619,21 @@ export function App() {
     }
   }
 
-  async function setIttybittymidiMode(enabled: boolean) {
+  async function setClockInput(input: ClockInput) {
     if (!connected || !device) return;
     try {
       await beginBusyOperation();
       setStatus({ text: 'Saving clock input mode', kind: 'idle' });
-      await serial.setClockInputMode(enabled);
+      await serial.setClockInputMode(input);
       const info = await serial.info();
       setDevice(info);
       setStatus({
-        text: enabled ? 'Clock input set to ittybittymidi' : 'Clock input set to pulses',
+        text:
+          input === 'MIDI'
+            ? 'Clock input set to ittybittymidi'
+            : input === 'USB_MIDI'
+              ? 'Clock input set to USB MIDI'
+              : 'Clock input set to pulses',
         kind: 'good',
       });
     } catch (error) {
@@ -931,7 +937,7 @@ export function App() {
                 type="checkbox"
                 checked={device?.ittybittymidiMode ?? false}
                 disabled={!connected || incompatibleDevice != null || busy}
-                onChange={(event) => void setIttybittymidiMode(event.currentTarget.checked)}
+                onChange={(event) => void setClockInput(event.currentTarget.checked ? 'MIDI' : 'CLOCK')}
               />
               Ittybittymidi mode
             </label>
@@ -946,6 +952,20 @@ export function App() {
             >
               more info
             </button>
+            {hasClockSync(device) ? (
+              <label
+                className={!connected || incompatibleDevice != null || busy ? 'disabled' : ''}
+                title="Follow MIDI clock and transport from the USB host"
+              >
+                <input
+                  type="checkbox"
+                  checked={device?.clockInput === 'USB_MIDI'}
+                  disabled={!connected || incompatibleDevice != null || busy}
+                  onChange={(event) => void setClockInput(event.currentTarget.checked ? 'USB_MIDI' : 'CLOCK')}
+                />
+                USB MIDI clock
+              </label>
+            ) : null}
             {hasClockSync(device) ? (
               <label className={!connected || incompatibleDevice != null || busy ? 'disabled' : ''}>
                 Pulse division
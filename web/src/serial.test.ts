@@ -1,6 +1,7 @@
 import { describe, expect, it } from 'vitest';
 import { BANK_HEADER_SIZE, BANK_MAX_SAMPLES, BANK_VERSION } from './bank';
 import {
+  clockInputCommand,
   hasClockSync,
   isCompatibleFirmware,
   parseClockDiagnostics,
@@ -60,6 +61,20 @@ describe('clock diagnostics', () => {
   });
 });
 
+describe('clock input command', () => {
+  it('encodes every clock input source', () => {
+    expect(Array.from(clockInputCommand('CLOCK'))).toEqual([0x43, 0]);
+    expect(Array.from(clockInputCommand('MIDI'))).toEqual([0x43, 1]);
+    expect(Array.from(clockInputCommand('USB_MIDI'))).toEqual([0x43, 2]);
+  });
+
+  it('parses the reported clock input', () => {
+    const info = parseInfo(`${baseInfo.replace('CLOCK_INPUT CLOCK', 'CLOCK_INPUT USB_MIDI')}\nEND\n`);
+    expect(info.clockInput).toBe('USB_MIDI');
+    expect(info.ittybittymidiMode).toBe(false);
+  });
+});
+
 describe('pulse PPQN command', () => {
   it('encodes supported PPQN settings', () => {
     expect(Array.from(pulsePpqnCommand(1))).toEqual([0x50, 1]);
@@ -1,5 +1,9 @@
 import { BANK_HEADER_SIZE, BANK_MAX_SAMPLES, BANK_VERSION } from './bank';
 
+// Clock input sources in 'C' command order, named as CLOCK_INPUT reports them.
+export const CLOCK_INPUTS = ['CLOCK', 'MIDI', 'USB_MIDI'] as const;
+export type ClockInput = (typeof CLOCK_INPUTS)[number];
+
 export interface DeviceInfo {
   firmware: string;
   reserveBytes: number;
@@ -10,6 +14,7 @@ export interface DeviceInfo {
   usedBytes: number;
   sampleRate: number;
   sampleCount: number;
+  clockInput: ClockInput;
   ittybittymidiMode: boolean;
   pulsePpqn?: 1 | 2 | 4;
   clockSyncVersion?: number;
@@ -21,8 +26,8 @@ export interface DeviceInfo {
 }
 
 export interface ClockDiagnostics {
-  source: 'INTERNAL' | 'PULSE' | 'MIDI';
-  state: 'UNLOCKED' | 'ACQUIRING' | 'LOCKED' | 'HOLDOVER';
+  source: 'INTERNAL' | 'PULSE' | 'MIDI' | 'USB_MIDI';
+  state: 'UNLOCKED' | 'ACQUIRING' | 'LOCKED' | 'HOLDOVER' | 'FLYWHEEL';
   bpmX100: number;
   targetBpmX100: number;
   jitterUs: number;
@@ -56,6 +61,12 @@ export function pulsePpqnCommand(ppqn: number): Uint8Array {
   return new Uint8Array([0x50, ppqn]);
 }
 
+export function clockInputCommand(input: ClockInput): Uint8Array {
+  const value = CLOCK_INPUTS.indexOf(input);
+  if (value < 0) throw new Error(`Invalid clock input ${input}`);
+  return new Uint8Array([0x43, value]);
+}
+
 export function isCompatibleFirmware(info: DeviceInfo): boolean {
   return (
     info.protocolVersion != null &&
@@ -238,10 +249,9 @@ export class PikocoreSerial {
     if (line !== 'OK') throw new Error(`Stop rejected: ${line}`);
   }
 
-  async setClockInputMode(ittybittymidiMode: boolean): Promise<void> {
+  async setClockInputMode(input: ClockInput): Promise<void> {
     await this.sync();
-    await this.writeString('C');
-    await this.write(new Uint8Array([ittybittymidiMode ? 1 : 0]));
+    await this.write(clockInputCommand(input));
     const line = await this.waitForLine(COMMAND_TIMEOUT_MS);
     if (line !== 'OK') throw new Error(`Clock input setting rejected: ${line}`);
   }
@@ -484,6 +494,7 @@ export function parseInfo(text: string): DeviceInfo {
     const parsed = Number(value);
     return Number.isFinite(parsed) ? parsed : undefined;
   };
+  const clockInput = parseClockInput(token(['CLOCK_INPUT', 'CI'], 'CLOCK'));
   return {
     firmware: token('FW', '--'),
     flashBytes: Number(token(['FLASH', 'F'], '0')),
@@ -494,7 +505,8 @@ export function parseInfo(text: string): DeviceInfo {
     usedBytes: Number(token(['USED', 'U'], '0')),
     sampleRate: Number(token(['RATE', 'SR'], '24000')),
     sampleCount: Number(token(['COUNT', 'N'], '0')),
-    ittybittymidiMode: token(['CLOCK_INPUT', 'CI'], 'CLOCK') === 'MIDI',
+    clockInput,
+    ittybittymidiMode: clockInput === 'MIDI',
     pulsePpqn: parsePulsePpqn(numberToken('PULSE_PPQN')),
     clockSyncVersion: numberToken('CLOCK_SYNC_VERSION'),
     protocolVersion: numberToken('PROTO'),
@@ -505,6 +517,10 @@ export function parseInfo(text: string): DeviceInfo {
   };
 }
 
+function parseClockInput(value: string): ClockInput {
+  return (CLOCK_INPUTS as readonly string[]).includes(value) ? (value as ClockInput) : 'CLOCK';
+}
+
 function parsePulsePpqn(value: number | undefined): 1 | 2 | 4 | undefined {
   return value === 1 || value === 2 || value === 4 ? value : undefined;
 }
@@ -525,10 +541,16 @@ export function parseClockDiagnostics(text: string): ClockDiagnostics {
   };
   const source = token('SOURCE');
   const state = token('STATE');
-  if (source !== 'INTERNAL' && source !== 'PULSE' && source !== 'MIDI') {
+  if (source !== 'INTERNAL' && source !== 'PULSE' && source !== 'MIDI' && source !== 'USB_MIDI') {
     throw new Error(`Invalid clock source ${source}`);
   }
-  if (state !== 'UNLOCKED' && state !== 'ACQUIRING' && state !== 'LOCKED' && state !== 'HOLDOVER') {
+  if (
+    state !== 'UNLOCKED' &&
+    state !== 'ACQUIRING' &&
+    state !== 'LOCKED' &&
+    state !== 'HOLDOVER' &&
+    state !== 'FLYWHEEL'
+  ) {
     throw new Error(`Invalid clock state ${state}`);
   }
   return {